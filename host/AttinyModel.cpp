@@ -0,0 +1,392 @@
+/*
+  AttinyModel.cpp - Model of the ATTINY88 end of the TinyUI SPI link, for running the badge code on the host.
+  Released under the MIT License.
+*/
+
+#include "AttinyModel.h"
+
+// (the opcodes and NVM operations are TinyUI.cpp's; they aren't in TinyUI.h, since nothing else on the badge needs them)
+#define OP_DIM                0x6c
+#define OP_PULSE              0x69
+#define OP_TRANSITION         0x66
+#define OP_PULSE_CMP          0x63
+#define OP_BLING_MODE         0x3c
+#define OP_NAVHASH_IVS        0x39
+#define OP_NVM_REQUEST        0x36
+#define OP_TOUCH              0x80
+#define OP_ADC_DATA           0xcc
+#define OP_NAVHASH_OUT        0xc6
+#define OP_NVM_RESULT         0xc3
+
+#define NVM_OP_MASK           0xf0
+#define NVM_OP_FLASH_READ     0x00
+#define NVM_OP_FLASH_WRITE    0x10
+#define NVM_OP_EEPROM_READ    0x20
+#define NVM_OP_EEPROM_WRITE   0x30
+#define NVM_OP_ENCRYPT        0x40
+#define NVM_OP_DECRYPT        0x50
+#define NVM_OP_HASH           0x60
+#define NVM_OP_GET_SIZES      0xe0
+#define NVM_OP_ERROR          0xf0
+#define NVM_LEN_MASK          0x0f
+
+#define FNV_OFFSET            0x811c9dc5UL
+#define FNV_PRIME             0x01000193UL
+
+AttinyModel::AttinyModel(void)
+{
+  uint8_t i;
+
+  memset(&_stats, 0, sizeof(_stats));
+  _selected = false;
+  _maxClock = ATTINY_MAX_CLOCK;
+  _failures = 0;
+  memset(_eeprom, 0xff, sizeof(_eeprom));
+  for (i = 0; i < TINYUI_BUTTON_COUNT; i++)
+  {
+    _readings[i] = ATTINY_READING_IDLE;
+    _presses[i] = 0;
+  }
+  _touched = 0;
+  for (i = 0; i < TINYUI_POWER_COUNT; i++)
+  {
+    _adc[i] = 0;
+  }
+  for (i = 0; i < TINYUI_LED_COUNT; i++)
+  {
+    _dim[i] = 0;
+    _pulse[i] = 0;
+    _pulseLength[i] = TINYUI_PULSE_LENGTH;
+    _trans[i] = TINYUI_TRANS_IMMEDIATE;
+  }
+  memset(_bling, 0, sizeof(_bling));
+  _rxOp = 0;
+  _rxPos = 0;
+  _txPos = TINYUI_PACKET_LENGTH;
+  _sendTouch = false;
+  _sendAdc = false;
+  _resultReady = false;
+  _resultDelay = 0;
+}
+
+void AttinyModel::select(boolean selected)
+{
+  uint8_t i;
+
+  _selected = selected;
+  _rxOp = 0;
+  _rxPos = 0;
+  _txPos = TINYUI_PACKET_LENGTH;
+  _resultReady = false;   // (a result not sent by the end of its transaction is lost)
+  if (selected)
+  {
+    _stats.transactions++;
+    for (i = 0; i < TINYUI_LED_COUNT; i++)
+    {
+      _trans[i] = TINYUI_TRANS_IMMEDIATE;
+    }
+    _sendTouch = true;
+    _sendAdc = true;
+  }
+}
+
+uint8_t AttinyModel::transfer(uint8_t b, uint32_t clock)
+{
+  uint8_t out;
+
+  if (!_selected)
+  {
+    return 0xff;
+  }
+
+  // What goes out was loaded before the byte coming in was seen
+  if (_txPos >= TINYUI_PACKET_LENGTH)
+  {
+    _nextPacket();
+  }
+  out = 0x00;
+  if (_txPos < TINYUI_PACKET_LENGTH)
+  {
+    out = _tx[_txPos++];
+    if (_txPos == TINYUI_PACKET_LENGTH)
+    {
+      if ((_tx[0] & 0xe0) == OP_TOUCH)
+      {
+        _stats.touchPackets++;
+      }
+      else if (_tx[0] == OP_ADC_DATA)
+      {
+        _stats.adcPackets++;
+      }
+    }
+  }
+  if (_resultReady && _resultDelay)
+  {
+    _resultDelay--;
+  }
+
+  // Take in the byte from the badge: 0x00 between packets, then an opcode and its payload
+  if (_rxOp)
+  {
+    _rxBuf[_rxPos++] = b;
+    if (_rxPos == TINYUI_PAYLOAD_LENGTH)
+    {
+      _received();
+      _rxOp = 0;
+    }
+  }
+  else if (b)
+  {
+    _rxOp = b;
+    _rxPos = 0;
+  }
+
+  // Past the clock the model keeps up with, what it sends is a bit late
+  if (clock > _maxClock)
+  {
+    out = (out >> 1) | (out << 7);
+  }
+  return out;
+}
+
+void AttinyModel::_nextPacket(void)
+{
+  uint8_t i;
+
+  if (_resultReady && !_resultDelay)
+  {
+    memcpy(_tx, _result, TINYUI_PACKET_LENGTH);
+    _resultReady = false;
+  }
+  else if (_sendTouch)
+  {
+    _tx[0] = OP_TOUCH | _touched;
+    for (i = 0; i < TINYUI_BUTTON_COUNT; i++)
+    {
+      _tx[1 + i] = _presses[i];
+      _tx[1 + TINYUI_BUTTON_COUNT + 2 * i] = _readings[i] & 0xff;
+      _tx[2 + TINYUI_BUTTON_COUNT + 2 * i] = _readings[i] >> 8;
+    }
+    _sendTouch = false;
+  }
+  else if (_sendAdc)
+  {
+    _tx[0] = OP_ADC_DATA;
+    memset(_tx + 1, 0, TINYUI_PAYLOAD_LENGTH);
+    for (i = 0; i < TINYUI_POWER_COUNT; i++)
+    {
+      _tx[1 + 2 * i] = _adc[i] & 0xff;
+      _tx[2 + 2 * i] = _adc[i] >> 8;
+    }
+    _sendAdc = false;
+  }
+  else
+  {
+    return;
+  }
+  _txPos = 0;
+}
+
+void AttinyModel::_received(void)
+{
+  uint8_t i;
+
+  _stats.packets++;
+  switch (_rxOp)
+  {
+    case OP_TRANSITION:
+      memcpy(_trans, _rxBuf, TINYUI_LED_COUNT);
+      _stats.ledPackets++;
+      break;
+    case OP_DIM:
+    case OP_PULSE:
+      for (i = 0; i < TINYUI_LED_COUNT; i++)
+      {
+        if (_trans[i] != TINYUI_TRANS_IGNORE)
+        {
+          ((_rxOp == OP_DIM) ? _dim : _pulse)[i] = _rxBuf[i];
+        }
+      }
+      _stats.ledPackets++;
+      break;
+    case OP_PULSE_CMP:
+      memcpy(_pulseLength, _rxBuf, TINYUI_LED_COUNT);
+      break;
+    case OP_BLING_MODE:
+      memcpy(_bling, _rxBuf, TINYUI_PAYLOAD_LENGTH);
+      break;
+    case OP_NAVHASH_IVS:
+      _navHashRequest();
+      break;
+    case OP_NVM_REQUEST:
+      _nvmRequest();
+      break;
+  }
+}
+
+void AttinyModel::_navHashRequest(void)
+{
+  uint8_t i;
+  uint32_t h;
+
+  // Each of the three values is hashed with its length
+  _result[0] = OP_NAVHASH_OUT;
+  memcpy(_result + 1, _rxBuf, TINYUI_PAYLOAD_LENGTH);
+  for (i = 0; i < 3; i++)
+  {
+    memcpy(&h, _rxBuf + 3 + 4 * i, 4);
+    h = _hash(h, _rxBuf + i, 1);
+    memcpy(_result + 4 + 4 * i, &h, 4);
+  }
+  _resultReady = true;
+  _resultDelay = ATTINY_RESULT_LATENCY;
+}
+
+void AttinyModel::_nvmRequest(void)
+{
+  uint8_t op, n, i, *data;
+  uint16_t addr;
+  uint32_t h;
+  boolean ok;
+
+  _stats.nvmRequests++;
+  op = _rxBuf[0] & NVM_OP_MASK;
+  n = _rxBuf[0] & NVM_LEN_MASK;
+  addr = _rxBuf[1] | (_rxBuf[2] << 8);
+  _result[0] = OP_NVM_RESULT;
+  memcpy(_result + 1, _rxBuf, TINYUI_PAYLOAD_LENGTH);
+  data = _result + 4;
+  ok = (n <= TINYUI_NVM_BUFFER_SIZE);
+  if (_failures)
+  {
+    _failures--;
+    ok = false;
+  }
+  else if (ok)
+  {
+    switch (op)
+    {
+      case NVM_OP_FLASH_READ:
+        ok = ((uint32_t) addr + n <= ATTINY_FLASH_SIZE);
+        for (i = 0; ok && (i < n); i++)
+        {
+          data[i] = ((addr + i) * 37 + ((addr + i) >> 8)) & 0xff;
+        }
+        break;
+      case NVM_OP_EEPROM_READ:
+        ok = ((uint32_t) addr + n <= ATTINY_EEPROM_SIZE);
+        if (ok)
+        {
+          memcpy(data, _eeprom + addr, n);
+        }
+        break;
+      case NVM_OP_EEPROM_WRITE:
+        ok = ((uint32_t) addr + n <= ATTINY_EEPROM_SIZE);
+        if (ok)
+        {
+          memcpy(_eeprom + addr, data, n);
+          _stats.eepromWrites += n;
+        }
+        break;
+      case NVM_OP_ENCRYPT:
+      case NVM_OP_DECRYPT:
+        // each byte of a block is offset by a byte of the key (addr is the key index)
+        for (i = 0; i < n; i++)
+        {
+          data[i] += ((op == NVM_OP_ENCRYPT) ? 1 : -1) * (uint8_t) (0x5a + 17 * addr + 29 * (i % TINYUI_CRYPTO_BLOCK));
+        }
+        break;
+      case NVM_OP_HASH:
+        h = _hash(FNV_OFFSET ^ addr, data, n);
+        memset(data, 0, TINYUI_NVM_BUFFER_SIZE);
+        memcpy(data, &h, TINYUI_HASH_LENGTH);
+        break;
+      case NVM_OP_GET_SIZES:
+        data[0] = ATTINY_FLASH_SIZE & 0xff;
+        data[1] = ATTINY_FLASH_SIZE >> 8;
+        data[2] = ATTINY_EEPROM_SIZE & 0xff;
+        data[3] = ATTINY_EEPROM_SIZE >> 8;
+        break;
+      default:   // FLASH writes, and the reserved operations
+        ok = false;
+        break;
+    }
+  }
+  if (!ok)
+  {
+    _result[1] = NVM_OP_ERROR | n;
+    _stats.nvmFailures++;
+  }
+  _resultReady = true;
+  _resultDelay = ATTINY_RESULT_LATENCY;
+}
+
+uint32_t AttinyModel::_hash(uint32_t seed, const uint8_t *data, uint8_t len)
+{
+  uint8_t i;
+
+  for (i = 0; i < len; i++)
+  {
+    seed = (seed ^ data[i]) * FNV_PRIME;
+  }
+  return seed;
+}
+
+void AttinyModel::setReadings(const uint16_t *readings)
+{
+  memcpy(_readings, readings, sizeof(_readings));
+}
+
+void AttinyModel::setButtons(uint8_t mask)
+{
+  uint8_t h, bit;
+
+  // (touch packets list the buttons from TINYUI_BUTTON_SELECT, the top bit of the mask, down)
+  for (h = 0, bit = TINYUI_BUTTON_SELECT; h < TINYUI_BUTTON_COUNT; h++, bit >>= 1)
+  {
+    if ((mask & bit) && !(_touched & bit))
+    {
+      _presses[h]++;
+    }
+    _readings[h] = (mask & bit) ? ATTINY_READING_TOUCHED : ATTINY_READING_IDLE;
+  }
+  _touched = mask;
+}
+
+void AttinyModel::setPower(uint8_t source, uint16_t mv)
+{
+  if (source < TINYUI_POWER_COUNT)
+  {
+    _adc[source] = (uint32_t) mv * 2 / 11;   // (TinyUI::getPower() multiplies by 5.5)
+  }
+}
+
+void AttinyModel::setMaxClock(uint32_t clock)
+{
+  _maxClock = clock;
+}
+
+void AttinyModel::failNvm(uint8_t count)
+{
+  _failures = count;
+}
+
+uint8_t AttinyModel::getPixel(uint8_t n)
+{
+  return (n < TINYUI_LED_COUNT) ? _dim[n] : 0;
+}
+
+uint8_t AttinyModel::getPulse(uint8_t n)
+{
+  return (n < TINYUI_LED_COUNT) ? _pulse[n] : 0;
+}
+
+uint8_t *AttinyModel::getEeprom(void)
+{
+  return _eeprom;
+}
+
+const AttinyModelStats *AttinyModel::getStats(void)
+{
+  return &_stats;
+}
@@ -0,0 +1,86 @@
+/*
+  AttinyModel.h - Model of the ATTINY88 end of the TinyUI SPI link, for running the badge code on the host.
+  Released under the MIT License.
+*/
+
+#ifndef AttinyModel_h
+#define AttinyModel_h
+
+#include "Arduino.h"
+#include "Host.h"
+#include "TinyUI.h"
+
+// The model follows TinyUI.cpp's side of the protocol, not the ATTINY88's firmware (which isn't in this tree), so it shows how
+// the badge code drives the link, not how fast the real chip answers. What it assumes:
+// - every transaction starts with a touch packet and then an ADC data packet, followed by 0x00 between packets
+// - an NVM or NavHash result goes out ATTINY_RESULT_LATENCY bytes after the request's last byte, ahead of anything not started yet
+// - the EEPROM is the ATTINY88's 64 bytes; FLASH reads give a fixed pattern, and FLASH writes fail
+// - encryption is a reversible toy cipher on 4 byte blocks and hashing is FNV-1a, keyed by the key or IV index
+// - above the highest clock it can keep up with, every byte it sends comes back shifted by a bit
+#define ATTINY_RESULT_LATENCY     6                   // bytes between a request and the start of its result
+#define ATTINY_FLASH_SIZE         8192
+#define ATTINY_EEPROM_SIZE        64
+#define ATTINY_MAX_CLOCK          2000000             // default highest clock the model keeps up with
+#define ATTINY_READING_IDLE       1000                // default capacitive reading of an untouched button
+#define ATTINY_READING_TOUCHED    700                 // ...and of a touched one (setButtons())
+
+// traffic the model has seen
+typedef struct {
+  uint32_t transactions;                              // chip select going low
+  uint32_t packets;                                   // packets received
+  uint32_t ledPackets;                                // dimming, pulsing, and transition packets received
+  uint32_t nvmRequests;                               // NVM requests received
+  uint32_t nvmFailures;                               // NVM requests answered with an error
+  uint32_t eepromWrites;                              // EEPROM bytes written
+  uint32_t touchPackets;                              // touch packets sent in full
+  uint32_t adcPackets;                                // ADC data packets sent in full
+} AttinyModelStats;
+
+class AttinyModel : public HostSpiDevice
+{
+  public:
+    AttinyModel(void);
+    void select(boolean selected);
+    uint8_t transfer(uint8_t b, uint32_t clock);
+    void setReadings(const uint16_t *readings);             // capacitive readings of the TINYUI_BUTTON_COUNT buttons in touch packet order (TINYUI_BUTTON_SELECT first)
+    void setButtons(uint8_t mask);                          // touch the TINYUI_BUTTON_... buttons in mask and release the rest
+    void setPower(uint8_t source, uint16_t mv);             // supply voltage of a TINYUI_POWER_... source
+    void setMaxClock(uint32_t clock);                       // highest SPI clock the model keeps up with
+    void failNvm(uint8_t count);                            // answer the next count NVM requests with an error
+    uint8_t getPixel(uint8_t n);                            // dimming value of LED n as last received
+    uint8_t getPulse(uint8_t n);                            // pulsing period of LED n as last received
+    uint8_t *getEeprom(void);
+    const AttinyModelStats *getStats(void);
+  private:
+    AttinyModelStats _stats;
+    boolean _selected;
+    uint32_t _maxClock;
+    uint8_t _failures;
+    uint8_t _eeprom[ATTINY_EEPROM_SIZE];
+    uint16_t _readings[TINYUI_BUTTON_COUNT];
+    uint8_t _touched;
+    uint8_t _presses[TINYUI_BUTTON_COUNT];
+    uint16_t _adc[TINYUI_POWER_COUNT];
+    uint8_t _dim[TINYUI_LED_COUNT];
+    uint8_t _pulse[TINYUI_LED_COUNT];
+    uint8_t _pulseLength[TINYUI_LED_COUNT];
+    uint8_t _trans[TINYUI_LED_COUNT];                       // transitions for the rest of the transaction
+    uint8_t _bling[TINYUI_PAYLOAD_LENGTH];
+    uint8_t _rxOp;                                          // packet being received (0 between packets)
+    uint8_t _rxPos;
+    uint8_t _rxBuf[TINYUI_PAYLOAD_LENGTH];
+    uint8_t _tx[TINYUI_PACKET_LENGTH];                      // packet being sent
+    uint8_t _txPos;                                         // (TINYUI_PACKET_LENGTH between packets)
+    boolean _sendTouch;                                     // the touch packet is still to be sent in this transaction
+    boolean _sendAdc;                                       // ...and the ADC data packet
+    uint8_t _result[TINYUI_PACKET_LENGTH];                  // NVM or NavHash result waiting to be sent
+    uint8_t _resultDelay;                                   // bytes until it can go
+    boolean _resultReady;
+    void _received(void);
+    void _nvmRequest(void);
+    void _navHashRequest(void);
+    void _nextPacket(void);
+    static uint32_t _hash(uint32_t seed, const uint8_t *data, uint8_t len);
+};
+
+#endif
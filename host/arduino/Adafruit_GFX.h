@@ -0,0 +1,11 @@
+/*
+  Adafruit_GFX.h - Host stand-in for the Adafruit graphics library (see Adafruit_SSD1306.h).
+  Released under the MIT License.
+*/
+
+#ifndef _ADAFRUIT_GFX_H
+#define _ADAFRUIT_GFX_H
+
+#include "Arduino.h"
+
+#endif
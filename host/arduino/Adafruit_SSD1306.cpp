@@ -0,0 +1,170 @@
+/*
+  Adafruit_SSD1306.cpp - Host stand-in for the Adafruit SSD1306 display library, keeping the text on the screen.
+  Released under the MIT License.
+*/
+
+#include "Adafruit_SSD1306.h"
+
+#define CHAR_WIDTH    6
+#define CHAR_HEIGHT   8
+
+Adafruit_SSD1306::Adafruit_SSD1306(int8_t dc, int8_t rst, int8_t cs)
+{
+  _x = 0;
+  _y = 0;
+  _color = WHITE;
+  _bg = WHITE;
+  _wrap = true;
+  _frames = 0;
+  clearDisplay();
+  memcpy(_screen, _buffer, sizeof(_screen));
+  memcpy(_screenInverted, _inverted, sizeof(_screenInverted));
+}
+
+void Adafruit_SSD1306::begin(uint8_t vccstate, uint8_t i2caddr, bool reset)
+{
+}
+
+void Adafruit_SSD1306::display(void)
+{
+  memcpy(_screen, _buffer, sizeof(_screen));
+  memcpy(_screenInverted, _inverted, sizeof(_screenInverted));
+  _frames++;
+}
+
+void Adafruit_SSD1306::clearDisplay(void)
+{
+  _clearCells(0, 0, SSD1306_LCDWIDTH, SSD1306_LCDHEIGHT);
+}
+
+// Blanks the character cells a rectangle covers (a partly covered cell counts; the badge only clears whole rows)
+void Adafruit_SSD1306::_clearCells(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  int16_t r, c;
+
+  for (r = y / CHAR_HEIGHT; (r < SSD1306_ROWS) && (r * CHAR_HEIGHT < y + h); r++)
+  {
+    if (r < 0)
+    {
+      continue;
+    }
+    for (c = x / CHAR_WIDTH; (c < SSD1306_COLUMNS) && (c * CHAR_WIDTH < x + w); c++)
+    {
+      if (c >= 0)
+      {
+        _buffer[r][c] = ' ';
+      }
+    }
+    _buffer[r][SSD1306_COLUMNS] = '\0';
+    if ((x <= 0) && (x + w >= SSD1306_LCDWIDTH))
+    {
+      _inverted[r] = false;
+    }
+  }
+}
+
+void Adafruit_SSD1306::setTextSize(uint8_t s)
+{
+}
+
+void Adafruit_SSD1306::setTextColor(uint16_t c)
+{
+  _color = c;
+  _bg = c;   // (as the real library: the same colors mean a transparent background)
+}
+
+void Adafruit_SSD1306::setTextColor(uint16_t c, uint16_t bg)
+{
+  _color = c;
+  _bg = bg;
+}
+
+void Adafruit_SSD1306::setTextWrap(bool w)
+{
+  _wrap = w;
+}
+
+void Adafruit_SSD1306::setCursor(int16_t x, int16_t y)
+{
+  _x = x;
+  _y = y;
+}
+
+int16_t Adafruit_SSD1306::getCursorX(void)
+{
+  return _x;
+}
+
+int16_t Adafruit_SSD1306::getCursorY(void)
+{
+  return _y;
+}
+
+void Adafruit_SSD1306::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  _clearCells(x, y, w, h);
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+}
+
+void Adafruit_SSD1306::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+}
+
+void Adafruit_SSD1306::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+}
+
+void Adafruit_SSD1306::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
+{
+}
+
+size_t Adafruit_SSD1306::write(uint8_t c)
+{
+  int16_t r, col;
+
+  if (c == '\n')
+  {
+    _x = 0;
+    _y += CHAR_HEIGHT;
+    return 1;
+  }
+  if (c == '\r')
+  {
+    return 1;
+  }
+  if (_wrap && (_x + CHAR_WIDTH > SSD1306_LCDWIDTH))
+  {
+    _x = 0;
+    _y += CHAR_HEIGHT;
+  }
+  r = _y / CHAR_HEIGHT;
+  col = _x / CHAR_WIDTH;
+  if ((_y >= 0) && (r < SSD1306_ROWS) && (_x >= 0) && (col < SSD1306_COLUMNS))
+  {
+    _buffer[r][col] = ((c >= ' ') && (c < 0x7f)) ? c : '?';
+    if ((_color == BLACK) && (_bg == WHITE))
+    {
+      _inverted[r] = true;
+    }
+  }
+  _x += CHAR_WIDTH;
+  return 1;
+}
+
+const char *Adafruit_SSD1306::getScreen(uint8_t row)
+{
+  return (row < SSD1306_ROWS) ? _screen[row] : "";
+}
+
+bool Adafruit_SSD1306::isInverted(uint8_t row)
+{
+  return (row < SSD1306_ROWS) && _screenInverted[row];
+}
+
+uint32_t Adafruit_SSD1306::getFrames(void)
+{
+  return _frames;
+}
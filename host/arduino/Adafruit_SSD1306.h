@@ -0,0 +1,62 @@
+/*
+  Adafruit_SSD1306.h - Host stand-in for the Adafruit SSD1306 display library. It keeps the text printed on the screen
+  (in the 6x8 font at text size 1, 21 characters by 4 rows) rather than pixels, so a run can show what was on the screen.
+  Released under the MIT License.
+*/
+
+#ifndef _Adafruit_SSD1306_H_
+#define _Adafruit_SSD1306_H_
+
+#include "Arduino.h"
+#include "Adafruit_GFX.h"
+
+#define BLACK 0
+#define WHITE 1
+#define INVERSE 2
+
+#define SSD1306_EXTERNALVCC 0x1
+#define SSD1306_SWITCHCAPVCC 0x2
+
+#define SSD1306_LCDWIDTH 128
+#define SSD1306_LCDHEIGHT 32
+
+#define SSD1306_COLUMNS (SSD1306_LCDWIDTH / 6)
+#define SSD1306_ROWS (SSD1306_LCDHEIGHT / 8)
+
+class Adafruit_SSD1306 : public Print
+{
+  public:
+    Adafruit_SSD1306(int8_t dc, int8_t rst, int8_t cs);
+    void begin(uint8_t vccstate = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0x3c, bool reset = true);
+    void display(void);                                     // (the buffer becomes what getScreen() shows)
+    void clearDisplay(void);
+    void setTextSize(uint8_t s);
+    void setTextColor(uint16_t c);
+    void setTextColor(uint16_t c, uint16_t bg);
+    void setTextWrap(bool w);
+    void setCursor(int16_t x, int16_t y);
+    int16_t getCursorX(void);
+    int16_t getCursorY(void);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color);
+    size_t write(uint8_t c);
+    using Print::write;
+    const char *getScreen(uint8_t row);                     // (host only) text of a row as last pushed by display()
+    bool isInverted(uint8_t row);                           // (host only) true if that row had inverted (highlighted) text on it
+    uint32_t getFrames(void);                               // (host only) number of display() calls
+  private:
+    char _buffer[SSD1306_ROWS][SSD1306_COLUMNS + 1];
+    char _screen[SSD1306_ROWS][SSD1306_COLUMNS + 1];
+    bool _inverted[SSD1306_ROWS];                           // (for _buffer)
+    bool _screenInverted[SSD1306_ROWS];                     // (for _screen)
+    int16_t _x, _y;
+    uint16_t _color, _bg;
+    bool _wrap;
+    uint32_t _frames;
+    void _clearCells(int16_t x, int16_t y, int16_t w, int16_t h);
+};
+
+#endif
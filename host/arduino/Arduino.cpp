@@ -0,0 +1,369 @@
+/*
+  Arduino.cpp - Host stand-in for the Arduino core: the virtual clock, Print, the serial ports, random(), and the registers.
+  Released under the MIT License.
+*/
+
+#include <math.h>
+#include <avr/sleep.h>
+#include "Arduino.h"
+#include "Host.h"
+
+volatile uint8_t SPCR, SPSR;
+volatile uint8_t PORTB, PORTC, PORTD, PORTE, PORTF, DDRB, DDRC, DDRD, DDRE, DDRF;
+volatile uint8_t TCCR1A, TCCR1B;
+volatile uint16_t SP = RAMEND;
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+static uint64_t _nanos = 0;
+static uint16_t _timer1Base = 0;                            // Timer1 count at the virtual clock's start (TCNT1 = x sets it)
+
+uint64_t hostNanos(void)
+{
+  return _nanos;
+}
+
+void hostAdvance(uint32_t us)
+{
+  _nanos += (uint64_t) us * 1000;
+}
+
+void hostAdvanceNanos(uint32_t ns)
+{
+  _nanos += ns;
+}
+
+unsigned long millis(void)
+{
+  return (uint32_t) (_nanos / 1000000);
+}
+
+unsigned long micros(void)
+{
+  return (uint32_t) (_nanos / 1000);
+}
+
+void delay(unsigned long ms)
+{
+  _nanos += (uint64_t) ms * 1000000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  hostAdvance(us);
+}
+
+// Idle sleep lasts until the next interrupt, and the millis() timer's is never more than a tick away
+void sleep_cpu(void)
+{
+  _nanos = (_nanos / 1000000 + 1) * 1000000;
+}
+
+// Timer1 as the profiler sets it up: counting at 16MHz / 64
+_HostTimer1 TCNT1;
+
+_HostTimer1::operator uint16_t() const
+{
+  return (uint16_t) (_nanos / 4000) - _timer1Base;
+}
+
+_HostTimer1 &_HostTimer1::operator=(uint16_t v)
+{
+  _timer1Base = (uint16_t) (_nanos / 4000) - v;
+  return *this;
+}
+
+// avr-libc's random(): the "minimal standard" generator, so a seed gives the same numbers as on the badge
+static uint32_t _randomState = 1;
+
+static long _random(void)
+{
+  int32_t hi, lo, x;
+
+  x = _randomState ? _randomState : 123459876;
+  hi = x / 127773;
+  lo = x % 127773;
+  x = 16807 * lo - 2836 * hi;
+  if (x < 0)
+  {
+    x += 0x7fffffff;
+  }
+  _randomState = x;
+  return x;
+}
+
+long random(long howbig)
+{
+  return howbig ? _random() % howbig : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+  return (howsmall >= howbig) ? howsmall : random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed)
+  {
+    _randomState = seed;
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+  return LOW;
+}
+
+// Print, as the Arduino core's (line ends are \r\n)
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (size--)
+  {
+    if (!write(*buffer++))
+    {
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s)
+{
+  return print((const char *) s);
+}
+
+size_t Print::print(const char *s)
+{
+  return write(s);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char n, int base)
+{
+  return print((unsigned long) n, base);
+}
+
+size_t Print::print(int n, int base)
+{
+  return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+  return print((unsigned long) n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+  if (!base)
+  {
+    return write((uint8_t) n);
+  }
+  if ((base == DEC) && (n < 0))
+  {
+    return print('-') + _printNumber(-(unsigned long) n, DEC);
+  }
+  return _printNumber((uint32_t) n, base);   // (other bases print a negative number's 32-bit two's complement, as on the badge)
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  return base ? _printNumber(n, base) : write((uint8_t) n);
+}
+
+size_t Print::print(double n, int digits)
+{
+  return _printFloat(n, digits);
+}
+
+size_t Print::println(void)
+{
+  return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper *s)
+{
+  return print(s) + println();
+}
+
+size_t Print::println(const char *s)
+{
+  return print(s) + println();
+}
+
+size_t Print::println(char c)
+{
+  return print(c) + println();
+}
+
+size_t Print::println(unsigned char n, int base)
+{
+  return print(n, base) + println();
+}
+
+size_t Print::println(int n, int base)
+{
+  return print(n, base) + println();
+}
+
+size_t Print::println(unsigned int n, int base)
+{
+  return print(n, base) + println();
+}
+
+size_t Print::println(long n, int base)
+{
+  return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long n, int base)
+{
+  return print(n, base) + println();
+}
+
+size_t Print::println(double n, int digits)
+{
+  return print(n, digits) + println();
+}
+
+size_t Print::_printNumber(unsigned long n, uint8_t base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  char c;
+
+  *str = '\0';
+  if (base < 2)
+  {
+    base = 10;
+  }
+  do
+  {
+    c = n % base;
+    n /= base;
+    *--str = (c < 10) ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::_printFloat(double number, uint8_t digits)
+{
+  size_t n = 0;
+  uint8_t i;
+  double rounding, remainder;
+  unsigned long whole;
+  unsigned int toPrint;
+
+  if (isnan(number))
+  {
+    return print("nan");
+  }
+  if (isinf(number))
+  {
+    return print("inf");
+  }
+  if ((number > 4294967040.0) || (number < -4294967040.0))
+  {
+    return print("ovf");
+  }
+  if (number < 0.0)
+  {
+    n += print('-');
+    number = -number;
+  }
+  rounding = 0.5;
+  for (i = 0; i < digits; i++)
+  {
+    rounding /= 10.0;
+  }
+  number += rounding;
+  whole = (unsigned long) number;
+  remainder = number - (double) whole;
+  n += print(whole);
+  if (digits > 0)
+  {
+    n += print('.');
+  }
+  while (digits-- > 0)
+  {
+    remainder *= 10.0;
+    toPrint = (unsigned int) remainder;
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
+
+// The serial ports
+
+HardwareSerial::HardwareSerial(void)
+{
+  _in = NULL;
+  _inLen = 0;
+  _inPos = 0;
+  _out = NULL;
+}
+
+int HardwareSerial::available(void)
+{
+  return _inLen - _inPos;
+}
+
+int HardwareSerial::read(void)
+{
+  return (_inPos < _inLen) ? (uint8_t) _in[_inPos++] : -1;
+}
+
+int HardwareSerial::peek(void)
+{
+  return (_inPos < _inLen) ? (uint8_t) _in[_inPos] : -1;
+}
+
+size_t HardwareSerial::write(uint8_t b)
+{
+  if (_out)
+  {
+    fputc(b, (FILE *) _out);
+  }
+  return 1;
+}
+
+void HardwareSerial::_setInput(const char *data, size_t len)
+{
+  _in = data;
+  _inLen = len;
+  _inPos = 0;
+}
+
+void HardwareSerial::_setOutput(void *file)
+{
+  _out = file;
+}
+
+void hostSetSerialInput(HardwareSerial *port, const char *data, size_t len)
+{
+  port->_setInput(data, len);
+}
+
+void hostSetSerialOutput(HardwareSerial *port, FILE *out)
+{
+  port->_setOutput(out);
+}
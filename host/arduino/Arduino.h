@@ -0,0 +1,136 @@
+/*
+  Arduino.h - Host stand-in for the Arduino core, so the badge code can be built and run on a PC (see host/README.md).
+  Released under the MIT License.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#ifndef F_CPU
+#define F_CPU 16000000L
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "binary.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define bit(b) (1UL << (b))
+
+// the Leonardo's RX and TX LEDs (the badge hands them to the ATTINY88)
+#define TXLED0 do {} while (0)
+#define TXLED1 do {} while (0)
+#define RXLED0 do {} while (0)
+#define RXLED1 do {} while (0)
+
+// time runs on the host's virtual clock (see Host.h), so it only moves when the code waits, sleeps, or clocks bytes over SPI
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+inline void noInterrupts(void) {}
+inline void interrupts(void) {}
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class Print
+{
+  public:
+    virtual ~Print(void) {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return str ? write((const uint8_t *) str, strlen(str)) : 0; }
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t println(const __FlashStringHelper *s);
+    size_t println(const char *s);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+    size_t println(void);
+  private:
+    size_t _printNumber(unsigned long n, uint8_t base);
+    size_t _printFloat(double n, uint8_t digits);
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+    virtual void flush(void) {}
+};
+
+// Serial is the USB serial port and Serial1 the ESP module's; what is written to them and what they have to read is set up
+// through Host.h
+class HardwareSerial : public Stream
+{
+  public:
+    HardwareSerial(void);
+    void begin(unsigned long baud) {}
+    void end(void) {}
+    operator bool(void) { return true; }
+    int availableForWrite(void) { return 64; }
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t b);
+    using Print::write;
+    void _setInput(const char *data, size_t len);           // (see Host.h)
+    void _setOutput(void *file);
+  private:
+    const char *_in;
+    size_t _inLen;
+    size_t _inPos;
+    void *_out;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
@@ -0,0 +1,42 @@
+/*
+  Host.h - Controls for the host build's stand-ins for the badge hardware: the virtual clock, the serial ports, the SPI bus,
+  and the ATmega32U4's EEPROM.
+  Released under the MIT License.
+*/
+
+#ifndef Host_h
+#define Host_h
+
+#include <stdio.h>
+#include "Arduino.h"
+
+// The virtual clock starts at 0 and only moves when the code running on it waits: delay(), sleeping (which moves on to the
+// next millis() tick), and clocking bytes over SPI (8 bit times each at the clock the transaction was started with). Code
+// between those takes no time at all, so a run is the same every time, but figures that time code (the task scheduler's,
+// the profiler's) only count the waits.
+uint64_t hostNanos(void);                                   // nanoseconds since the start
+void hostAdvance(uint32_t us);                              // move the clock on
+void hostAdvanceNanos(uint32_t ns);
+
+// Serial is the USB serial port and Serial1 the ESP module's. A port reads from a block of memory (which has to stay put
+// while it is being read) and writes to a file; with no file, what is written is thrown away.
+void hostSetSerialInput(HardwareSerial *port, const char *data, size_t len);
+void hostSetSerialOutput(HardwareSerial *port, FILE *out);
+
+// The device on the other end of the SPI bus (the ATTINY model, see AttinyModel.h). With none, every byte reads back 0.
+class HostSpiDevice
+{
+  public:
+    virtual ~HostSpiDevice(void) {}
+    virtual void select(boolean selected) = 0;              // chip select went low (true) or high (false)
+    virtual uint8_t transfer(uint8_t b, uint32_t clock) = 0;   // exchange a byte, clocked at clock Hz
+};
+
+void hostSetSpiDevice(HostSpiDevice *device);
+uint32_t hostGetSpiBytes(void);                             // bytes clocked over SPI so far
+
+// The ATmega32U4's EEPROM starts erased (all 0xff)
+uint8_t *hostGetEeprom(void);
+uint32_t hostGetEepromWrites(void);                         // bytes written that changed
+
+#endif
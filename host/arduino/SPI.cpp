@@ -0,0 +1,82 @@
+/*
+  SPI.cpp - Host stand-in for the Arduino SPI library and the SPI registers, passing bytes to the device set with
+  hostSetSpiDevice(). Writing SPDR with the SPI interrupt enabled runs the interrupt as the byte completes, so a background
+  update runs to its end (with the virtual clock moved on by its bytes) before the write that started it returns.
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "Host.h"
+
+SPIClass SPI;
+_HostSpdr SPDR;
+
+extern "C" void SPI_STC_vect(void) __attribute__((weak));
+
+static HostSpiDevice *_device = NULL;
+static uint32_t _clock = 4000000;                            // clock of the transaction in progress
+static uint32_t _bytes = 0;
+static boolean _interruptPending = false;
+static boolean _inInterrupt = false;
+
+void hostSetSpiDevice(HostSpiDevice *device)
+{
+  _device = device;
+}
+
+uint32_t hostGetSpiBytes(void)
+{
+  return _bytes;
+}
+
+static uint8_t _transfer(uint8_t b)
+{
+  _bytes++;
+  hostAdvanceNanos(8000000000ULL / _clock);   // (8 bit times)
+  SPSR |= _BV(SPIF);
+  return _device ? _device->transfer(b, _clock) : 0;
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+  _clock = settings._clock;
+  if (_device)
+  {
+    _device->select(true);
+  }
+}
+
+void SPIClass::endTransaction(void)
+{
+  if (_device)
+  {
+    _device->select(false);
+  }
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  return _transfer(data);
+}
+
+_HostSpdr &_HostSpdr::operator=(uint8_t b)
+{
+  v = _transfer(b);
+  if ((SPCR & _BV(SPIE)) && SPI_STC_vect)
+  {
+    // The interrupt writes the next byte from inside itself; run those one after another rather than nested
+    _interruptPending = true;
+    if (!_inInterrupt)
+    {
+      _inInterrupt = true;
+      while (_interruptPending)
+      {
+        _interruptPending = false;
+        SPI_STC_vect();
+      }
+      _inInterrupt = false;
+    }
+  }
+  return *this;
+}
@@ -0,0 +1,40 @@
+/*
+  SPI.h - Host stand-in for the Arduino SPI library; bytes go to the ATTINY model (see Host.h), one byte time at a time on
+  the virtual clock.
+  Released under the MIT License.
+*/
+
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0c
+
+class SPISettings
+{
+  public:
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : _clock(clock) {}
+    SPISettings(void) : _clock(4000000) {}
+  private:
+    uint32_t _clock;
+    friend class SPIClass;
+};
+
+class SPIClass
+{
+  public:
+    static void begin(void) {}
+    static void end(void) {}
+    static void beginTransaction(SPISettings settings);     // (the ATTINY model takes this as chip select going low)
+    static void endTransaction(void);                       // (and this as it going high)
+    static uint8_t transfer(uint8_t data);
+    static void usingInterrupt(uint8_t interruptNumber) {}
+};
+
+extern SPIClass SPI;
+
+#endif
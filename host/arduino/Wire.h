@@ -0,0 +1,9 @@
+/*
+  Wire.h - Host stand-in for the Arduino I2C library (the display stand-in doesn't need it).
+  Released under the MIT License.
+*/
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#endif
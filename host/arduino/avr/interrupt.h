@@ -0,0 +1,13 @@
+/*
+  avr/interrupt.h - Host stand-in for avr-libc's interrupt handling; an ISR is an ordinary function the host's stand-ins call.
+  Released under the MIT License.
+*/
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+#define sei()
+#define cli()
+
+#endif
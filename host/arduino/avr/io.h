@@ -0,0 +1,56 @@
+/*
+  avr/io.h - Host stand-in for the ATmega32U4's registers: the ones the badge code uses are plain variables, except SPDR,
+  which clocks a byte through the ATTINY model (see Host.h), and TCNT1, which counts on the virtual clock.
+  Released under the MIT License.
+*/
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+struct _HostSpdr
+{
+  uint8_t v;
+  operator uint8_t() const { return v; }
+  _HostSpdr &operator=(uint8_t b);                           // sends b and takes in the byte the ATTINY model sends back
+};
+
+struct _HostTimer1
+{
+  operator uint16_t() const;
+  _HostTimer1 &operator=(uint16_t v);
+};
+
+extern _HostSpdr SPDR;
+extern _HostTimer1 TCNT1;
+extern volatile uint8_t SPCR, SPSR;
+extern volatile uint8_t PORTB, PORTC, PORTD, PORTE, PORTF, DDRB, DDRC, DDRD, DDRE, DDRF;
+extern volatile uint8_t TCCR1A, TCCR1B;
+extern volatile uint16_t SP;
+
+// SPCR
+#define SPIE    7
+#define SPE     6
+#define DORD    5
+#define MSTR    4
+#define CPOL    3
+#define CPHA    2
+#define SPR1    1
+#define SPR0    0
+// SPSR
+#define SPIF    7
+#define WCOL    6
+#define SPI2X   0
+// TCCR1B
+#define CS12    2
+#define CS11    1
+#define CS10    0
+
+#define RAMSTART 0x100
+#define RAMEND   0x0aff
+#define E2END    0x3ff
+
+#endif
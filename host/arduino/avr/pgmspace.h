@@ -0,0 +1,34 @@
+/*
+  avr/pgmspace.h - Host stand-in for avr-libc's program space access; on the host, PROGMEM data is ordinary data.
+  Released under the MIT License.
+*/
+
+#ifndef __PGMSPACE_H_
+#define __PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)   (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)   (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)  (*(const uint32_t *)(addr))
+
+// pgm_read_ptr() gives a void * on the AVR, which C converts to any pointer; this does the same for C++
+struct _pgm_ptr
+{
+  const void *p;
+  template <class T> operator T *() const { return (T *) p; }
+};
+#define pgm_read_ptr(addr)    (_pgm_ptr { *(const void * const *)(addr) })
+
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+
+#endif
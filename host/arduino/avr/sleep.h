@@ -0,0 +1,22 @@
+/*
+  avr/sleep.h - Host stand-in for avr-libc's sleep modes; sleeping moves the virtual clock on to the next millis() tick,
+  which is the latest the timer interrupt would wake the CPU.
+  Released under the MIT License.
+*/
+
+#ifndef _AVR_SLEEP_H_
+#define _AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_ADC          1
+#define SLEEP_MODE_PWR_DOWN     2
+#define SLEEP_MODE_PWR_SAVE     3
+#define SLEEP_MODE_STANDBY      6
+#define SLEEP_MODE_EXT_STANDBY  7
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+void sleep_cpu(void);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+  eeprom.cpp - Host stand-in for avr-libc's EEPROM access, on the ATmega32U4's 1KB of EEPROM held in memory.
+  Released under the MIT License.
+*/
+
+#include <avr/eeprom.h>
+#include "Host.h"
+
+static uint32_t _writes = 0;
+
+// (erased the first time it is used, so it is erased even for a constructor that runs before this file's)
+static uint8_t *_data(void)
+{
+  static uint8_t eeprom[E2END + 1];
+  static boolean erased = false;
+
+  if (!erased)
+  {
+    memset(eeprom, 0xff, sizeof(eeprom));
+    erased = true;
+  }
+  return eeprom;
+}
+
+uint8_t *hostGetEeprom(void)
+{
+  return _data();
+}
+
+uint32_t hostGetEepromWrites(void)
+{
+  return _writes;
+}
+
+static uint16_t _addr(const void *p)
+{
+  return (uintptr_t) p & E2END;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+  return _data()[_addr(p)];
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+  return eeprom_read_byte((const uint8_t *) p) | (eeprom_read_byte((const uint8_t *) p + 1) << 8);
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+  {
+    ((uint8_t *) dst)[i] = eeprom_read_byte((const uint8_t *) src + i);
+  }
+}
+
+void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+  _data()[_addr(p)] = value;
+  _writes++;
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+  if (_data()[_addr(p)] != value)
+  {
+    eeprom_write_byte(p, value);
+  }
+}
+
+void eeprom_update_word(uint16_t *p, uint16_t value)
+{
+  eeprom_update_byte((uint8_t *) p, value & 0xff);
+  eeprom_update_byte((uint8_t *) p + 1, value >> 8);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+  {
+    eeprom_update_byte((uint8_t *) dst + i, ((const uint8_t *) src)[i]);
+  }
+}
@@ -0,0 +1,14 @@
+/*
+  util/atomic.h - Host stand-in for avr-libc's atomic blocks; the host's interrupts only run when the code touches SPDR,
+  so every block is atomic already.
+  Released under the MIT License.
+*/
+
+#ifndef _UTIL_ATOMIC_H_
+#define _UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (int _atomicOnce = 1; _atomicOnce; _atomicOnce = 0)
+
+#endif
@@ -0,0 +1,23 @@
+/*
+  Bench.h - Checks for the host benchmarks: each one prints its figures, checks them with BENCH_CHECK(), and ends with
+  return benchResult(); so make bench fails if any check did.
+  Released under the MIT License.
+*/
+
+#ifndef Bench_h
+#define Bench_h
+
+#include <stdio.h>
+
+static int benchFailures = 0;
+
+#define BENCH_CHECK(cond) \
+  do { if (!(cond)) { printf("FAILED: %s (%s:%d)\n", #cond, __FILE__, __LINE__); benchFailures++; } } while (0)
+
+static inline int benchResult(void)
+{
+  printf(benchFailures ? "FAILED\n" : "ok\n");
+  return benchFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,292 @@
+/*
+  capsense.cpp - TinyUI's capacitive touch filter on a touch trace: touch packets go in through injectPacket(), and the button
+  down events that come out are compared with the press counts in the packets.
+  Usage: capsense [session.txt]
+  With no file the trace is synthetic: a packet every 5ms, baselines drifting down 150 counts and swinging 80 either way over
+  the run, +/-20 counts of noise on every reading, and 50 presses (80-200ms, falling 300 counts over 20ms and rising back as
+  fast) spread over the buttons. Its press counts go up on the packet where a press starts.
+  With a session recorded by the badge's 'r' serial command (see SessionLog.h), its S lines are the trace and the press counts
+  are the ATTINY88 firmware's own.
+  Checks:
+  - the filter finds as many presses on each button as the counts show
+  - no press is a glitch (released within CAPSENSE_GLITCH_MILLIS) and no button is taken to be stuck
+  - on the synthetic trace, every press is found within 20ms of it starting
+  The lag is from the packet where a count went up to the down event; on a recording it is against the ATTINY88's filter, so it
+  may be negative.
+  Released under the MIT License.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "TinyUI.h"
+#include "SessionLog.h"
+#include "bench/Bench.h"
+
+#define TRACE_PACKET_MILLIS   5
+#define TRACE_PRESSES         50
+#define TRACE_LEAD_MILLIS     1000      // before the first press, for the baselines and noise levels to settle
+#define TRACE_SPACING_MILLIS  500       // between the starts of presses
+#define TRACE_BASE            1000
+#define TRACE_DRIFT           150       // fall of the baselines over the run
+#define TRACE_SWING           80        // ...and their swing either way, once over the run
+#define TRACE_NOISE           20
+#define TRACE_DEPTH           300       // fall of a reading under a finger
+#define TRACE_RAMP_MILLIS     20
+#define TRACE_MAX_LAG         20
+#define OP_TOUCH              0x80
+#define PRESS_QUEUE           8         // count increments waiting for their down events, per button
+
+static AttinyModel attiny;
+static TinyUI ui;
+
+// What the run has seen
+static uint8_t lastCounts[TINYUI_BUTTON_COUNT];
+static boolean haveCounts = false;
+static uint16_t expected[TINYUI_BUTTON_COUNT];
+static uint16_t found[TINYUI_BUTTON_COUNT];
+static uint16_t pending[TINYUI_BUTTON_COUNT][PRESS_QUEUE];   // times the counts went up, not yet matched to a down event
+static uint8_t pendingCount[TINYUI_BUTTON_COUNT];
+static uint16_t early[TINYUI_BUTTON_COUNT];                  // down events ahead of the counts
+static int32_t lagTotal = 0;
+static int16_t lagMin = 32767, lagMax = -32768;
+static uint16_t lagged = 0;
+static uint32_t packets = 0;
+
+static void matched(int16_t lag)
+{
+  lagTotal += lag;
+  lagMin = (lag < lagMin) ? lag : lagMin;
+  lagMax = (lag > lagMax) ? lag : lagMax;
+  lagged++;
+}
+
+// Passes a packet from the trace to TinyUI at its time, and matches the down events that come out against the counts
+static void feed(uint32_t start, const SessionPacket *p)
+{
+  uint8_t h, i, n, c;
+  TinyUIButtonEvent events[TINYUI_EVENT_QUEUE_SIZE];
+
+  while ((long) (millis() - (start + p->time)) < 0)
+  {
+    delay(1);
+  }
+  ui.injectPacket(p->packet);
+  ui.poll();
+  if ((p->packet[0] & 0xe0) != OP_TOUCH)
+  {
+    return;
+  }
+  packets++;
+
+  for (h = 0; h < TINYUI_BUTTON_COUNT; h++)
+  {
+    c = p->packet[1 + h];
+    if (haveCounts)
+    {
+      for (; lastCounts[h] != c; lastCounts[h]++)
+      {
+        expected[h]++;
+        if (early[h])
+        {
+          early[h]--;
+          matched(0);
+        }
+        else if (pendingCount[h] < PRESS_QUEUE)
+        {
+          pending[h][pendingCount[h]++] = millis();
+        }
+      }
+    }
+    lastCounts[h] = c;
+  }
+  haveCounts = true;
+
+  while ((n = ui.getButtonEvents(events, TINYUI_EVENT_QUEUE_SIZE)))
+  {
+    for (i = 0; i < n; i++)
+    {
+      if (events[i].type != TINYUI_EVENT_DOWN)
+      {
+        continue;
+      }
+      for (h = 0; (h < TINYUI_BUTTON_COUNT) && !(events[i].button & (TINYUI_BUTTON_SELECT >> h)); h++) ;
+      found[h]++;
+      if (pendingCount[h])
+      {
+        matched((int16_t) (events[i].time - pending[h][0]));
+        memmove(pending[h], pending[h] + 1, --pendingCount[h] * sizeof(pending[h][0]));
+      }
+      else
+      {
+        early[h]++;   // (the lag for these is counted as 0 when the count catches up)
+      }
+    }
+  }
+}
+
+static void le16(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static void runSynthetic(uint32_t start)
+{
+  SessionPacket p;
+  uint32_t t, end, pressStart[TRACE_PRESSES];
+  uint16_t pressLength[TRACE_PRESSES];
+  uint8_t pressButton[TRACE_PRESSES], counts[TINYUI_BUTTON_COUNT];
+  uint8_t h, k;
+  int32_t base, reading, depth, since;
+
+  randomSeed(41);
+  for (k = 0; k < TRACE_PRESSES; k++)
+  {
+    pressStart[k] = TRACE_LEAD_MILLIS + k * TRACE_SPACING_MILLIS + random(0, 20) * TRACE_PACKET_MILLIS;
+    pressLength[k] = random(80, 201);
+    pressButton[k] = random(0, TINYUI_BUTTON_COUNT);
+  }
+  end = pressStart[TRACE_PRESSES - 1] + TRACE_SPACING_MILLIS;
+  memset(counts, 0, sizeof(counts));
+
+  for (t = 0; t < end; t += TRACE_PACKET_MILLIS)
+  {
+    base = TRACE_BASE - (int32_t) TRACE_DRIFT * t / end + (int32_t) (TRACE_SWING * sin(2 * M_PI * t / end));
+    p.time = t;
+    p.packet[0] = OP_TOUCH;
+    for (h = 0; h < TINYUI_BUTTON_COUNT; h++)
+    {
+      depth = 0;
+      for (k = 0; k < TRACE_PRESSES; k++)
+      {
+        since = (int32_t) (t - pressStart[k]);
+        if ((pressButton[k] != h) || (since < 0) || (since >= pressLength[k] + TRACE_RAMP_MILLIS))
+        {
+          continue;
+        }
+        if (since == 0)
+        {
+          counts[h]++;
+        }
+        if (since < TRACE_RAMP_MILLIS)
+        {
+          depth = (int32_t) TRACE_DEPTH * (since + TRACE_PACKET_MILLIS) / (TRACE_RAMP_MILLIS + TRACE_PACKET_MILLIS);
+        }
+        else if (since < pressLength[k])
+        {
+          depth = TRACE_DEPTH;
+          p.packet[0] |= TINYUI_BUTTON_SELECT >> h;
+        }
+        else
+        {
+          depth = (int32_t) TRACE_DEPTH * (pressLength[k] + TRACE_RAMP_MILLIS - since) / (TRACE_RAMP_MILLIS + TRACE_PACKET_MILLIS);
+        }
+      }
+      reading = base - depth + random(-TRACE_NOISE, TRACE_NOISE + 1);
+      p.packet[1 + h] = counts[h];
+      le16(p.packet + 1 + TINYUI_BUTTON_COUNT + 2 * h, reading);
+    }
+    feed(start, &p);
+  }
+}
+
+static boolean runFile(uint32_t start, const char *path)
+{
+  FILE *f;
+  char line[128], *hex;
+  SessionPacket p;
+  uint8_t i;
+  unsigned int b;
+
+  f = fopen(path, "r");
+  if (!f)
+  {
+    perror(path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f))
+  {
+    if (line[0] != SESSION_KIND_SPI)
+    {
+      continue;
+    }
+    p.time = strtol(line + 1, &hex, 10);
+    if (*hex++ != ',')
+    {
+      continue;
+    }
+    for (i = 0; (i < TINYUI_PACKET_LENGTH) && (sscanf(hex + 2 * i, "%2x", &b) == 1); i++)
+    {
+      p.packet[i] = b;
+    }
+    if (i == TINYUI_PACKET_LENGTH)
+    {
+      feed(start, &p);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const TinyUIStats *stats;
+  uint16_t presses, missed, extra;
+  uint8_t h;
+  uint32_t start;
+
+  hostSetSpiDevice(&attiny);
+  ui.begin();
+  ui.setReplay(true);   // (only the trace's packets count)
+  start = millis();
+  if (argc > 1)
+  {
+    if (!runFile(start, argv[1]))
+    {
+      return 2;
+    }
+  }
+  else
+  {
+    runSynthetic(start);
+  }
+
+  stats = ui.getStats();
+  presses = 0;
+  missed = 0;
+  extra = 0;
+  for (h = 0; h < TINYUI_BUTTON_COUNT; h++)
+  {
+    presses += expected[h];
+    missed += (found[h] < expected[h]) ? expected[h] - found[h] : 0;
+    extra += (found[h] > expected[h]) ? found[h] - expected[h] : 0;
+  }
+  printf("trace,%s,%lu touch packets,%lu ms\n", (argc > 1) ? argv[1] : "synthetic", (unsigned long) packets,
+    (unsigned long) (millis() - start));
+  printf("presses,%u counted,%u found,%u missed,%u extra\n", presses, stats->touchPresses, missed, extra);
+  printf("glitches,%u\n", stats->touchGlitches);
+  printf("recalibrations,%u\n", stats->touchRecalibrations);
+  if (stats->touchPresses)
+  {
+    printf("onset latency,%.1f ms average\n", (double) stats->touchLatencyMillis / stats->touchPresses);
+  }
+  if (lagged)
+  {
+    printf("lag behind count,%.1f ms average,%d min,%d max\n", (double) lagTotal / lagged, lagMin, lagMax);
+  }
+  BENCH_CHECK(packets > 0);
+  BENCH_CHECK(missed == 0);
+  BENCH_CHECK(extra == 0);
+  BENCH_CHECK(stats->touchGlitches == 0);
+  BENCH_CHECK(stats->touchRecalibrations == 0);
+  if (argc <= 1)
+  {
+    BENCH_CHECK(presses == TRACE_PRESSES);
+    BENCH_CHECK(lagged == TRACE_PRESSES);
+    BENCH_CHECK((lagMin >= 0) && (lagMax <= TRACE_MAX_LAG));
+  }
+  return benchResult();
+}
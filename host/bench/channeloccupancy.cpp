@@ -0,0 +1,129 @@
+/*
+  channeloccupancy.cpp - ChannelOccupancy's power sums read back as dBm and as LED levels, against the figures from floating
+  point math.
+  Checks:
+  - a single network at every RSSI from OCC_RSSI_FLOOR to OCC_RSSI_CEILING reads back exactly, and its levels run from 1 to
+    the highest without going down
+  - five networks at -88dBm read as -81dBm (10 log10 5 = 7dB more)
+  - the channels 1 and 2 steps away read within a dB of the spectral mask overlap (0.727 and 0.271), and the rest read nothing;
+    channel 14 is 2 steps from 13
+  - after a network goes, each scan without it reads within a dB of 3/4 of the power before
+  - more networks at the ceiling than 32 bits can sum saturate rather than wrap
+  Released under the MIT License.
+*/
+
+#include <math.h>
+#include "Arduino.h"
+#include "ChannelOccupancy.h"
+#include "bench/Bench.h"
+
+#define MAX_LEVEL             8
+#define CHANNEL               6
+#define OVERLAP_RSSI          -60
+#define FADE_SCANS            8
+
+static ChannelOccupancy occ;
+
+static void scanOne(int8_t rssi, uint8_t channel, uint8_t n)
+{
+  uint8_t i;
+
+  occ.startScan();
+  for (i = 0; i < n; i++)
+  {
+    occ.add(rssi, channel);
+  }
+  occ.finishScan();
+}
+
+static int8_t expectDbm(double dbm)
+{
+  return (int8_t) floor(dbm + 0.5);
+}
+
+int main(void)
+{
+  static const double overlap[OCC_OVERLAP + 1] = { 1.0, 0.727, 0.271 };
+  int8_t rssi, dbm, expected;
+  uint8_t i, d, level, lastLevel, exact;
+  int16_t worst;
+  double power;
+
+  // One network
+  exact = 0;
+  lastLevel = 0;
+  for (rssi = OCC_RSSI_FLOOR; rssi <= OCC_RSSI_CEILING; rssi++)
+  {
+    occ.clear();
+    scanOne(rssi, CHANNEL, 1);
+    dbm = occ.getDbm(CHANNEL - 1);
+    level = occ.getLevel(CHANNEL - 1, MAX_LEVEL);
+    exact += (dbm == rssi);
+    BENCH_CHECK(level >= lastLevel);
+    lastLevel = level;
+    if (rssi == OCC_RSSI_FLOOR)
+    {
+      BENCH_CHECK(level == 1);
+    }
+  }
+  printf("single,%u of %d read back exactly,level %u at %ddBm\n", exact, OCC_RSSI_CEILING - OCC_RSSI_FLOOR + 1, lastLevel,
+    OCC_RSSI_CEILING);
+  BENCH_CHECK(exact == OCC_RSSI_CEILING - OCC_RSSI_FLOOR + 1);
+  BENCH_CHECK(lastLevel == MAX_LEVEL);
+  occ.clear();
+  BENCH_CHECK(occ.getLevel(CHANNEL - 1, MAX_LEVEL) == 0);
+
+  occ.clear();
+  scanOne(-88, CHANNEL, 5);
+  printf("five at -88,%ddBm\n", occ.getDbm(CHANNEL - 1));
+  BENCH_CHECK(occ.getDbm(CHANNEL - 1) == -81);
+
+  // Overlap
+  occ.clear();
+  scanOne(OVERLAP_RSSI, CHANNEL, 1);
+  printf("overlap,%d", OVERLAP_RSSI);
+  for (i = 0; i < OCC_CHANNELS; i++)
+  {
+    printf(",%d", occ.getDbm(i));
+    d = abs(i - (CHANNEL - 1));
+    if (d > OCC_OVERLAP)
+    {
+      BENCH_CHECK(occ.getLevel(i, MAX_LEVEL) == 0);
+      continue;
+    }
+    expected = expectDbm(OVERLAP_RSSI + 10 * log10(overlap[d]));
+    BENCH_CHECK(abs(occ.getDbm(i) - expected) <= 1);
+  }
+  printf("\n");
+  occ.clear();
+  scanOne(OVERLAP_RSSI, 14, 1);
+  printf("channel 14,%d on 13,%d on 12\n", occ.getDbm(12), occ.getDbm(11));
+  BENCH_CHECK(abs(occ.getDbm(12) - expectDbm(OVERLAP_RSSI + 10 * log10(overlap[2]))) <= 1);
+  BENCH_CHECK(occ.getLevel(11, MAX_LEVEL) == 0);
+
+  // Fading out
+  occ.clear();
+  scanOne(OVERLAP_RSSI, CHANNEL, 1);
+  power = 1.0;
+  worst = 0;
+  printf("fade");
+  for (i = 0; i < FADE_SCANS; i++)
+  {
+    scanOne(OVERLAP_RSSI, CHANNEL, 0);
+    power *= 0.75;
+    dbm = occ.getDbm(CHANNEL - 1);
+    printf(",%d", dbm);
+    expected = expectDbm(OVERLAP_RSSI + 10 * log10(power));
+    worst = (abs(dbm - expected) > worst) ? abs(dbm - expected) : worst;
+  }
+  printf("\nfade,worst %d dB off\n", worst);
+  BENCH_CHECK(worst <= 1);
+
+  // Saturation
+  occ.clear();
+  scanOne(OCC_RSSI_CEILING, CHANNEL, 40);
+  printf("saturated,%ddBm\n", occ.getDbm(CHANNEL - 1));
+  BENCH_CHECK(occ.getDbm(CHANNEL - 1) >= OCC_RSSI_CEILING);
+  BENCH_CHECK(occ.getLevel(CHANNEL - 1, MAX_LEVEL) == MAX_LEVEL);
+  return benchResult();
+}
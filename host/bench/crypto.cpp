@@ -0,0 +1,115 @@
+/*
+  crypto.cpp - Streaming encryption, decryption, and hashing against the ATTINY model.
+  Checks:
+  - 100 bytes encrypted in pieces of 5, 1, 30, 7, and 57 bytes decrypt (in other pieces) back to the input
+  - a streamed hash comes out the same however the input is split
+  - once a hash block fails, the later hashUpdate() calls and hashFinal() return false, and a new stream works again
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "TinyUI.h"
+#include "bench/Bench.h"
+
+#define DATA_LENGTH           100
+#define KEY                   3
+#define IV                    1
+
+static AttinyModel attiny;
+static TinyUI ui;
+
+static const uint8_t encryptPieces[] = { 5, 1, 30, 7, 57 };
+static const uint8_t decryptPieces[] = { 64, 3, 33 };
+
+static int crypt(boolean encrypt, const uint8_t *in, uint16_t len, const uint8_t *pieces, uint8_t count, uint8_t *out)
+{
+  TinyUICryptoStream s;
+  uint8_t i;
+  int n, total;
+
+  if (encrypt)
+  {
+    ui.encryptInit(&s, KEY);
+  }
+  else
+  {
+    ui.decryptInit(&s, KEY);
+  }
+  for (i = 0, total = 0; i < count; in += pieces[i++])
+  {
+    n = ui.cryptUpdate(&s, in, pieces[i], out + total);
+    if (n < 0)
+    {
+      return -1;
+    }
+    total += n;
+  }
+  n = ui.cryptFinal(&s, out + total);
+  return (n < 0) ? -1 : total + n;
+}
+
+static boolean hash(const uint8_t *data, uint16_t len, uint8_t piece, uint32_t *out)
+{
+  TinyUICryptoStream s;
+  uint16_t i, n;
+  boolean ok;
+
+  ui.hashInit(&s, IV);
+  for (i = 0, ok = true; i < len; i += n)
+  {
+    n = min(piece, len - i);
+    ok = ui.hashUpdate(&s, data + i, n) && ok;
+  }
+  return ui.hashFinal(&s, out) && ok;
+}
+
+int main(void)
+{
+  uint8_t data[DATA_LENGTH], encrypted[DATA_LENGTH + TINYUI_CRYPTO_BLOCK], decrypted[DATA_LENGTH + TINYUI_CRYPTO_BLOCK];
+  static const uint8_t splits[] = { 1, 3, 8, 13, 50, DATA_LENGTH };
+  TinyUICryptoStream s;
+  uint32_t h, first, out;
+  uint8_t i;
+  int n;
+
+  hostSetSpiDevice(&attiny);
+  ui.begin();
+  for (i = 0; i < DATA_LENGTH; i++)
+  {
+    data[i] = i * 13 + 5;
+  }
+
+  n = crypt(true, data, DATA_LENGTH, encryptPieces, sizeof(encryptPieces), encrypted);
+  printf("encrypted,%d bytes\n", n);
+  BENCH_CHECK(n == DATA_LENGTH);
+  BENCH_CHECK(memcmp(encrypted, data, DATA_LENGTH));
+  n = crypt(false, encrypted, n, decryptPieces, sizeof(decryptPieces), decrypted);
+  printf("decrypted,%d bytes\n", n);
+  BENCH_CHECK(n == DATA_LENGTH);
+  BENCH_CHECK(!memcmp(decrypted, data, DATA_LENGTH));
+
+  for (i = 0; i < sizeof(splits); i++)
+  {
+    BENCH_CHECK(hash(data, DATA_LENGTH, splits[i], &h));
+    printf("hash,pieces of %u,%08lx\n", splits[i], (unsigned long) h);
+    if (!i)
+    {
+      first = h;
+    }
+    BENCH_CHECK(h == first);
+  }
+
+  // The second of the hash blocks fails
+  ui.hashInit(&s, IV);
+  BENCH_CHECK(ui.hashUpdate(&s, data, 8));
+  attiny.failNvm(1);
+  BENCH_CHECK(!ui.hashUpdate(&s, data + 8, 20));
+  BENCH_CHECK(!ui.hashUpdate(&s, data + 28, 20));
+  BENCH_CHECK(!ui.hashFinal(&s, &out));
+  BENCH_CHECK(hash(data, DATA_LENGTH, DATA_LENGTH, &h) && (h == first));
+
+  printf("rate,%u bytes per second\n", ui.getCryptoRate());
+  return benchResult();
+}
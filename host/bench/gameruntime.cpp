@@ -0,0 +1,160 @@
+/*
+  gameruntime.cpp - GameRuntime's fixed steps against run() calls that come at uneven times, with a game that counts its steps
+  and asks for a redraw every fourth one.
+  Checks:
+  - 20 seconds of run() calls 5-35ms apart (and one at the end) run exactly 2000 steps, none skipped, with no more than 4 in
+    one run()
+  - no run() draws more than one frame
+  - buttons queued together reach the game one per step, in order
+  - a 100ms stall is caught up in one run(); after a 500ms stall GAME_MAX_CATCHUP steps run and the rest are skipped
+  - a step that ends the game ends run()
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "Host.h"
+#include "TinyUI.h"
+#include "GameRuntime.h"
+#include "bench/Bench.h"
+
+#define RUN_MILLIS            20000
+#define JITTER_MIN_MILLIS     5
+#define JITTER_MAX_MILLIS     35
+#define REDRAW_TICKS          4
+
+typedef struct {
+  uint32_t ticks;
+  uint32_t endTick;                                   // step that ends the game (0 to run on)
+  uint8_t buttons[4];                                 // first buttons seen...
+  uint32_t buttonTicks[4];                            // ...and the steps they came on
+  uint8_t buttonCount;
+} CountState;
+GAME_STATE_CHECK(CountState);
+
+class CountGame : public Game
+{
+  public:
+    CountState *state;                                // (so the bench can look at it)
+    uint32_t endTick;
+    void start(void *s)
+    {
+      state = (CountState *) s;
+      state->endTick = endTick;
+    }
+    uint8_t tick(void *s, uint8_t btn)
+    {
+      CountState *st = (CountState *) s;
+
+      st->ticks++;
+      if ((btn != TINYUI_BUTTON_NONE) && (st->buttonCount < sizeof(st->buttons)))
+      {
+        st->buttons[st->buttonCount] = btn;
+        st->buttonTicks[st->buttonCount++] = st->ticks;
+      }
+      if (st->endTick && (st->ticks == st->endTick))
+      {
+        return 0;
+      }
+      return GAME_RUNNING | ((st->ticks % REDRAW_TICKS) ? 0 : GAME_REDRAW);
+    }
+    void render(void *s, Adafruit_SSD1306 *display)
+    {
+      display->print(((CountState *) s)->ticks);
+    }
+    void stop(void *s)
+    {
+    }
+};
+
+static Adafruit_SSD1306 display(0, 0, 0);
+static GameRuntime runtime;
+static CountGame game;
+
+// Calls run() at t and returns the number of frames it pushed
+static uint32_t runAt(long t)
+{
+  uint32_t frames;
+
+  while ((long) (millis() - t) < 0)
+  {
+    delay(1);
+  }
+  frames = display.getFrames();
+  runtime.run(t);
+  return display.getFrames() - frames;
+}
+
+int main(void)
+{
+  const GameStats *stats;
+  long start, t;
+  uint32_t runs, frames, ticks;
+
+  display.begin(SSD1306_SWITCHCAPVCC);
+  runtime.setDisplay(&display);
+  stats = runtime.getStats();
+  randomSeed(48);
+
+  // Jittered calls
+  game.endTick = 0;
+  start = millis();
+  runtime.start(&game, start);
+  runs = 0;
+  frames = 0;
+  for (t = start + random(JITTER_MIN_MILLIS, JITTER_MAX_MILLIS + 1); t < start + RUN_MILLIS;
+    t += random(JITTER_MIN_MILLIS, JITTER_MAX_MILLIS + 1))
+  {
+    BENCH_CHECK(runAt(t) <= 1);
+    runs++;
+  }
+  BENCH_CHECK(runAt(start + RUN_MILLIS) <= 1);
+  runs++;
+  printf("jitter,%lu runs,%lu steps,%u skipped,%u most in one run,%lu frames\n", (unsigned long) runs,
+    (unsigned long) stats->ticks, stats->skippedTicks, stats->maxCatchup, (unsigned long) stats->frames);
+  BENCH_CHECK(stats->ticks == RUN_MILLIS / GAME_TICK_MILLIS);
+  BENCH_CHECK(game.state->ticks == stats->ticks);
+  BENCH_CHECK(stats->skippedTicks == 0);
+  BENCH_CHECK(stats->maxCatchup <= (JITTER_MAX_MILLIS + GAME_TICK_MILLIS - 1) / GAME_TICK_MILLIS);
+  BENCH_CHECK(stats->frames <= stats->frameRuns);
+
+  // Buttons queued in one go
+  t = start + RUN_MILLIS;
+  runtime.pushInput(TINYUI_BUTTON_UP);
+  runtime.pushInput(TINYUI_BUTTON_DOWN);
+  runtime.pushInput(TINYUI_BUTTON_SELECT);
+  ticks = stats->ticks;
+  runAt(t + 3 * GAME_TICK_MILLIS);
+  printf("buttons,%u seen,on steps %lu %lu %lu\n", game.state->buttonCount, (unsigned long) game.state->buttonTicks[0],
+    (unsigned long) game.state->buttonTicks[1], (unsigned long) game.state->buttonTicks[2]);
+  BENCH_CHECK(game.state->buttonCount == 3);
+  BENCH_CHECK((game.state->buttons[0] == TINYUI_BUTTON_UP) && (game.state->buttons[1] == TINYUI_BUTTON_DOWN) &&
+    (game.state->buttons[2] == TINYUI_BUTTON_SELECT));
+  BENCH_CHECK((game.state->buttonTicks[0] == ticks + 1) && (game.state->buttonTicks[1] == ticks + 2) &&
+    (game.state->buttonTicks[2] == ticks + 3));
+
+  // Stalls
+  t += 3 * GAME_TICK_MILLIS;
+  ticks = stats->ticks;
+  runAt(t + 100);
+  printf("100ms stall,%lu steps,%u skipped\n", (unsigned long) (stats->ticks - ticks), stats->skippedTicks);
+  BENCH_CHECK(stats->ticks - ticks == 100 / GAME_TICK_MILLIS);
+  BENCH_CHECK(stats->skippedTicks == 0);
+  t += 100;
+  ticks = stats->ticks;
+  runAt(t + 500);
+  printf("500ms stall,%lu steps,%u skipped\n", (unsigned long) (stats->ticks - ticks), stats->skippedTicks);
+  BENCH_CHECK(stats->ticks - ticks == GAME_MAX_CATCHUP);
+  BENCH_CHECK(stats->skippedTicks == 500 / GAME_TICK_MILLIS - GAME_MAX_CATCHUP);
+  runtime.stop();
+
+  // A game that ends itself
+  game.endTick = 5;
+  t = millis();
+  runtime.start(&game, t);
+  BENCH_CHECK(runtime.run(t + 4 * GAME_TICK_MILLIS));
+  BENCH_CHECK(!runtime.run(t + 10 * GAME_TICK_MILLIS));
+  printf("ended,after %lu steps\n", (unsigned long) game.state->ticks);
+  BENCH_CHECK(game.state->ticks == 5);
+  runtime.stop();
+  return benchResult();
+}
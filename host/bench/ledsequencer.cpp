@@ -0,0 +1,127 @@
+/*
+  ledsequencer.cpp - SPI transactions taken by the LED sequencer's animations, and the fade out of an animation cut short,
+  checked against the LED values the ATTINY model received. Runs the sequencer the way the sketch's input task does: once
+  every INPUT_MILLIS, before a background TinyUI update.
+  Checks:
+  - a Simon flash (light, then fade) takes 2 transactions and leaves its LEDs fading to 0
+  - each step of the Simon winner chase takes 1 transaction (one LED lit and the rest fading, together), and the end of each
+    cycle 1 more, so a cycle is TINYUI_LED_COUNT + 1
+  - the chase takes its keyframes' holds (SIMON_WINNER_CYCLES * TINYUI_LED_COUNT * SIMON_WINNER_DT) to within 2 input task
+    periods, rather than adding up the wait for each keyframe's run()
+  - an animation replaced or stopped before its end leaves none of the LEDs it lit on
+  Released under the MIT License.
+*/
+
+#include <stdlib.h>
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "TinyUI.h"
+#include "LedSequencer.h"
+#include "Simon.h"
+#include "bench/Bench.h"
+
+#define INPUT_MILLIS          10   // (as the sketch)
+#define WINNER_MILLIS         ((uint32_t) SIMON_WINNER_CYCLES * TINYUI_LED_COUNT * SIMON_WINNER_DT)
+
+// Simon's animations (Simon.cpp keeps its own to itself)
+#define PIXELS_UP             ((1 << 11) | (1 << 0) | (1 << 1))
+#define PIXELS_DOWN           ((1 << 5) | (1 << 6) | (1 << 7))
+PgmLedAnimation(flash) = {
+  { 0, LEDSEQ_KEY_PIXELS_ARG, 255, 0, TINYUI_TRANS_IMMEDIATE, 0 },
+  { 0, LEDSEQ_KEY_PIXELS_ARG, 0, 0, SIMON_FLASH_FRAMES, 0 }
+};
+#define WINNER_STEP(n) \
+  { LEDSEQ_PIXELS_ALL & ~(1 << (n)), 0, 0, 0, SIMON_WINNER_FRAMES, 0 }, \
+  { 1 << (n), 0, 255, 0, TINYUI_TRANS_IMMEDIATE, SIMON_WINNER_DT }
+PgmLedAnimation(winner) = {
+  WINNER_STEP(0), WINNER_STEP(1), WINNER_STEP(2), WINNER_STEP(3), WINNER_STEP(4), WINNER_STEP(5), WINNER_STEP(6),
+  WINNER_STEP(7), WINNER_STEP(8), WINNER_STEP(9), WINNER_STEP(10), WINNER_STEP(11), WINNER_STEP(12), WINNER_STEP(13),
+  { LEDSEQ_PIXELS_ALL, 0, 0, 0, SIMON_WINNER_FRAMES, 0 }
+};
+
+static AttinyModel attiny;
+static TinyUI ui;
+static LedSequencer leds;
+
+static void runInput(void)
+{
+  ui.poll();
+  leds.run(millis());
+  ui.updateAsync(TINYUI_GET_BUTTONS);
+  delay(INPUT_MILLIS);
+}
+
+// runs until the animation is over; returns the transactions it took
+static uint32_t playOut(void)
+{
+  uint32_t start;
+
+  start = leds.getStats()->transactions;
+  while (leds.isPlaying())
+  {
+    runInput();
+  }
+  runInput();
+  return leds.getStats()->transactions - start;
+}
+
+static uint8_t litPixels(void)
+{
+  uint8_t i, n;
+
+  for (i = 0, n = 0; i < TINYUI_LED_COUNT; i++)
+  {
+    n += attiny.getPixel(i) ? 1 : 0;
+  }
+  return n;
+}
+
+int main(void)
+{
+  uint32_t n, ms, keys;
+
+  hostSetSpiDevice(&attiny);
+  ui.begin();
+  leds.setUi(&ui);
+
+  leds.play(flash, LedAnimationLength(flash), PIXELS_UP);
+  n = playOut();
+  printf("flash,%lu transactions\n", (unsigned long) n);
+  BENCH_CHECK(n == 2);
+  BENCH_CHECK(!litPixels());
+
+  ms = leds.getStats()->millis;
+  keys = leds.getStats()->keyframes;
+  leds.play(winner, LedAnimationLength(winner), 0, SIMON_WINNER_CYCLES);
+  n = playOut();
+  ms = leds.getStats()->millis - ms;
+  printf("winner,%u cycles,%lu keyframes,%lu transactions,%lu ms,%lu per second\n", SIMON_WINNER_CYCLES,
+    (unsigned long) (leds.getStats()->keyframes - keys), (unsigned long) n, (unsigned long) ms, (unsigned long) (n * 1000 / ms));
+  BENCH_CHECK(n == SIMON_WINNER_CYCLES * (TINYUI_LED_COUNT + 1));
+  BENCH_CHECK(labs((long) ms - (long) WINNER_MILLIS) <= 2 * INPUT_MILLIS);
+  BENCH_CHECK(!litPixels());
+
+  // Cut short: a second flash right after the first lit its LEDs, then a stop() halfway through the chase
+  leds.play(flash, LedAnimationLength(flash), PIXELS_UP);
+  runInput();
+  BENCH_CHECK(attiny.getPixel(0) == 255);
+  leds.play(flash, LedAnimationLength(flash), PIXELS_DOWN);
+  playOut();
+  printf("replaced,%u lit\n", litPixels());
+  BENCH_CHECK(!litPixels());
+  leds.play(winner, LedAnimationLength(winner), 0, LEDSEQ_LOOP_FOREVER);
+  for (ms = millis(); millis() - ms < 200; )
+  {
+    runInput();
+  }
+  BENCH_CHECK(litPixels());
+  leds.stop();
+  runInput();
+  runInput();
+  printf("stopped,%u lit\n", litPixels());
+  BENCH_CHECK(!litPixels());
+
+  printf("rate,%u transactions per second of animation\n", leds.getTransactionRate());
+  return benchResult();
+}
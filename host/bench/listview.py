@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+# listview.py - Repaint cost of the scanner's network list per navigation step. Replays a synthetic session (see
+# sessions/session.py) that opens the scanner with NETWORKS networks, scrolls to the bottom and back up a row at a time, and
+# reads the list view's figures with the 'l' serial command. Fails if a step draws more than the screen's rows, or if
+# renderNetwork() walks the list more than once per frame (the linked list is walked from a cursor, not from its head per row).
+# Usage: listview.py path/to/replay
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'sessions'))
+from session import Session, network, SELECT, UP, DOWN, LEFT
+
+LISTVIEW_ROWS = 4
+NETWORKS = 12                # (what fits in MAX_NETWORKS_RAM with the host's 8 byte pointers; the badge fits more)
+SCROLLS = NETWORKS
+
+s = Session()
+s.press(1000, DOWN)
+s.press(1600, DOWN)
+s.press(2200, SELECT)
+s.scan(6100, [network(n, -40 - n) for n in range(NETWORKS)])
+t = 9000
+for button in [DOWN] * SCROLLS + [UP] * SCROLLS:
+    s.press(t, button)
+    t += 300
+s.press(t, LEFT)
+with tempfile.NamedTemporaryFile('w', suffix='.txt', delete=False) as f:
+    s.write(f, t + 1000)
+try:
+    out = subprocess.run([sys.argv[1], '-c', 'l', f.name], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+finally:
+    os.unlink(f.name)
+
+steps, rows, frames, perStep, walked = out.strip().splitlines()[-1].split(',')
+steps, rows, frames, walked = int(steps), int(rows), int(frames), int(walked)
+print('networks %d, steps %d, rows drawn %d (%s per step), frames %d, networks walked %d (%.2f per frame)'
+      % (NETWORKS, steps, rows, perStep, frames, walked, walked / frames))
+ok = (rows <= steps * LISTVIEW_ROWS) and (walked <= frames * NETWORKS)
+print('ok' if ok else 'FAILED')
+sys.exit(0 if ok else 1)
@@ -0,0 +1,122 @@
+/*
+  networkcounter.cpp - NetworkCounter's HyperLogLog estimate of how many different networks were seen, its Bloom filters' count
+  of networks new since the last scan, and its EEPROM checkpoint (in the ATmega32U4's EEPROM, as the sketch keeps it).
+  Networks are made-up BSSIDs and SSIDs, all different; each count is run TRIALS times with different networks.
+  Checks:
+  - the RMS error of the estimate is no more than MAX_RMS_PERCENT at every count from 5 to 10000
+  - seeing the same networks again doesn't change the estimate
+  - in scans of 30 networks, 5 of them new, the new count misses no more than 1 in 20 of the new ones, and never counts more
+    than there are
+  - a checkpoint is written once NETCOUNT_CHECKPOINT_MILLIS has passed, only if something changed, and begin() picks it up
+  Released under the MIT License.
+*/
+
+#include <math.h>
+#include "Arduino.h"
+#include "Host.h"
+#include "NetworkCounter.h"
+#include "bench/Bench.h"
+
+#define TRIALS                50
+#define MAX_RMS_PERCENT       12
+#define SCAN_NETWORKS         30
+#define SCAN_NEW              5
+#define SCANS                 2000
+#define EEPROM_ADDR           0
+
+static const uint16_t counts[] = { 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+// Network n of a trial, the same each time it is asked for
+static void network(uint16_t trial, uint16_t n, uint8_t *mac, char *ssid)
+{
+  uint32_t x;
+
+  x = ((uint32_t) trial << 16 | n) * 2654435761UL;
+  mac[0] = n >> 8;
+  mac[1] = n;
+  mac[2] = trial;
+  mac[3] = x >> 24;
+  mac[4] = x >> 16;
+  mac[5] = x >> 8;
+  sprintf(ssid, "net-%lu", (unsigned long) (x % 100000));
+}
+
+static void addNetworks(NetworkCounter *counter, uint16_t trial, uint16_t from, uint16_t n)
+{
+  uint8_t mac[6];
+  char ssid[24];
+  uint16_t i;
+
+  for (i = from; i < from + n; i++)
+  {
+    network(trial, i, mac, ssid);
+    counter->add(mac, ssid);
+  }
+}
+
+int main(void)
+{
+  NetworkCounter counter(NETCOUNT_NO_EEPROM);
+  uint8_t i;
+  uint16_t trial, scan, estimate, newCount, missed;
+  uint32_t writes;
+  double sum, rms, worst;
+
+  // Estimate error
+  worst = 0;
+  for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+  {
+    sum = 0;
+    for (trial = 0; trial < TRIALS; trial++)
+    {
+      counter.clear();
+      addNetworks(&counter, trial, 0, counts[i]);
+      estimate = counter.getCount();
+      sum += pow(((double) estimate - counts[i]) / counts[i], 2);
+      if (trial == 0)
+      {
+        addNetworks(&counter, trial, 0, counts[i]);
+        BENCH_CHECK(counter.getCount() == estimate);
+      }
+    }
+    rms = sqrt(sum / TRIALS) * 100;
+    worst = (rms > worst) ? rms : worst;
+    printf("networks,%u,rms error %.1f%%\n", counts[i], rms);
+    BENCH_CHECK(rms <= MAX_RMS_PERCENT);
+  }
+  printf("worst,%.1f%%\n", worst);
+
+  // New networks: each scan keeps the last SCAN_NETWORKS - SCAN_NEW networks of the one before it and adds SCAN_NEW
+  counter.clear();
+  missed = 0;
+  for (scan = 0; scan < SCANS; scan++)
+  {
+    counter.startScan();
+    addNetworks(&counter, 0, scan * SCAN_NEW, SCAN_NETWORKS);
+    newCount = counter.getNewCount();
+    if (scan)
+    {
+      BENCH_CHECK(newCount <= SCAN_NEW);
+      missed += SCAN_NEW - newCount;
+    }
+  }
+  printf("new,%u scans of %u,%u of %u new ones missed\n", SCANS, SCAN_NETWORKS, missed, (SCANS - 1) * SCAN_NEW);
+  BENCH_CHECK(missed * 20 <= (SCANS - 1) * SCAN_NEW);
+
+  // Checkpoint
+  NetworkCounter saved(EEPROM_ADDR), restored(EEPROM_ADDR);
+  saved.begin();
+  addNetworks(&saved, 0, 0, 100);
+  saved.run(NETCOUNT_CHECKPOINT_MILLIS - 1);
+  BENCH_CHECK(hostGetEeprom()[EEPROM_ADDR] != NETCOUNT_MAGIC);
+  saved.run(NETCOUNT_CHECKPOINT_MILLIS);
+  writes = hostGetEepromWrites();
+  saved.run(2 * NETCOUNT_CHECKPOINT_MILLIS);
+  restored.begin();
+  printf("checkpoint,%lu bytes written,estimate %u,restored %u\n", (unsigned long) writes, saved.getCount(), restored.getCount());
+  BENCH_CHECK(hostGetEeprom()[EEPROM_ADDR] == NETCOUNT_MAGIC);
+  BENCH_CHECK(writes <= NETCOUNT_EEPROM_SIZE);
+  BENCH_CHECK(hostGetEepromWrites() == writes);
+  BENCH_CHECK(restored.getCount() == saved.getCount());
+  return benchResult();
+}
@@ -0,0 +1,114 @@
+/*
+  nvm.cpp - FLASH and EEPROM transfers against the ATTINY model: reading 256 bytes of FLASH one 12 byte chunk per call (a
+  transaction each, as before readFLASH() took any length) and in one call (every chunk in one transaction), and begin()'s hash
+  of the whole FLASH.
+  Checks:
+  - begin() hashes the model's FLASH to the FNV-1a of what readFLASH() gives, and an image it doesn't know has no features, so
+    TinyUI pads packets and refilters touches as before
+  - the one call takes 1 transaction, the chunked calls one per chunk, and both read the same data
+  - the one call clocks no more bytes than the chunked calls
+  - a 64 byte EEPROM write reads back, and lands in the model's EEPROM
+  - a read past the end of the EEPROM, and a chunk the model fails, make the transfer return false
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "TinyUI.h"
+#include "bench/Bench.h"
+
+#define READ_LENGTH           256
+
+static AttinyModel attiny;
+static TinyUI ui;
+
+typedef struct {
+  uint32_t updates;
+  uint32_t bytes;
+  uint64_t nanos;
+} Mark;
+
+static void mark(Mark *m)
+{
+  m->updates = ui.getStats()->updates;
+  m->bytes = ui.getStats()->bytes;
+  m->nanos = hostNanos();
+}
+
+static void report(const char *name, Mark *m)
+{
+  Mark now;
+
+  mark(&now);
+  m->updates = now.updates - m->updates;
+  m->bytes = now.bytes - m->bytes;
+  m->nanos = now.nanos - m->nanos;
+  printf("%s,%lu transactions,%lu bytes clocked,%lu us,%lu bytes per ms\n", name, (unsigned long) m->updates,
+    (unsigned long) m->bytes, (unsigned long) (m->nanos / 1000), (unsigned long) (READ_LENGTH * 1000000ULL / m->nanos));
+}
+
+int main(void)
+{
+  uint8_t chunked[READ_LENGTH], bulk[READ_LENGTH], data[ATTINY_EEPROM_SIZE], back[ATTINY_EEPROM_SIZE];
+  Mark c, b;
+  uint16_t i, n;
+  uint32_t hash;
+  uint64_t took;
+  boolean ok;
+
+  hostSetSpiDevice(&attiny);
+  took = hostNanos();
+  ui.begin();
+  took = hostNanos() - took;
+  printf("clock,%lu\n", (unsigned long) ui.getSpiClock());
+
+  for (i = 0, ok = true, hash = 2166136261UL; i < TINYUI_FIRMWARE_SIZE; i += READ_LENGTH)
+  {
+    ok = ui.readFLASH(i, READ_LENGTH, bulk) && ok;
+    for (n = 0; n < READ_LENGTH; n++)
+    {
+      hash = (hash ^ bulk[n]) * 16777619UL;
+    }
+  }
+  printf("firmware,hash %08lx,features %u,begin() took %lu ms\n", (unsigned long) ui.getFirmwareHash(),
+    ui.getFirmwareFeatures(), (unsigned long) (took / 1000000));
+  BENCH_CHECK(ok);
+  BENCH_CHECK(ui.getFirmwareHash() == hash);
+  BENCH_CHECK(ui.getFirmwareFeatures() == 0);
+  BENCH_CHECK(ui.isRefilterCapSense());
+
+  mark(&c);
+  for (i = 0, ok = true; i < READ_LENGTH; i += n)
+  {
+    n = min(READ_LENGTH - i, TINYUI_NVM_BUFFER_SIZE);
+    ok = ui.readFLASH(i, n, chunked + i) && ok;
+  }
+  report("chunked", &c);
+  BENCH_CHECK(ok);
+  BENCH_CHECK(c.updates == (READ_LENGTH + TINYUI_NVM_BUFFER_SIZE - 1) / TINYUI_NVM_BUFFER_SIZE);
+
+  mark(&b);
+  ok = ui.readFLASH(0, READ_LENGTH, bulk);
+  report("bulk", &b);
+  BENCH_CHECK(ok);
+  BENCH_CHECK(b.updates == 1);
+  BENCH_CHECK(b.bytes <= c.bytes);
+  BENCH_CHECK(!memcmp(chunked, bulk, READ_LENGTH));
+
+  for (i = 0; i < ATTINY_EEPROM_SIZE; i++)
+  {
+    data[i] = i * 7 + 3;
+  }
+  BENCH_CHECK(ui.writeEEPROM(0, ATTINY_EEPROM_SIZE, data));
+  BENCH_CHECK(ui.readEEPROM(0, ATTINY_EEPROM_SIZE, back));
+  BENCH_CHECK(!memcmp(data, back, ATTINY_EEPROM_SIZE));
+  BENCH_CHECK(!memcmp(data, attiny.getEeprom(), ATTINY_EEPROM_SIZE));
+
+  BENCH_CHECK(!ui.readEEPROM(ATTINY_EEPROM_SIZE - 4, 12, back));
+  attiny.failNvm(1);
+  BENCH_CHECK(!ui.readFLASH(0, READ_LENGTH, bulk));
+  BENCH_CHECK(ui.readFLASH(0, READ_LENGTH, bulk));
+  printf("rate,%u bytes per second\n", ui.getNvmRate());
+  return benchResult();
+}
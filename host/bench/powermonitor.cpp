@@ -0,0 +1,158 @@
+/*
+  powermonitor.cpp - PowerMonitor's runtime estimate and levels over a 10 hour LiPo discharge, with the ATTINY model sending
+  the cell voltage (to the ADC's 5.5mV steps) when the monitor asks for it, as the sketch's input task does.
+  Two discharges from 4200mV to POWER_LIPO_EMPTY_MV are run: a typical LiPo curve (falling fast at first, a long flat stretch
+  around 3.8V, and falling fast again at the end), which is the discharge curve the monitor reads the charge off, and a straight
+  line.
+  Checks:
+  - on USB, and before the first POWER_SLOPE_MILLIS window is over, the runtime is unknown
+  - on the curve, the estimate is within MAX_ERROR_PERCENT of the time left from the first hour to the ninth
+  - on both, LOW and CRITICAL come within LEVEL_WINDOW_MILLIS of the cell crossing POWER_LIPO_LOW_MV and
+    POWER_LIPO_CRITICAL_MV (on the straight line, the ADC's 5.5mV steps are nearly 4 minutes of discharge, and its readings
+    are rounded down, so a level can come early)
+  The straight line's estimates are printed, not checked: no LiPo discharges like that, and read off the curve its charge goes
+  down unevenly.
+  Released under the MIT License.
+*/
+
+#include <stdlib.h>
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "TinyUI.h"
+#include "PowerMonitor.h"
+#include "bench/Bench.h"
+
+#define INPUT_MILLIS          10
+#define DISCHARGE_MINUTES     600
+#define FULL_MV               4200
+#define MAX_ERROR_PERCENT     15
+#define LEVEL_WINDOW_MILLIS   300000L
+#define HOUR_MILLIS           3600000UL
+#define CURVE_POINTS          11
+
+// cell voltage at each tenth of the charge used, from full to empty (as the LiPo curve in PowerMonitor.cpp)
+static const uint16_t lipoCurve[CURVE_POINTS] = { 4200, 4060, 3980, 3920, 3870, 3820, 3790, 3770, 3740, 3680, 3300 };
+
+static AttinyModel attiny;
+static TinyUI ui;
+
+static uint16_t cellVoltage(boolean curve, uint32_t ms)
+{
+  uint32_t used, span;
+  uint8_t i;
+
+  span = (uint32_t) DISCHARGE_MINUTES * 60000;
+  if (ms >= span)
+  {
+    return POWER_LIPO_EMPTY_MV;
+  }
+  if (!curve)
+  {
+    return FULL_MV - (uint32_t) (FULL_MV - POWER_LIPO_EMPTY_MV) * (ms / 1000) / (span / 1000);
+  }
+  used = (uint32_t) (CURVE_POINTS - 1) * (ms / 1000);   // (tenths of the charge, times span / 1000)
+  i = used / (span / 1000);
+  return lipoCurve[i] - (uint32_t) (lipoCurve[i] - lipoCurve[i + 1]) * (used % (span / 1000)) / (span / 1000);
+}
+
+// One discharge, with the input task's update every INPUT_MILLIS; returns the largest estimate error in hours 1 to 9, in percent
+static uint16_t discharge(const char *name, boolean curve)
+{
+  PowerMonitor power;
+  uint32_t start, ms, report, lowAt, criticalAt, lowTrue, criticalTrue;
+  uint16_t runtime, left, mv, worst, error;
+
+  // (the monitor's first sample is whatever TinyUI has, so it has to be this discharge's)
+  attiny.setPower(TINYUI_POWER_USB, 0);
+  attiny.setPower(TINYUI_POWER_LIPO, FULL_MV);
+  ui.update(TINYUI_GET_BUTTONS | TINYUI_GET_POWER);
+  power.setUi(&ui);
+  lowAt = criticalAt = lowTrue = criticalTrue = 0;
+  worst = 0;
+  report = 0;
+  printf("%s,hour,cell mV,filtered mV,minutes left,estimate,error %%\n", name);
+  for (start = millis(); (ms = millis() - start) < (uint32_t) DISCHARGE_MINUTES * 60000; delay(INPUT_MILLIS))
+  {
+    mv = cellVoltage(curve, ms);
+    attiny.setPower(TINYUI_POWER_LIPO, mv);
+    ui.poll();
+    power.run(millis());
+    ui.updateAsync(TINYUI_GET_BUTTONS | power.getFlags(millis()));
+
+    if (!lowTrue && (mv < POWER_LIPO_LOW_MV))
+    {
+      lowTrue = ms;
+    }
+    if (!criticalTrue && (mv < POWER_LIPO_CRITICAL_MV))
+    {
+      criticalTrue = ms;
+    }
+    if (!lowAt && (power.getLevel() >= POWER_LEVEL_LOW))
+    {
+      lowAt = ms;
+    }
+    if (!criticalAt && (power.getLevel() >= POWER_LEVEL_CRITICAL))
+    {
+      criticalAt = ms;
+    }
+    if ((ms > 0) && (ms < POWER_SLOPE_MILLIS))
+    {
+      BENCH_CHECK(power.getRuntime() == POWER_RUNTIME_UNKNOWN);
+    }
+    if (ms >= report)
+    {
+      runtime = power.getRuntime();
+      left = DISCHARGE_MINUTES - ms / 60000;
+      error = (runtime == POWER_RUNTIME_UNKNOWN) ? 0 : abs((int32_t) runtime - left) * 100 / left;
+      printf("%s,%lu,%u,%u,%u,", name, (unsigned long) (report / HOUR_MILLIS), mv, power.getVoltage(TINYUI_POWER_LIPO), left);
+      if (runtime == POWER_RUNTIME_UNKNOWN)
+      {
+        printf("unknown,\n");
+      }
+      else
+      {
+        printf("%u,%u\n", runtime, error);
+      }
+      if ((report >= HOUR_MILLIS) && (report <= 9 * HOUR_MILLIS))
+      {
+        BENCH_CHECK(runtime != POWER_RUNTIME_UNKNOWN);
+        worst = (error > worst) ? error : worst;
+      }
+      report += HOUR_MILLIS;
+    }
+  }
+  printf("%s,low at %lu s (cell at %lu s),critical at %lu s (cell at %lu s)\n", name, (unsigned long) lowAt / 1000,
+    (unsigned long) lowTrue / 1000, (unsigned long) criticalAt / 1000, (unsigned long) criticalTrue / 1000);
+  BENCH_CHECK(lowTrue && lowAt && (labs((long) lowAt - (long) lowTrue) <= LEVEL_WINDOW_MILLIS));
+  BENCH_CHECK(criticalTrue && criticalAt && (labs((long) criticalAt - (long) criticalTrue) <= LEVEL_WINDOW_MILLIS));
+  printf("%s,largest error in hours 1-9,%u%%\n", name, worst);
+  return worst;
+}
+
+int main(void)
+{
+  PowerMonitor usb;
+  uint32_t start;
+
+  hostSetSpiDevice(&attiny);
+  ui.begin();
+
+  // On USB there is nothing to estimate
+  usb.setUi(&ui);
+  attiny.setPower(TINYUI_POWER_USB, 5000);
+  attiny.setPower(TINYUI_POWER_LIPO, FULL_MV);
+  for (start = millis(); millis() - start < 2 * POWER_SLOPE_MILLIS; delay(INPUT_MILLIS))
+  {
+    ui.poll();
+    usb.run(millis());
+    ui.updateAsync(TINYUI_GET_BUTTONS | usb.getFlags(millis()));
+  }
+  printf("usb,source %u,runtime %s\n", usb.getSource(), (usb.getRuntime() == POWER_RUNTIME_UNKNOWN) ? "unknown" : "known");
+  BENCH_CHECK(usb.getSource() == TINYUI_POWER_USB);
+  BENCH_CHECK(usb.getRuntime() == POWER_RUNTIME_UNKNOWN);
+
+  BENCH_CHECK(discharge("curve", true) <= MAX_ERROR_PERCENT);
+  discharge("line", false);
+  return benchResult();
+}
@@ -0,0 +1,122 @@
+/*
+  settingsstore.cpp - EEPROM writes the settings journal costs, against the ATTINY model's EEPROM, with a block of settings
+  the size of the sketch's (16 bytes, so 3 slots of 18 bytes in the 64 byte EEPROM).
+  Checks:
+  - nothing loads from an empty EEPROM
+  - seven changes 200ms apart cost one write, SETTINGS_SAVE_DELAY after the last of them
+  - changing the settings back to what is stored writes nothing
+  - writes go round the slots in turn, so each EEPROM byte is written once per getSlotCount() writes
+  - a corrupted newest record falls back to the one before it, and a different version loads nothing
+  - a write the model fails is tried again later
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "TinyUI.h"
+#include "SettingsStore.h"
+#include "bench/Bench.h"
+
+#define SETTINGS_LENGTH       16
+#define VERSION               2
+#define RECORD_LENGTH         (SETTINGS_LENGTH + SETTINGS_RECORD_OVERHEAD)
+#define INPUT_MILLIS          10   // (settings_store.run() is called from the sketch's input task)
+
+static AttinyModel attiny;
+static TinyUI ui;
+static uint8_t settings[SETTINGS_LENGTH];
+static SettingsStore store(&ui, 0, ATTINY_EEPROM_SIZE, settings, SETTINGS_LENGTH, VERSION);
+static uint8_t loaded[SETTINGS_LENGTH];
+static SettingsStore fresh(&ui, 0, ATTINY_EEPROM_SIZE, loaded, SETTINGS_LENGTH, VERSION);
+static SettingsStore other(&ui, 0, ATTINY_EEPROM_SIZE, loaded, SETTINGS_LENGTH, VERSION + 1);
+
+static void runFor(uint32_t ms)
+{
+  uint32_t start;
+
+  for (start = millis(); millis() - start < ms; delay(INPUT_MILLIS))
+  {
+    store.run(millis());
+  }
+}
+
+int main(void)
+{
+  uint8_t i, n, slots, wear[ATTINY_EEPROM_SIZE], before[ATTINY_EEPROM_SIZE];
+  uint16_t writes;
+
+  hostSetSpiDevice(&attiny);
+  ui.begin();
+  slots = store.getSlotCount();
+  printf("slots,%u of %u bytes\n", slots, RECORD_LENGTH);
+  BENCH_CHECK(slots == ATTINY_EEPROM_SIZE / RECORD_LENGTH);
+  BENCH_CHECK(!store.load());
+
+  // A burst of menu changes
+  for (i = 0; i < 7; i++)
+  {
+    settings[0] = i + 1;
+    store.changed();
+    runFor(200);
+  }
+  runFor(SETTINGS_SAVE_DELAY - 200 - INPUT_MILLIS);
+  BENCH_CHECK(store.getStats()->writes == 0);
+  runFor(2 * INPUT_MILLIS);
+  printf("burst,%u changes,%u writes,%lu bytes written\n", store.getStats()->changes, store.getStats()->writes,
+    (unsigned long) store.getStats()->bytesWritten);
+  BENCH_CHECK(store.getStats()->writes == 1);
+
+  settings[1] = 9;
+  store.changed();
+  settings[1] = 0;
+  store.changed();
+  runFor(SETTINGS_SAVE_DELAY + INPUT_MILLIS);
+  printf("changed back,%u writes,%u skipped\n", store.getStats()->writes, store.getStats()->skipped);
+  BENCH_CHECK(store.getStats()->writes == 1);
+  BENCH_CHECK(store.getStats()->skipped == 1);
+
+  // Wear: a slot's sequence number changes each time the slot is written
+  memset(wear, 0, sizeof(wear));
+  writes = store.getStats()->writes;
+  for (i = 0; i < 4 * slots; i++)
+  {
+    memcpy(before, attiny.getEeprom(), ATTINY_EEPROM_SIZE);
+    settings[2] = i + 1;
+    store.changed();
+    store.flush();
+    for (n = 0; n < slots; n++)
+    {
+      wear[n] += (attiny.getEeprom()[n * RECORD_LENGTH] != before[n * RECORD_LENGTH]) ? 1 : 0;
+    }
+  }
+  writes = store.getStats()->writes - writes;
+  printf("rotation,%u writes,", writes);
+  for (n = 0; n < slots; n++)
+  {
+    printf("%u%s", wear[n], (n + 1 < slots) ? "," : " per slot\n");
+    BENCH_CHECK(wear[n] == 4);
+  }
+  BENCH_CHECK(writes == 4 * slots);
+
+  // A new store (as after a reset) finds the newest record; with that one corrupted, it falls back to the one before
+  BENCH_CHECK(fresh.load() && !memcmp(loaded, settings, SETTINGS_LENGTH));
+  n = (store.getStats()->writes - 1) % slots;
+  attiny.getEeprom()[n * RECORD_LENGTH + 3] ^= 0x40;
+  BENCH_CHECK(fresh.load() && (loaded[2] == 4 * slots - 1));
+  printf("corrupted,loaded the record from change %u of %u\n", loaded[2], 4 * slots);
+  BENCH_CHECK(!other.load());
+
+  // A failed write is tried again SETTINGS_SAVE_DELAY later
+  writes = store.getStats()->writes;
+  settings[3] = 1;
+  store.changed();
+  runFor(SETTINGS_SAVE_DELAY - INPUT_MILLIS);
+  attiny.failNvm(1);
+  runFor(2 * INPUT_MILLIS);
+  BENCH_CHECK(store.getStats()->writes == writes);
+  runFor(SETTINGS_SAVE_DELAY + INPUT_MILLIS);
+  printf("failed write,%u writes after the retry\n", store.getStats()->writes - writes);
+  BENCH_CHECK(store.getStats()->writes == writes + 1);
+  return benchResult();
+}
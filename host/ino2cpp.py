@@ -0,0 +1,18 @@
+#!/usr/bin/env python3
+# ino2cpp.py - Turns the sketch into a C++ file the way the Arduino IDE does: the functions it defines are declared ahead of
+# setup(), so they can be used before they are defined. Usage: ino2cpp.py wifibadge.ino sketch.cpp
+import re
+import sys
+
+src = open(sys.argv[1]).read()
+protos = []
+for m in re.finditer(r'^([A-Za-z_][\w\s\*]*?\b(\w+)\s*\(([^;{)]*)\))\s*\{', src, re.M):
+    if m.group(2) not in ('if', 'for', 'while', 'switch', 'struct'):
+        protos.append(m.group(1) + ';')
+start = re.search(r'^void setup\(\)', src, re.M).start()
+with open(sys.argv[2], 'w') as out:
+    out.write('#include "Arduino.h"\n#line 1 "%s"\n' % sys.argv[1])
+    out.write(src[:start])
+    out.write('\n'.join(protos) + '\n')
+    out.write('#line %d "%s"\n' % (src[:start].count('\n') + 1, sys.argv[1]))
+    out.write(src[start:])
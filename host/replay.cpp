@@ -0,0 +1,166 @@
+/*
+  replay.cpp - Plays a session recorded with the badge's 'r' serial command (see SessionLog.h) through the sketch on the host,
+  with the ATTINY model on the SPI bus and the virtual clock (see arduino/Host.h), and writes what the badge sends over the USB
+  serial port to stdout. The same session gives the same output every time, so two builds can be compared by diffing it.
+  Usage: replay [-s] [-f] [-c commands] [-l seconds] session.txt
+    -s  after the replay, write the screen and the number of frames drawn
+    -f  write the screen (and the millis() time) every time a frame is drawn
+    -c  after the replay, send these serial commands (as 'l' for the list view's figures)
+    -l  give up this long (on the virtual clock) after the replay started if its E line hasn't been reached (default 600)
+  Released under the MIT License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "Host.h"
+#include "AttinyModel.h"
+#include "SessionLog.h"
+#include "Adafruit_SSD1306.h"
+
+#define REPLAY_LIMIT_SECONDS    600
+#define REPLAY_USB_MV           5000   // (so the power monitor leaves things alone until the session's own ADC data comes in)
+
+// from the sketch
+void setup(void);
+void loop(void);
+extern SessionLog session;
+extern Adafruit_SSD1306 display;
+
+static const char espReady[] = "\r\nOK\r\n";   // the ESP module's answer to esp.begin()
+
+static void printScreen(void)
+{
+  uint8_t row;
+
+  for (row = 0; row < SSD1306_ROWS; row++)
+  {
+    printf("%c|%s|\n", display.isInverted(row) ? '>' : ' ', display.getScreen(row));
+  }
+}
+
+static char *readFile(const char *path, size_t *len)
+{
+  FILE *f;
+  char *buf;
+  long n;
+
+  f = fopen(path, "rb");
+  if (!f)
+  {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = (char *) malloc(n + 1);   // (with room for the 'R' that starts the replay)
+  buf[0] = 'R';
+  *len = fread(buf + 1, 1, n, f) + 1;
+  fclose(f);
+  return buf;
+}
+
+int main(int argc, char **argv)
+{
+  AttinyModel attiny;
+  char *input;
+  const char *commands;
+  size_t len;
+  boolean screen, frames, started;
+  uint32_t limit, frame;
+  int opt;
+
+  screen = false;
+  frames = false;
+  commands = NULL;
+  limit = REPLAY_LIMIT_SECONDS;
+  while ((opt = getopt(argc, argv, "sfc:l:")) != -1)
+  {
+    if (opt == 's')
+    {
+      screen = true;
+    }
+    else if (opt == 'f')
+    {
+      frames = true;
+    }
+    else if (opt == 'c')
+    {
+      commands = optarg;
+    }
+    else if (opt == 'l')
+    {
+      limit = atol(optarg);
+    }
+    else
+    {
+      return 2;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    fprintf(stderr, "usage: replay [-s] [-f] [-c commands] [-l seconds] session.txt\n");
+    return 2;
+  }
+  input = readFile(argv[optind], &len);
+  if (!input)
+  {
+    perror(argv[optind]);
+    return 2;
+  }
+
+  attiny.setPower(TINYUI_POWER_USB, REPLAY_USB_MV);
+  hostSetSpiDevice(&attiny);
+  hostSetSerialInput(&Serial1, espReady, sizeof(espReady) - 1);
+  hostSetSerialOutput(&Serial, stdout);
+  setup();
+
+  // The replay starts once the serial task reads the 'R', and the session follows it
+  hostSetSerialInput(&Serial, input, len);
+  started = false;
+  frame = display.getFrames();
+  limit = millis() + limit * 1000;
+  while ((long) (millis() - limit) < 0)
+  {
+    loop();
+    if (frames && (display.getFrames() != frame))
+    {
+      frame = display.getFrames();
+      printf("frame,%lu\n", millis());
+      printScreen();
+    }
+    if (session.getMode() == SESSION_REPLAY)
+    {
+      started = true;
+    }
+    else if (started)
+    {
+      break;
+    }
+  }
+  if (!started || (session.getMode() == SESSION_REPLAY))
+  {
+    fprintf(stderr, "%s: the replay didn't finish\n", argv[optind]);
+    return 1;
+  }
+
+  // (the serial task takes a command each time it runs)
+  if (commands)
+  {
+    hostSetSerialInput(&Serial, commands, strlen(commands));
+    while (Serial.available())
+    {
+      loop();
+    }
+  }
+
+  if (screen)
+  {
+    printScreen();
+    printf("frames,%lu\n", (unsigned long) display.getFrames());
+  }
+  fflush(stdout);
+  free(input);
+  return 0;
+}
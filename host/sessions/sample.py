@@ -0,0 +1,25 @@
+#!/usr/bin/env python3
+# sample.py - Writes a synthetic session (see session.py) for replaying on the host when there is no recording from a real
+# badge to hand. It opens the scanner, waits for two scans, scrolls down and back up, and goes back to the menu.
+import sys
+from session import Session, SELECT, UP, DOWN, LEFT
+
+NETWORKS = [
+    (3, 'HomeNet', -48, '3c:84:6a:11:22:33', 1),
+    (4, 'Cafe Guest', -67, 'a0:63:91:44:55:66', 6),
+    (0, 'xfinitywifi', -75, 'f8:8b:37:77:88:99', 6),
+    (3, 'DEFCON', -81, '00:1d:7e:aa:bb:cc', 11),
+    (2, 'printer-5f2a', -88, '84:25:19:dd:ee:ff', 11),
+]
+
+s = Session()
+s.press(1000, DOWN)          # (the cursor starts on the title)
+s.press(1600, DOWN)
+s.press(2200, SELECT)        # into the scanner
+s.scan(6100, NETWORKS)       # (it asks for a scan every 5 seconds)
+s.scan(11100, NETWORKS)
+s.press(12000, DOWN)
+s.press(12600, DOWN)
+s.press(13200, UP)
+s.press(14000, LEFT)         # back to the menu
+s.write(sys.stdout, 15000)
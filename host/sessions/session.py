@@ -0,0 +1,69 @@
+# session.py - Builds synthetic sessions in the format the badge's 'r' serial command records (see SessionLog.h). They are
+# made up, not recorded: touch readings sit at a baseline with a little noise and drop while a button is held, the supply is
+# steady on USB, and the ESP module answers scans with a given list of networks.
+import random
+
+INPUT_MILLIS = 10            # touch packets come in this often (the badge's INPUT_MILLIS)
+POWER_MILLIS = 1000          # ...and ADC data packets this often
+IDLE = 1000                  # touch reading of an untouched button...
+TOUCHED = 700                # ...and of a held one
+NOISE = 3
+USB_MV = 5000
+
+# buttons, in touch packet order
+SELECT, UP, RIGHT, DOWN, LEFT = range(5)
+
+
+class Session:
+    def __init__(self, seed=47):
+        self.rng = random.Random(seed)
+        self.presses = []    # (start, length, button)
+        self.scans = []      # (time, networks)
+        self.readings = {}   # time -> five readings, in place of the made-up ones
+
+    def press(self, t, button, length=120):
+        self.presses.append((t, length, button))
+
+    def scan(self, t, networks):
+        """The ESP module's answer to a scan, at t; networks are (security, ssid, rssi, mac, channel)."""
+        self.scans.append((t, networks))
+
+    def lines(self, end):
+        out = []
+        for t in range(0, end, INPUT_MILLIS):
+            if t % POWER_MILLIS == 0:
+                adc = [USB_MV * 2 // 11, 0, 0, 0, 0]   # (millivolts / 5.5)
+                out.append((t, 0, line('S', t, [0xcc] + le16(adc))))
+            readings = self.readings.get(t)
+            if readings is None:
+                readings = [(TOUCHED if self._held(t, h) else IDLE) + self.rng.randint(-NOISE, NOISE) for h in range(5)]
+            counts = [sum(1 for s, n, b in self.presses if (b == h) and (s <= t)) & 0xff for h in range(5)]
+            mask = sum(0x10 >> h for h in range(5) if self._held(t, h))
+            out.append((t, 1, line('S', t, [0x80 | mask] + counts + le16(readings))))
+        for t, networks in self.scans:
+            text = ''.join('+CWLAP:(%d,"%s",%d,"%s",%d,-23,0)\r\n' % n for n in networks) + '\r\nOK\r\n'
+            data = text.encode()
+            for i in range(0, len(data), 16):   # (the badge writes at most 16 bytes to a U line)
+                out.append((t, 2, line('U', t, data[i:i + 16])))
+        out.sort(key=lambda r: (r[0], r[1]))
+        return [r[2] for r in out] + ['E%d,' % end]
+
+    def write(self, f, end):
+        for l in self.lines(end):
+            f.write(l + '\n')
+
+    def _held(self, t, h):
+        return any((s <= t < s + n) and (b == h) for s, n, b in self.presses)
+
+
+def le16(values):
+    return [b for v in values for b in (v & 0xff, (v >> 8) & 0xff)]
+
+
+def line(kind, t, data):
+    return '%s%d,%s' % (kind, t, ''.join('%02x' % b for b in data))
+
+
+def network(n, rssi=-60, channel=1):
+    """A made-up network, numbered n."""
+    return (3, 'net%02d' % n, rssi, '02:00:00:00:%02x:%02x' % (n >> 8, n & 0xff), channel)
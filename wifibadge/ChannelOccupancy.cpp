@@ -0,0 +1,135 @@
+/*
+  ChannelOccupancy.cpp - Library for estimating how busy each WiFi channel is from the signal strength of the networks on it and around it.
+  Released under the MIT License.
+*/
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "ChannelOccupancy.h"
+
+// Channel centers in 5 MHz steps from channel 1; channel 14 sits 12 MHz above channel 13, which is taken as two steps
+#define OCC_POSITION(I)   (((I) < 13) ? (I) : 14)
+
+// Power of a network with its RSSI 0, 1, and 2 dB above a multiple of 3 dB over OCC_RSSI_FLOOR (256 * 2^(dB / 3)), as seen on its
+// own channel and on the channels 1 and 2 steps away; those are scaled by the overlap of 802.11's spectral mask (0.727 and 0.271)
+const uint16_t OccPower[OCC_OVERLAP + 1][3] PROGMEM = {
+  { 256, 323, 406 },
+  { 186, 235, 295 },
+  { 69, 88, 110 }
+};
+
+// dB over a power of 2 for the next 3 bits of power after the top one (16 * 3 * log2(1 + n / 8))
+const uint8_t OccLog[8] PROGMEM = {
+  0, 8, 15, 22, 28, 34, 39, 44
+};
+
+ChannelOccupancy::ChannelOccupancy(void)
+{
+  clear();
+}
+
+void ChannelOccupancy::clear(void)
+{
+  memset(_scan, 0, sizeof(_scan));
+  memset(_smooth, 0, sizeof(_smooth));
+  _primed = false;
+}
+
+void ChannelOccupancy::startScan(void)
+{
+  memset(_scan, 0, sizeof(_scan));
+}
+
+void ChannelOccupancy::add(int8_t rssi, uint8_t channel)
+{
+  uint8_t i, c, d, db;
+  uint32_t p, sum;
+
+  if (!channel || (channel > OCC_CHANNELS))
+  {
+    return;
+  }
+  c = OCC_POSITION(channel - 1);
+  if (rssi < OCC_RSSI_FLOOR)
+  {
+    rssi = OCC_RSSI_FLOOR;
+  }
+  else if (rssi > OCC_RSSI_CEILING)
+  {
+    rssi = OCC_RSSI_CEILING;
+  }
+  db = rssi - OCC_RSSI_FLOOR;
+  for (i = 0; i < OCC_CHANNELS; i++)
+  {
+    d = OCC_POSITION(i);
+    d = (d > c) ? d - c : c - d;
+    if (d > OCC_OVERLAP)
+    {
+      continue;
+    }
+    p = (uint32_t) pgm_read_word(&OccPower[d][db % 3]) << (db / 3);
+    sum = _scan[i] + p;
+    _scan[i] = (sum < p) ? 0xffffffffUL : sum;   // (saturates rather than wrapping)
+  }
+}
+
+void ChannelOccupancy::finishScan(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < OCC_CHANNELS; i++)
+  {
+    if (!_primed)
+    {
+      _smooth[i] = _scan[i];
+    }
+    else if (_scan[i] >= _smooth[i])
+    {
+      _smooth[i] += (_scan[i] - _smooth[i]) >> OCC_EWMA_SH;
+    }
+    else
+    {
+      _smooth[i] -= (_smooth[i] - _scan[i]) >> OCC_EWMA_SH;
+    }
+  }
+  _primed = true;
+}
+
+int16_t ChannelOccupancy::_db(uint8_t i)
+{
+  uint32_t p;
+  uint8_t b;
+
+  p = _smooth[i];
+  if (p < 256)
+  {
+    return -1;
+  }
+  for (b = 31; !(p & (1UL << b)); b--)
+  {
+  }
+  return (b - 8) * 48 + pgm_read_byte(&OccLog[(p >> (b - 3)) & 7]);
+}
+
+uint8_t ChannelOccupancy::getLevel(uint8_t i, uint8_t maxLevel)
+{
+  int16_t db;
+  uint32_t level;
+
+  db = _db(i);
+  if ((db < 0) || !maxLevel)
+  {
+    return 0;
+  }
+  // (from whole dB, rounded as getDbm() does, so a network at OCC_RSSI_CEILING reaches maxLevel despite the log table rounding down)
+  level = 1 + (uint32_t) ((db + 8) >> 4) * (maxLevel - 1) / OCC_RANGE_DB;
+  return (level < maxLevel) ? level : maxLevel;
+}
+
+int8_t ChannelOccupancy::getDbm(uint8_t i)
+{
+  int16_t db;
+
+  db = _db(i);
+  return (db < 0) ? OCC_RSSI_FLOOR : OCC_RSSI_FLOOR + ((db + 8) >> 4);
+}
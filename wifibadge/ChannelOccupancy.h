@@ -0,0 +1,44 @@
+/*
+  ChannelOccupancy.h - Library for estimating how busy each WiFi channel is from the signal strength of the networks on it and around it.
+  Released under the MIT License.
+*/
+
+#ifndef ChannelOccupancy_h
+#define ChannelOccupancy_h
+
+#include "Arduino.h"
+
+#define OCC_CHANNELS              14
+
+// Each network adds its signal power (not its RSSI in dB, so one strong network outweighs several faint ones) to its own channel
+// and, scaled down, to the two channels either side that its signal overlaps. Power is kept in fixed point with 256 being a network
+// at OCC_RSSI_FLOOR, and doubles every 3 dB (10 log10 2 = 3.01).
+#define OCC_RSSI_FLOOR            -95                 // weaker networks count as this strong
+#define OCC_RSSI_CEILING          -30                 // stronger networks count as this strong (so the sums fit in 32 bits)
+#define OCC_OVERLAP               2                   // channels either side a network's signal reaches
+
+// Smoothing across scans: each scan moves a channel's occupancy 1/4 of the way (so a network coming or going fades in or out over
+// several scans instead of flickering the LED)
+#define OCC_EWMA_SH               2
+
+// getLevel() spreads this many dB above OCC_RSSI_FLOOR over its levels
+#define OCC_RANGE_DB              (OCC_RSSI_CEILING - OCC_RSSI_FLOOR)
+
+class ChannelOccupancy
+{
+  public:
+    ChannelOccupancy(void);
+    void startScan(void);                                   // a scan is starting
+    void add(int8_t rssi, uint8_t channel);                 // count a network from the scan in progress (channel 1 to OCC_CHANNELS)
+    void finishScan(void);                                  // the scan is over: fold it into the smoothed occupancy
+    uint8_t getLevel(uint8_t i, uint8_t maxLevel);          // smoothed occupancy of channel i + 1, from 0 (nothing above OCC_RSSI_FLOOR) to maxLevel
+    int8_t getDbm(uint8_t i);                               // smoothed occupancy of channel i + 1 as the RSSI of a single network with the same power
+    void clear(void);                                       // forget the smoothed occupancy (e.g. when the scanner is left)
+  private:
+    uint32_t _scan[OCC_CHANNELS];                           // power summed over the scan in progress
+    uint32_t _smooth[OCC_CHANNELS];                         // smoothed power
+    boolean _primed;                                        // true once a scan has been folded in since clear()
+    int16_t _db(uint8_t i);                                 // smoothed power in dB above OCC_RSSI_FLOOR, times 16, or -1 if below it
+};
+
+#endif
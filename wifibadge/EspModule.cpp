@@ -21,6 +21,8 @@ const PROGMEM char EndOfData[] = "\r\nOK\r\n";
 
 EspModule::EspModule(void)
 {
+  _in = &Serial1;
+  _tap = NULL;
   _okState = 0;
   _parseState = 0;
   _curResponse = RESPONSE_NONE;
@@ -107,15 +109,32 @@ int16_t EspModule::_endNumber(void)
   return _parseNeg ? -_parseNum : _parseNum;
 }
 
+boolean EspModule::available(void)
+{
+  return _in->available() > 0;
+}
+
+void EspModule::setInput(Stream *in)
+{
+  _in = in;
+}
+
+void EspModule::setTap(Print *tap)
+{
+  _tap = tap;
+}
+
 boolean EspModule::handleData(void)
 {
   char ch;
   boolean finishElement = false;
   uint8_t i;
   // Parse received bytes until \r\nOK\r\n
-  while (Serial1.available()) {
-    ch = Serial1.read();
-    //Serial.write(ch);
+  while (_in->available()) {
+    ch = _in->read();
+    if (_tap) {
+      _tap->write(ch);
+    }
     if (_curResponse == RESPONSE_LIST) {
       switch (_parseState) {
       case 1:   // parsing security and looking for comma
@@ -35,8 +35,13 @@ class EspModule
     void begin(void);
     void startListNetworks(void *obj, void *(*callback)(void *, uint8_t, const char *, int8_t, const uint8_t *, uint8_t), char *ssidBuffer, uint8_t ssidLen);
     boolean handleData(void);
+    boolean available(void);   // true if the module has sent data that handleData() hasn't read yet
+    void setInput(Stream *in);   // read the module's responses from in instead of Serial1 (e.g. to replay a recorded session); Serial1 still carries the commands
+    void setTap(Print *tap);   // copy every byte read from the module to tap as well (NULL to stop)
     void flushData(void);
   private:
+    Stream *_in;   // where responses are read from
+    Print *_tap;   // see setTap()
     uint8_t _okState;   // looking for \r\nOK\r\n to indicate end of response data
     uint8_t _parseState;   // parsing return data
     void _resetResponse(uint8_t typ);   // start parsing a new response
@@ -0,0 +1,145 @@
+/*
+  GameRuntime.cpp - Library for running games in fixed time steps, with their state in a static pool and one screen update per frame.
+  Released under the MIT License.
+*/
+
+#include <Adafruit_SSD1306.h>
+#include "Arduino.h"
+#include "TinyUI.h"
+#include "Profiler.h"
+#include "GameRuntime.h"
+
+GameRuntime::GameRuntime(void)
+{
+  _game = NULL;
+  _display = NULL;
+  _over = false;
+  _redraw = false;
+  _tickTime = 0;
+  _inputHead = 0;
+  _inputCount = 0;
+  resetStats();
+}
+
+void GameRuntime::setDisplay(Adafruit_SSD1306 *display)
+{
+  _display = display;
+}
+
+void GameRuntime::start(Game *game, long t)
+{
+  stop();
+  memset(_state, 0, sizeof(_state));
+  _game = game;
+  _over = false;
+  _redraw = true;
+  _tickTime = t + GAME_TICK_MILLIS;
+  _inputHead = 0;
+  _inputCount = 0;
+  _game->start(_state);
+}
+
+void GameRuntime::stop(void)
+{
+  if (_game)
+  {
+    _game->stop(_state);
+    _game = NULL;
+  }
+}
+
+void GameRuntime::pushInput(uint8_t btn)
+{
+  if (_inputCount < GAME_INPUT_QUEUE)
+  {
+    _input[(_inputHead + _inputCount++) % GAME_INPUT_QUEUE] = btn;
+  }
+  else if (_stats.inputDrops < 0xff)
+  {
+    _stats.inputDrops++;
+  }
+}
+
+boolean GameRuntime::run(long t)
+{
+  uint32_t start;
+  uint16_t elapsed;
+  uint8_t n, btn, result;
+
+  if (!_game || _over)
+  {
+    return false;
+  }
+  start = micros();
+
+  // Steps run on their own clock, GAME_TICK_MILLIS apart, so the game's timing doesn't depend on how often run() gets called; a
+  // late run() runs the missed steps back to back (each with its own button, so presses are still handled in order)
+  for (n = 0; !_over && (t - _tickTime >= 0); n++)
+  {
+    if (n >= GAME_MAX_CATCHUP)
+    {
+      elapsed = (t - _tickTime) / GAME_TICK_MILLIS + 1;
+      _stats.skippedTicks += elapsed;
+      _tickTime += (long)elapsed * GAME_TICK_MILLIS;
+      break;
+    }
+    btn = TINYUI_BUTTON_NONE;
+    if (_inputCount)
+    {
+      btn = _input[_inputHead];
+      _inputHead = (_inputHead + 1) % GAME_INPUT_QUEUE;
+      _inputCount--;
+    }
+    result = _game->tick(_state, btn);
+    _tickTime += GAME_TICK_MILLIS;
+    _stats.ticks++;
+    if (result & GAME_REDRAW)
+    {
+      _redraw = true;
+    }
+    if (!(result & GAME_RUNNING))
+    {
+      _over = true;
+    }
+  }
+  if (!n)
+  {
+    return !_over;
+  }
+
+  // However many steps ran, the screen is drawn and pushed once
+  if (_redraw && !_over)
+  {
+    _display->clearDisplay();
+    _game->render(_state, _display);
+    PROFILE_START(PROF_DISPLAY);
+    _display->display();
+    PROFILE_STOP(PROF_DISPLAY);
+    _redraw = false;
+    _stats.frames++;
+  }
+
+  if (n > _stats.maxCatchup)
+  {
+    _stats.maxCatchup = n;
+  }
+  elapsed = micros() - start;
+  _stats.lastFrameMicros = elapsed;
+  if (elapsed > _stats.maxFrameMicros)
+  {
+    _stats.maxFrameMicros = elapsed;
+  }
+  _stats.totalFrameMicros += elapsed;
+  _stats.frameRuns++;
+  return !_over;
+}
+
+const GameStats *GameRuntime::getStats(void)
+{
+  return &_stats;
+}
+
+void GameRuntime::resetStats(void)
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,75 @@
+/*
+  GameRuntime.h - Library for running games in fixed time steps, with their state in a static pool and one screen update per frame.
+  Released under the MIT License.
+*/
+
+#ifndef GameRuntime_h
+#define GameRuntime_h
+
+#include <Adafruit_SSD1306.h>
+#include "Arduino.h"
+
+#define GAME_STATE_BYTES          32                  // size of the pool a game keeps all of its state in (make it bigger if a new game needs more)
+#define GAME_TICK_MILLIS          10                  // games advance in steps of this long, however often run() is called
+#define GAME_MAX_CATCHUP          16                  // most steps run by one run() to catch up after a delay; the rest are skipped (and the game falls behind)
+#define GAME_INPUT_QUEUE          8                   // buttons waiting to be passed to the game, one per step
+
+// converts a time in milliseconds to a number of steps, for game timing
+#define GAME_MILLIS_TO_TICKS(MS)  (((MS) + GAME_TICK_MILLIS / 2) / GAME_TICK_MILLIS)
+
+// put this after a game's state struct to check at compile time that it fits in the pool
+#define GAME_STATE_CHECK(TYPE)    static_assert(sizeof(TYPE) <= GAME_STATE_BYTES, #TYPE " does not fit in GAME_STATE_BYTES")
+
+// Game::tick() result flags
+#define GAME_RUNNING              0x01                // the game is not over yet
+#define GAME_REDRAW               0x02                // the screen needs to be drawn again
+
+// frame timing
+typedef struct {
+  uint32_t ticks;                                     // steps run
+  uint16_t skippedTicks;                              // steps skipped because run() was called too late to catch up
+  uint8_t maxCatchup;                                 // most steps run by one run()
+  uint8_t inputDrops;                                 // buttons lost because the input queue was full
+  uint32_t frames;                                    // frames pushed to the screen
+  uint16_t lastFrameMicros;                           // time for the last run() that ran any steps, including drawing and pushing its frame
+  uint16_t maxFrameMicros;
+  uint32_t totalFrameMicros;                          // (divide by the number of run()s that ran steps, frameRuns, for the average)
+  uint32_t frameRuns;
+} GameStats;
+
+// A game; its state lives in the GameRuntime's pool, which is passed to each call
+class Game
+{
+  public:
+    virtual void start(void *state) = 0;                    // set up a new game (the state starts out as zeros)
+    virtual uint8_t tick(void *state, uint8_t btn) = 0;     // advance one GAME_TICK_MILLIS step, with the next queued button or TINYUI_BUTTON_NONE; returns GAME_... flags
+    virtual void render(void *state, Adafruit_SSD1306 *display) = 0;   // draw into the display buffer (already cleared); the runtime pushes it to the screen
+    virtual void stop(void *state) = 0;                     // the game is being left, over or not
+};
+
+class GameRuntime
+{
+  public:
+    GameRuntime(void);
+    void setDisplay(Adafruit_SSD1306 *display);
+    void start(Game *game, long t);                         // start a new game; the first step is due GAME_TICK_MILLIS after t
+    void stop(void);                                        // leave the game
+    void pushInput(uint8_t btn);                            // queue a button press for the game
+    boolean run(long t);                                    // run the steps that are due, then draw and push one frame if any asked for it (SPI must be
+                                                            //   free, as after TinyUI::poll()); returns false once the game is over or if none is running
+    const GameStats *getStats(void);
+    void resetStats(void);
+  private:
+    Game *_game;
+    Adafruit_SSD1306 *_display;
+    boolean _over;                                          // true once a step has returned without GAME_RUNNING
+    boolean _redraw;                                        // true if a frame needs to be drawn
+    long _tickTime;                                         // millis() time the next step is due
+    uint8_t _input[GAME_INPUT_QUEUE];                       // ring buffer of queued buttons
+    uint8_t _inputHead;
+    uint8_t _inputCount;
+    GameStats _stats;
+    uint8_t _state[GAME_STATE_BYTES];                       // the running game's state
+};
+
+#endif
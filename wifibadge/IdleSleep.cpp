@@ -0,0 +1,96 @@
+/*
+  IdleSleep.cpp - Library for putting the ATmega32U4 into idle sleep when there is no work, and measuring how much it sleeps.
+  Released under the MIT License.
+*/
+
+#include <avr/sleep.h>
+#include "Arduino.h"
+#include "IdleSleep.h"
+
+IdleSleep::IdleSleep(void)
+{
+  _lastActivity = 0;
+  _mode = IDLE_MODE_FAST;
+  _lastMicros = 0;
+  memset(_stats, 0, sizeof(_stats));
+}
+
+void IdleSleep::_account(uint32_t now, uint32_t slept)
+{
+  IdleModeStats *s;
+
+  s = _stats + _mode;
+  s->micros += now - _lastMicros;
+  s->sleepMicros += slept;
+  _lastMicros = now;
+  if (s->micros & 0x80000000)
+  {
+    s->micros >>= 1;
+    s->sleepMicros >>= 1;
+  }
+}
+
+void IdleSleep::activity(long t)
+{
+  _lastActivity = t;
+  getMode(t);
+}
+
+uint8_t IdleSleep::getMode(long t)
+{
+  uint8_t mode;
+
+  mode = (t - _lastActivity < IDLE_FAST_MILLIS) ? IDLE_MODE_FAST : IDLE_MODE_SLOW;
+  if (mode != _mode)
+  {
+    _account(micros(), 0);
+    _mode = mode;
+  }
+  return mode;
+}
+
+void IdleSleep::sleep(void)
+{
+  uint32_t start, now;
+
+  // Idle sleep stops the CPU but leaves the timers, USART, SPI, and USB running, so any of their interrupts wakes it up again
+  // (an interrupt that comes in just before sleep_cpu() leaves it asleep until the next one, which is at most a millis() tick away)
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  start = micros();
+  sleep_enable();
+  sleep_cpu();
+  sleep_disable();
+  _account(start, 0);   // awake until start
+  now = micros();
+  _account(now, now - start);
+  _stats[_mode].wakeups++;
+}
+
+uint8_t IdleSleep::getDutyCycle(uint8_t mode)
+{
+  IdleModeStats *s;
+
+  if (mode >= IDLE_MODES)
+  {
+    return 0;
+  }
+  if (mode == _mode)
+  {
+    _account(micros(), 0);
+  }
+  s = _stats + mode;
+  return s->micros ? 100 - (uint8_t) ((s->sleepMicros >> 8) * 100 / ((s->micros >> 8) | 1)) : 100;
+}
+
+uint16_t IdleSleep::getCurrent(uint8_t mode)
+{
+  uint8_t duty;
+
+  duty = getDutyCycle(mode);
+  return ((uint32_t) IDLE_AWAKE_MICROAMPS * duty + (uint32_t) IDLE_ASLEEP_MICROAMPS * (100 - duty)) / 100;
+}
+
+const IdleModeStats *IdleSleep::getStats(uint8_t mode)
+{
+  return (mode < IDLE_MODES) ? _stats + mode : NULL;
+}
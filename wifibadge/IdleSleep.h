@@ -0,0 +1,48 @@
+/*
+  IdleSleep.h - Library for putting the ATmega32U4 into idle sleep when there is no work, and measuring how much it sleeps.
+  Released under the MIT License.
+*/
+
+#ifndef IdleSleep_h
+#define IdleSleep_h
+
+#include "Arduino.h"
+
+// modes
+#define IDLE_MODE_FAST            0                   // something is going on (a button was just pressed, a game or animation is running), so buttons are polled often
+#define IDLE_MODE_SLOW            1                   // nothing has happened for IDLE_FAST_MILLIS, so buttons are polled less often
+#define IDLE_MODES                2
+
+#define IDLE_FAST_MILLIS          3000                // stay in IDLE_MODE_FAST this long after the last activity()
+
+// Rough ATmega32U4 supply current awake and in idle sleep at 16MHz (from the datasheet's typical figures; the LEDs, screen, ESP
+// module, and ATTINY are not included), for estimating the average current; measure a board and adjust these for better estimates
+#define IDLE_AWAKE_MICROAMPS      10000
+#define IDLE_ASLEEP_MICROAMPS     4000
+
+// time awake and asleep in one mode
+typedef struct {
+  uint32_t micros;                                    // time spent in the mode (this and sleepMicros are halved together when they get large, so their ratio is what counts)
+  uint32_t sleepMicros;                               // time spent asleep in the mode
+  uint32_t wakeups;                                   // number of times the CPU woke up from sleep in the mode
+} IdleModeStats;
+
+class IdleSleep
+{
+  public:
+    IdleSleep(void);
+    void activity(long t);                                  // something happened that needs quick responses; stay in IDLE_MODE_FAST for IDLE_FAST_MILLIS
+    uint8_t getMode(long t);                                // get the current mode
+    void sleep(void);                                       // sleep until the next interrupt: the next millis() tick (at most about 1ms), a byte from the ESP module or USB, or the end of a TinyUI background update
+    uint8_t getDutyCycle(uint8_t mode);                     // percentage of the time in the given mode spent awake
+    uint16_t getCurrent(uint8_t mode);                      // estimated average CPU current in the given mode, in microamps
+    const IdleModeStats *getStats(uint8_t mode);
+  private:
+    long _lastActivity;                                     // millis() time of the last activity()
+    uint8_t _mode;
+    uint32_t _lastMicros;                                   // micros() time up to which time has been added to the stats
+    IdleModeStats _stats[IDLE_MODES];
+    void _account(uint32_t now, uint32_t slept);
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+  LedSequencer.cpp - Library for playing LED animations made of keyframes, leaving the fades between them to the ATTINY.
+  Released under the MIT License.
+*/
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "TinyUI.h"
+#include "LedSequencer.h"
+
+LedSequencer::LedSequencer(void)
+{
+  _ui = NULL;
+  _keys = NULL;
+  _owned = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void LedSequencer::setUi(TinyUI *ui)
+{
+  _ui = ui;
+}
+
+void LedSequencer::play(const LedKeyframe *keys, uint8_t count, uint16_t pixels, uint8_t loops)
+{
+  _release();
+  _keys = count ? keys : NULL;
+  _count = count;
+  _pos = 0;
+  _loops = loops;
+  _pixels = pixels;
+  _next = millis();
+  _lastRun = _next;
+  _sentUpdate = _ui->getStats()->updates - 1;   // the first keyframe can go out in the next update
+}
+
+void LedSequencer::stop(void)
+{
+  _release();
+  _keys = NULL;
+}
+
+void LedSequencer::_release(void)
+{
+  uint8_t i;
+
+  // An animation cut short may have lit LEDs that only its later keyframes would have turned off again
+  if (!_keys)
+  {
+    return;
+  }
+  for (i = 0; i < TINYUI_LED_COUNT; i++)
+  {
+    if ((_owned & (1 << i)) && _ui->getPixel(i))
+    {
+      _ui->setPixelPulseTransition(i, 0, 0, LEDSEQ_RELEASE_FRAMES);
+    }
+  }
+  _owned = 0;
+}
+
+boolean LedSequencer::isPlaying(void)
+{
+  return _keys != NULL;
+}
+
+boolean LedSequencer::run(long t)
+{
+  LedKeyframe key;
+  uint16_t pixels, changed;
+  uint8_t i;
+
+  if (!_keys)
+  {
+    return false;
+  }
+  _stats.millis += t - _lastRun;
+  _lastRun = t;
+
+  // Keyframes can only go out once the ones issued before have been sent, since they may set the same LEDs
+  if (_ui->getStats()->updates == _sentUpdate)
+  {
+    return true;
+  }
+
+  // Issue every keyframe that is due, until one has to wait for time to pass or for the next transaction
+  changed = 0;
+  while (_keys && (t - _next >= 0))
+  {
+    memcpy_P(&key, _keys + _pos, sizeof(key));
+    pixels = (key.flags & LEDSEQ_KEY_PIXELS_ARG) ? _pixels : key.pixels;
+    if ((key.flags & LEDSEQ_KEY_RANDOM) && pixels)
+    {
+      do
+      {
+        i = random(TINYUI_LED_COUNT);
+      } while (!(pixels & (1 << i)));
+      pixels = 1 << i;
+    }
+    if (pixels & changed)
+    {
+      break;
+    }
+    _applyKey(&key, pixels);
+    changed |= pixels;
+    _owned |= pixels;
+    _stats.keyframes++;
+    // Time the next keyframe from when this one was due, so issuing it on the next run() doesn't add up over the animation;
+    // after a long stall, pick up from now rather than rushing out the keyframes that were missed
+    _next = (t - _next > LEDSEQ_MAX_LATE_MILLIS) ? t + key.hold : _next + key.hold;
+    if (++_pos >= _count)
+    {
+      _pos = 0;
+      if ((_loops != LEDSEQ_LOOP_FOREVER) && !--_loops)
+      {
+        _keys = NULL;   // (the last keyframe leaves the LEDs as the animation means them to be)
+        _owned = 0;
+      }
+    }
+    if (key.hold)
+    {
+      break;
+    }
+  }
+  if (changed)
+  {
+    _sentUpdate = _ui->getStats()->updates;
+    _stats.transactions++;
+  }
+  return true;
+}
+
+void LedSequencer::_applyKey(const LedKeyframe *key, uint16_t pixels)
+{
+  uint8_t i, dim;
+
+  for (i = 0; i < TINYUI_LED_COUNT; i++)
+  {
+    if (pixels & (1 << i))
+    {
+      dim = ((key->flags & LEDSEQ_KEY_TOGGLE) && _ui->getPixel(i)) ? 0 : key->dim;
+      _ui->setPixelPulseTransition(i, dim, key->pulse, key->frames);
+    }
+  }
+}
+
+const LedSequencerStats *LedSequencer::getStats(void)
+{
+  return &_stats;
+}
+
+uint16_t LedSequencer::getTransactionRate(void)
+{
+  return _stats.millis ? (_stats.transactions * 1000) / _stats.millis : 0;
+}
@@ -0,0 +1,74 @@
+/*
+  LedSequencer.h - Library for playing LED animations made of keyframes, leaving the fades between them to the ATTINY.
+  Released under the MIT License.
+*/
+
+#ifndef LedSequencer_h
+#define LedSequencer_h
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "TinyUI.h"
+
+#define LEDSEQ_PIXELS_ALL         0x3fff              // every LED
+#define LEDSEQ_LOOP_FOREVER       0                   // pass as loops to play() to repeat until stop() or another play()
+#define LEDSEQ_RELEASE_FRAMES     8                   // frames to fade out the LEDs an animation lit when it is stopped or replaced before its end
+#define LEDSEQ_MAX_LATE_MILLIS    100                 // a keyframe issued later than this starts the timing over from when it went out
+
+// keyframe flags
+#define LEDSEQ_KEY_PIXELS_ARG     0x01                // apply to the pixels passed to play() instead of the keyframe's pixels
+#define LEDSEQ_KEY_RANDOM         0x02                // apply to one LED picked at random from the pixels
+#define LEDSEQ_KEY_TOGGLE         0x04                // fade LEDs that are lit to 0 and LEDs that are off to dim
+
+// One step of an animation: the ATTINY fades the pixels to the targets over frames (at 100 frames per second),
+// and the next keyframe is due hold milliseconds after this one was due. Keyframes with hold 0 that touch different pixels are
+// sent together in one SPI transaction; a keyframe that touches the same pixels waits for the next transaction.
+typedef struct {
+  uint16_t pixels;                                    // bit n set to change LED n
+  uint8_t flags;                                      // LEDSEQ_KEY_...
+  uint8_t dim;                                        // target dimming value
+  uint8_t pulse;                                      // target pulsing period (0 for steady)
+  uint8_t frames;                                     // transition length (TINYUI_TRANS_IMMEDIATE to jump straight to the target)
+  uint16_t hold;                                      // milliseconds until the next keyframe
+} LedKeyframe;
+
+// An animation lives in program space; use it like this:
+//   PgmLedAnimation(name) = { { pixels, flags, dim, pulse, frames, hold }, ... };
+#define PgmLedAnimation(NAME)     const PROGMEM LedKeyframe NAME[]
+#define LedAnimationLength(NAME)  (sizeof(NAME) / sizeof(NAME[0]))
+
+// counters for measuring what animations cost on the SPI bus
+typedef struct {
+  uint32_t keyframes;                                 // number of keyframes issued
+  uint32_t transactions;                              // number of SPI transactions that carried keyframes
+  uint32_t millis;                                    // time spent playing animations
+} LedSequencerStats;
+
+class LedSequencer
+{
+  public:
+    LedSequencer(void);
+    void setUi(TinyUI *ui);
+    void play(const LedKeyframe *keys, uint8_t count, uint16_t pixels = 0, uint8_t loops = 1);   // start an animation (pixels is used by LEDSEQ_KEY_PIXELS_ARG keyframes); replaces any animation already playing (see stop())
+    void stop(void);                                        // stop the animation, fading out the LEDs it has lit (its later keyframes, such as the fade back down, will never be issued)
+    boolean isPlaying(void);
+    boolean run(long t);                                    // issue the keyframes that are due; call before each TinyUI update, returns true while an animation is playing
+    const LedSequencerStats *getStats(void);
+    uint16_t getTransactionRate(void);                      // SPI transactions per second of animation, over all animations played
+  private:
+    TinyUI *_ui;
+    const LedKeyframe *_keys;                               // animation playing, or NULL
+    uint8_t _count;                                         // number of keyframes in the animation
+    uint8_t _pos;                                           // next keyframe to issue
+    uint8_t _loops;                                         // times left to play the animation (LEDSEQ_LOOP_FOREVER to repeat forever)
+    uint16_t _pixels;                                       // pixels for LEDSEQ_KEY_PIXELS_ARG keyframes
+    uint16_t _owned;                                        // pixels the animation has changed
+    long _next;                                             // millis() time the next keyframe is due
+    long _lastRun;                                          // millis() time of the last run() while playing
+    uint32_t _sentUpdate;                                   // TinyUI update count when keyframes were last issued (the next keyframe on the same pixels waits for this to change)
+    LedSequencerStats _stats;
+    void _applyKey(const LedKeyframe *key, uint16_t pixels);
+    void _release(void);
+};
+
+#endif
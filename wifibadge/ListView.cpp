@@ -0,0 +1,165 @@
+/*
+  ListView.cpp - Library for drawing a scrolling list of text rows on the display, redrawing only rows that change.
+  Released under the MIT License.
+*/
+
+#include <Adafruit_SSD1306.h>
+#include "Arduino.h"
+#include "ListView.h"
+#include "Profiler.h"
+
+ListView::ListView(Adafruit_SSD1306 *display)
+{
+  _display = display;
+  _obj = NULL;
+  _count = NULL;
+  _render = NULL;
+  _drawnInverted = 0;
+  memset(&_stats, 0, sizeof(_stats));
+  setSource(NULL, NULL, NULL, false);
+}
+
+void ListView::setSource(void *obj, ListViewCount count, ListViewRender render, boolean selectable)
+{
+  _obj = obj;
+  _count = count;
+  _render = render;
+  _position = 0;
+  _selected = selectable ? 0 : -1;
+  invalidate();
+  _stats.steps++;
+}
+
+void ListView::invalidate(void)
+{
+  uint8_t r;
+  for (r = 0; r < LISTVIEW_ROWS; r++)
+  {
+    _drawnItem[r] = LISTVIEW_ROW_INVALID;
+  }
+}
+
+int ListView::getPosition(void)
+{
+  return _position;
+}
+
+int ListView::getSelected(void)
+{
+  return _selected;
+}
+
+void ListView::select(int n)
+{
+  int count;
+  if (_selected < 0)
+  {
+    return;
+  }
+  _stats.steps++;
+  count = _itemCount();
+  if (n >= count)
+  {
+    n = count - 1;
+  }
+  if (n < 0)
+  {
+    n = 0;
+  }
+  _selected = n;
+  if (_position > _selected)
+  {
+    _position = _selected;
+  }
+  if ((_position + LISTVIEW_ROWS - 1) < _selected)
+  {
+    _position = _selected - (LISTVIEW_ROWS - 1);
+  }
+}
+
+void ListView::scroll(int delta)
+{
+  int count;
+  _stats.steps++;
+  count = _itemCount();
+  _position += delta;
+  if (_position >= count)
+  {
+    _position = count - 1;
+  }
+  if (_position < 0)
+  {
+    _position = 0;
+  }
+}
+
+void ListView::draw(void)
+{
+  uint8_t r;
+  int item, count;
+  boolean inverted, changed;
+
+  count = _itemCount();
+  changed = false;
+  _display->setTextWrap(false);
+  for (r = 0; r < LISTVIEW_ROWS; r++)
+  {
+    item = _position + r;
+    if (item >= count)
+    {
+      item = LISTVIEW_ROW_EMPTY;
+    }
+    inverted = (item != LISTVIEW_ROW_EMPTY) && (item == _selected);
+    if ((item == _drawnItem[r]) && (inverted == !!(_drawnInverted & (1 << r))))
+    {
+      continue;   // this row is already on the screen
+    }
+
+    // Blank the row, then print the item (highlighted if it is the selected one)
+    _display->fillRect(0, r * LISTVIEW_ROW_HEIGHT, SSD1306_LCDWIDTH, LISTVIEW_ROW_HEIGHT, BLACK);
+    if (item != LISTVIEW_ROW_EMPTY)
+    {
+      _display->setCursor(0, r * LISTVIEW_ROW_HEIGHT);
+      if (inverted)
+      {
+        _display->setTextColor(BLACK, WHITE);
+      }
+      _render(_obj, item, _display);
+      if (inverted)
+      {
+        _display->setTextColor(WHITE);
+      }
+    }
+    _drawnItem[r] = item;
+    if (inverted)
+    {
+      _drawnInverted |= 1 << r;
+    }
+    else
+    {
+      _drawnInverted &= ~(1 << r);
+    }
+    _stats.rowsDrawn++;
+    changed = true;
+  }
+  _display->setTextWrap(true);
+
+  // Only push the frame if something on it changed
+  if (changed)
+  {
+    _stats.frames++;
+    PROFILE_START(PROF_DISPLAY);
+    _display->display();
+    PROFILE_STOP(PROF_DISPLAY);
+  }
+}
+
+const ListViewStats *ListView::getStats(void)
+{
+  return &_stats;
+}
+
+int ListView::_itemCount(void)
+{
+  return _count ? _count(_obj) : 0;
+}
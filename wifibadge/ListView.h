@@ -0,0 +1,53 @@
+/*
+  ListView.h - Library for drawing a scrolling list of text rows on the display, redrawing only rows that change.
+  Released under the MIT License.
+*/
+
+#ifndef ListView_h
+#define ListView_h
+
+#include <Adafruit_SSD1306.h>
+#include "Arduino.h"
+
+#define LISTVIEW_ROWS             4                   // number of text rows that fit on the screen
+#define LISTVIEW_ROW_HEIGHT       8                   // height of a row in pixels (text size 1)
+#define LISTVIEW_ROW_EMPTY        -1                  // row is drawn blank
+#define LISTVIEW_ROW_INVALID      -2                  // row contents are unknown and must be redrawn
+
+// The list view does not own its items; it asks its source how many there are and has the source print the one it wants
+typedef int (*ListViewCount)(void *obj);                          // return the number of items
+typedef void (*ListViewRender)(void *obj, int n, Print *out);     // print the text for item n to out (draw() asks for the rows top to bottom)
+
+// counters for measuring repaint cost
+typedef struct {
+  uint32_t steps;                                     // number of navigation steps: setSource(), select(), and scroll() calls
+  uint32_t rowsDrawn;                                 // number of rows drawn (divide by steps for the rows drawn per step)
+  uint32_t frames;                                    // number of draw() calls that pushed a frame to the display
+} ListViewStats;
+
+class ListView
+{
+  public:
+    ListView(Adafruit_SSD1306 *display);
+    void setSource(void *obj, ListViewCount count, ListViewRender render, boolean selectable);   // show a new list, scrolled to the top, and redraw everything on the next draw()
+    void invalidate(void);                                  // redraw every row on the next draw() (call when the items change or something else has drawn on the screen)
+    int getPosition(void);                                  // index of the item in the top row
+    int getSelected(void);                                  // index of the highlighted item (-1 if the list is not selectable)
+    void select(int n);                                     // highlight item n, scrolling it into view
+    void scroll(int delta);                                 // scroll by delta rows, keeping at least one item on the screen
+    void draw(void);                                        // redraw the rows that differ from what is on the screen and push them to the display
+    const ListViewStats *getStats(void);
+  private:
+    Adafruit_SSD1306 *_display;
+    void *_obj;
+    ListViewCount _count;
+    ListViewRender _render;
+    int _position;                                          // item in the top row
+    int _selected;                                          // highlighted item, or -1
+    int _drawnItem[LISTVIEW_ROWS];                          // item currently on the screen in each row (or LISTVIEW_ROW_EMPTY / LISTVIEW_ROW_INVALID)
+    uint8_t _drawnInverted;                                 // bit r set if row r is currently drawn highlighted
+    ListViewStats _stats;
+    int _itemCount(void);
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*
+  MemoryMonitor.cpp - Library for reporting how the ATmega32U4's 2.5KB of SRAM is being used: heap, free list, and stack.
+  Released under the MIT License.
+*/
+
+#include <stdlib.h>
+#include "Arduino.h"
+#include "MemoryMonitor.h"
+
+#ifdef __AVR__
+
+// avr-libc's malloc state: the heap runs from __malloc_heap_start up to __brkval (0 until the first malloc), freed blocks
+// are kept in a list starting at __flp, and malloc keeps __malloc_margin bytes clear below the stack
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+extern char *__brkval;
+extern struct __freelist *__flp;
+extern char _end;
+extern char __stack;
+
+// Paints the RAM from the end of static variables to the top of the stack, before anything else runs (including the
+// constructors); it runs from .init1, so it can't use the stack or count on r1 being 0
+void _memoryPaint(void) __attribute__((naked, used, section(".init1")));
+
+void _memoryPaint(void)
+{
+  __asm volatile (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M" (MEMORY_PAINT));
+}
+
+static char *heapTop(void)
+{
+  return __brkval ? __brkval : __malloc_heap_start;
+}
+
+#else
+
+// Host builds have no fixed RAM layout: the heap figures come from glibc's malloc statistics (where there are any), and the
+// stack is measured from where it was when the MemoryMonitor was constructed, with its peak sampled rather than painted
+#ifdef __GLIBC__
+#include <malloc.h>
+#if __GLIBC_PREREQ(2, 33)
+#define mallinfo mallinfo2   // (mallinfo's int fields are deprecated)
+#endif
+#endif
+static char *_stackBase = NULL;
+static uint16_t _stackPeak = 0;
+
+static uint16_t clamp16(size_t n)
+{
+  return (n < 0xffff) ? n : 0xffff;
+}
+
+static uint16_t stackDepth(void)
+{
+  char here;
+
+  return (_stackBase > &here) ? _stackBase - &here : 0;
+}
+
+#endif
+
+MemoryMonitor::MemoryMonitor(void)
+{
+  _heapPeak = 0;
+#ifndef __AVR__
+  char here;
+
+  _stackBase = &here;
+#endif
+}
+
+void MemoryMonitor::sample(void)
+{
+  uint16_t size;
+
+#ifdef __AVR__
+  size = heapTop() - __malloc_heap_start;
+#else
+#ifdef __GLIBC__
+  size = clamp16(mallinfo().arena);
+#else
+  size = 0;
+#endif
+  if (stackDepth() > _stackPeak)
+  {
+    _stackPeak = stackDepth();
+  }
+#endif
+  if (size > _heapPeak)
+  {
+    _heapPeak = size;
+  }
+}
+
+void MemoryMonitor::getReport(MemoryReport *report)
+{
+  sample();
+  memset(report, 0, sizeof(MemoryReport));
+  report->heapPeak = _heapPeak;
+
+#ifdef __AVR__
+  struct __freelist *f;
+  char *top, *sp, *start, *p;
+  uint16_t gap;
+
+  // Walk the free list
+  for (f = __flp; f; f = f->nx)
+  {
+    report->freeListBlocks++;
+    report->freeListBytes += f->sz + sizeof(size_t);
+    if (f->sz > report->largestFree)
+    {
+      report->largestFree = f->sz;
+    }
+  }
+
+  // Heap and the gap above it (malloc won't hand out the last __malloc_margin bytes below the stack)
+  top = heapTop();
+  sp = (char *) SP;
+  report->heapSize = top - __malloc_heap_start;
+  report->heapUsed = report->heapSize - report->freeListBytes;
+  gap = (sp > top) ? sp - top : 0;
+  if ((gap > __malloc_margin + sizeof(size_t)) && (gap - __malloc_margin - sizeof(size_t) > report->largestFree))
+  {
+    report->largestFree = gap - __malloc_margin - sizeof(size_t);
+  }
+  report->freeBytes = report->freeListBytes + gap;
+
+  // The stack has been as deep as the top of the run of paint above the heap. free() lowers __brkval when it frees the top
+  // block, leaving stale heap data above the heap, so the scan starts at the heap's peak rather than its top, and skips
+  // anything left there by a peak sample() didn't see; if there is no paint at all, the stack has reached the heap
+  report->stackUsed = (char *) RAMEND - sp;
+  start = __malloc_heap_start + _heapPeak;
+  for (p = start; (p < sp) && (*p != (char) MEMORY_PAINT); p++) ;
+  if (p >= sp)
+  {
+    p = start;
+  }
+  for ( ; (p < sp) && (*p == (char) MEMORY_PAINT); p++) ;
+  report->stackPeak = (char *) RAMEND - p + 1;
+#else
+#ifdef __GLIBC__
+  struct mallinfo mi = mallinfo();
+  report->heapSize = clamp16(mi.arena);
+  report->heapUsed = clamp16(mi.uordblks);
+  report->freeListBytes = clamp16(mi.fordblks);
+  report->freeListBlocks = (mi.ordblks < 0xff) ? mi.ordblks : 0xff;
+  report->largestFree = report->freeListBytes;
+  report->freeBytes = report->freeListBytes;
+#endif
+  report->stackUsed = stackDepth();
+  report->stackPeak = _stackPeak;
+#endif
+
+  report->fragmentation = report->freeBytes ? 100 - (uint32_t) report->largestFree * 100 / report->freeBytes : 0;
+}
+
+void MemoryMonitor::print(Print *out)
+{
+  MemoryReport r;
+
+  getReport(&r);
+  out->print(F("heap "));
+  out->print(r.heapUsed);
+  out->print(F(" peak "));
+  out->println(r.heapPeak);
+  out->print(F("free "));
+  out->print(r.freeBytes);
+  out->print(F(" big "));
+  out->println(r.largestFree);
+  out->print(F("frag "));
+  out->print(r.fragmentation);
+  out->print(F("% blocks "));
+  out->println(r.freeListBlocks);
+  out->print(F("stack "));
+  out->print(r.stackUsed);
+  out->print(F(" peak "));
+  out->println(r.stackPeak);
+}
@@ -0,0 +1,38 @@
+/*
+  MemoryMonitor.h - Library for reporting how the ATmega32U4's 2.5KB of SRAM is being used: heap, free list, and stack.
+  Released under the MIT License.
+*/
+
+#ifndef MemoryMonitor_h
+#define MemoryMonitor_h
+
+#include "Arduino.h"
+
+#define MEMORY_PAINT              0xc5                // the free RAM between the heap and the stack is filled with this at reset, so the deepest the stack has been can be found later
+
+// SRAM use, in bytes (heap sizes include the 2 byte header malloc keeps on every block)
+typedef struct {
+  uint16_t heapUsed;                                  // heap handed out by malloc and not yet freed
+  uint16_t heapSize;                                  // size of the heap (from the end of static variables to the top of the highest block)
+  uint16_t heapPeak;                                  // largest heapSize seen by sample()
+  uint16_t freeListBytes;                             // freed blocks inside the heap, waiting to be reused
+  uint8_t freeListBlocks;                             // number of those blocks
+  uint16_t freeBytes;                                 // all free RAM: the free list plus the gap between the heap and the stack
+  uint16_t largestFree;                               // largest block malloc could hand out right now
+  uint8_t fragmentation;                              // percentage of free RAM that can't go to one large malloc
+  uint16_t stackUsed;                                 // stack in use where getReport() was called
+  uint16_t stackPeak;                                 // deepest the stack has been since reset (found from the paint)
+} MemoryReport;
+
+class MemoryMonitor
+{
+  public:
+    MemoryMonitor(void);
+    void sample(void);                                      // note the heap size, for heapPeak; call this now and then (it is cheap), and before freeing a large block
+    void getReport(MemoryReport *report);                   // fill in a report (this scans the free RAM for the stack's paint, so it takes a little while)
+    void print(Print *out);                                 // print a report in four lines of up to 21 characters (it fits on the screen)
+  private:
+    uint16_t _heapPeak;
+};
+
+#endif
@@ -8,6 +8,16 @@
 #include "MenuNodeP.h"
 
 uint8_t MenuNodeP::_locks = 0;
+MenuNodeP *MenuNodeP::_allNodes = NULL;
+
+// number of bits set in each nibble value; used for rank/select over _visibleMask
+static const PROGMEM uint8_t _nibbleBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+static uint8_t _bitCount(uint16_t m)
+{
+  return pgm_read_byte(_nibbleBits + (m & 0x0f)) + pgm_read_byte(_nibbleBits + ((m >> 4) & 0x0f))
+       + pgm_read_byte(_nibbleBits + ((m >> 8) & 0x0f)) + pgm_read_byte(_nibbleBits + (m >> 12));
+}
 
 MenuNodeP::MenuNodeP(const __menu_descr_t *descr, ...)
 {
@@ -24,6 +34,11 @@ MenuNodeP::MenuNodeP(const __menu_descr_t *descr, ...)
     _childCount++;
   }
   va_end(args);
+  if (_childCount > MENU_MAX_CHILDREN)
+  {
+    // (only reachable by constructing a node directly; PgmMenuNode refuses to compile with this many)
+    _childCount = MENU_MAX_CHILDREN;
+  }
 
   _children = (MenuNodeP **) malloc(sizeof(MenuNodeP*) * _childCount);
   va_start(args, descr);
@@ -31,11 +46,13 @@ MenuNodeP::MenuNodeP(const __menu_descr_t *descr, ...)
   {
     _children[i] = va_arg(args, MenuNodeP *);
     _children[i]->_parent = this;
+    _children[i]->_index = i;
   }
   va_end(args);
-  _lastLocks = ~_locks;
-  _unlockedChildren = NULL;
-  _checkLocks();
+  _index = 0;
+  _nextNode = _allNodes;
+  _allNodes = this;
+  _updateVisible();
 }
 
 MenuNodeP::~MenuNodeP(void)
@@ -45,7 +62,60 @@ MenuNodeP::~MenuNodeP(void)
 
 void MenuNodeP::setLocks(uint8_t locks)
 {
-  _locks = locks;
+  MenuNodeP *node;
+  if (_locks != locks)
+  {
+    _locks = locks;
+    for (node = _allNodes; node; node = node->_nextNode)
+    {
+      node->_updateVisible();
+    }
+  }
+}
+
+MenuNodeP *MenuNodeP::findById(MenuNodeP * const *index, uint8_t count, uint32_t id)
+{
+  uint8_t lo, hi, mid;
+  uint32_t midId;
+  MenuNodeP *node;
+  lo = 0;
+  hi = count;
+  while (lo < hi)
+  {
+    mid = (lo + hi) >> 1;
+    node = (MenuNodeP *) pgm_read_ptr(index + mid);
+    midId = node->getId();
+    if (midId == id)
+    {
+      return node;
+    }
+    else if (midId < id)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return NULL;
+}
+
+uint8_t MenuNodeP::checkIndex(MenuNodeP * const *index, uint8_t count)
+{
+  uint8_t i;
+  uint32_t id, lastId;
+  lastId = 0;
+  for (i = 0; i < count; i++)
+  {
+    id = ((MenuNodeP *) pgm_read_ptr(index + i))->getId();
+    if (i && (id <= lastId))
+    {
+      return i;
+    }
+    lastId = id;
+  }
+  return count;
 }
 
 uint32_t MenuNodeP::getId(void)
@@ -68,10 +138,15 @@ boolean MenuNodeP::hasData(void)
   return !!getData();
 }
 
+uint8_t MenuNodeP::getDataLength(void)
+{
+  return pgm_read_byte(&(_descr->dataLength));
+}
+
 uint8_t MenuNodeP::getDataByte(int n)
 {
   const void *p = getData();
-  return p ? pgm_read_byte(((const uint8_t *)p) + n) : 0;
+  return (p && (n >= 0) && (n < getDataLength())) ? pgm_read_byte(((const uint8_t *)p) + n) : 0;
 }
 
 PGM_P MenuNodeP::getText(void)
@@ -84,6 +159,24 @@ char *MenuNodeP::readText(char *buf, size_t n)
   return strncpy_P(buf, getText(), n);
 }
 
+MenuNodeView *MenuNodeP::readView(MenuNodeView *view)
+{
+  const uint8_t *p = (const uint8_t *) getData();
+  uint8_t i, n, bytes[2 + MENU_VIEW_ARGS];
+  view->id = getId();
+  view->hasData = !!p;
+  // only the bytes the leaf has are read (most have just the type); the rest are 0
+  n = p ? getDataLength() : 0;
+  for (i = 0; i < sizeof(bytes); i++)
+  {
+    bytes[i] = (i < n) ? pgm_read_byte(p + i) : 0;
+  }
+  view->type = bytes[0];
+  view->subtype = bytes[1];
+  memcpy(view->arg, bytes + 2, MENU_VIEW_ARGS);
+  return view;
+}
+
 MenuNodeP *MenuNodeP::getParent(void)
 {
   return _parent;
@@ -91,43 +184,60 @@ MenuNodeP *MenuNodeP::getParent(void)
 
 int MenuNodeP::getChildCount(void)
 {
-  _checkLocks();
-  return _unlockedCount;   //_childCount;
+  return _visibleCount;
 }
 
 MenuNodeP *MenuNodeP::getChild(int n)
 {
-  _checkLocks();
-  //return (n < _childCount) ? _children[n] : NULL;
-  return (n < _unlockedCount) ? (_unlockedChildren ? _unlockedChildren : _children)[n] : NULL;
+  uint16_t m;
+  uint8_t c, i;
+  if ((n < 0) || (n >= _visibleCount))
+  {
+    return NULL;
+  }
+  if (_visibleCount == _childCount)
+  {
+    return _children[n];
+  }
+  // select the n-th set bit: skip whole nibbles first, then walk the remaining bits
+  m = _visibleMask;
+  i = 0;
+  while ((c = pgm_read_byte(_nibbleBits + (m & 0x0f))) <= n)
+  {
+    n -= c;
+    m >>= 4;
+    i += 4;
+  }
+  for (;; m >>= 1, i++)
+  {
+    if ((m & 1) && !(n--))
+    {
+      return _children[i];
+    }
+  }
+}
+
+int MenuNodeP::getChildIndex(MenuNodeP *child)
+{
+  // rank of the child among the visible children, or -1 if it is not a visible child of this node
+  if (!child || (child->_parent != this) || !(_visibleMask & (1U << child->_index)))
+  {
+    return -1;
+  }
+  return _bitCount(_visibleMask & ((1U << child->_index) - 1));
 }
 
-void MenuNodeP::_checkLocks(void)
+void MenuNodeP::_updateVisible(void)
 {
-  uint8_t i, l, u;
-  if (_lastLocks != _locks) {
-    if (_unlockedChildren) {
-      free(_unlockedChildren);
-      _unlockedChildren = NULL;
-    }
-    _lastLocks = _locks;
-    l = ~_lastLocks;
-    u = 0;
-    for (i = 0; i < _childCount; i++) {
-      if ((_children[i]->getLocks() & l) == 0) {
-        u++;
-      }
-    }
-    _unlockedCount = u;
-    if (u < _childCount) {
-      _unlockedChildren = (MenuNodeP **) malloc(sizeof(MenuNodeP *) * u);
-      u = 0;
-      for (i = 0; i < _childCount; i++) {
-        if ((_children[i]->getLocks() & l) == 0) {
-          _unlockedChildren[u++] = _children[i];
-        }
-      }
+  uint8_t i, l;
+  uint16_t m;
+  l = ~_locks;
+  m = 0;
+  for (i = 0; i < _childCount; i++) {
+    if ((_children[i]->getLocks() & l) == 0) {
+      m |= 1U << i;
     }
   }
+  _visibleMask = m;
+  _visibleCount = _bitCount(m);
 }
-
@@ -9,14 +9,26 @@
 
 #include "Arduino.h"
 
+#define MENU_MAX_CHILDREN   16    // most children a node can have (visibility is tracked in a 16-bit mask); PgmMenuNode checks this at compile time
+#define MENU_VIEW_ARGS      2     // number of data bytes after type and subtype copied into a MenuNodeView
+
 typedef struct __menu_descr {
   uint32_t id;
   const void *data;
   PGM_P text;
   uint8_t locks;
-  uint8_t reserved;
+  uint8_t dataLength;             // bytes in data (0 if there is none)
 } __menu_descr_t;
 
+// RAM copy of the parts of a descriptor that are checked often; filled by readView so callers can avoid repeated PROGMEM reads
+typedef struct {
+  uint32_t id;
+  boolean hasData;
+  uint8_t type;                   // data byte 0
+  uint8_t subtype;                // data byte 1
+  uint8_t arg[MENU_VIEW_ARGS];    // data bytes 2 and up (bytes past the end of the data are 0)
+} MenuNodeView;
+
 #define _PASTE_INDIRECT(A, B) A ## B
 #define _PASTE(A, B) _PASTE_INDIRECT(A, B)
 
@@ -34,14 +46,19 @@ MenuNodeP NAME(&_DESCRNAME, CHILDREN)
 #define PgmMenuNode(NAME, ID, DATA, TEXT, CHILDREN...)   _PgmMenuNodeHelper(NAME, _PASTE(__MENU_DESCR_, __LINE__), ID, _PASTE(__MENU_DATA_, __LINE__), DATA, _PASTE(__MENU_TITLE_, __LINE__), TEXT, ## CHILDREN, NULL)
 */
 
+// (declared only, for counting a macro's arguments at compile time: sizeof(_menuArgCount(ARGS)) is the number of ARGS)
+template <typename... T> char (&_menuArgCount(T...))[sizeof...(T)];
+
 #define _PgmMenuNodeHelper(NAME, _DESCRNAME, ID, LOCKS, _TEXTNAME, TEXT, CHILDREN...)          \
+static_assert(sizeof(_menuArgCount(CHILDREN)) <= MENU_MAX_CHILDREN + 1,                        \
+  #NAME " has more than MENU_MAX_CHILDREN children");                                          \
 const PROGMEM char _TEXTNAME[] = TEXT;                                                         \
 const PROGMEM __menu_descr_t _DESCRNAME = {                                                    \
   .id = ID,                                                                                    \
   .data = NULL,                                                                                \
   .text = _TEXTNAME,                                                                           \
   .locks = LOCKS,                                                                              \
-  .reserved = 0                                                                                \
+  .dataLength = 0                                                                              \
 };                                                                                             \
 MenuNodeP NAME(&_DESCRNAME, CHILDREN)
 #define PgmMenuNode(NAME, ID, LOCKS, TEXT, CHILDREN...)   _PgmMenuNodeHelper(NAME, _PASTE(__MENU_DESCR_, __LINE__), ID, LOCKS, _PASTE(__MENU_TITLE_, __LINE__), TEXT, ## CHILDREN, NULL)
@@ -54,39 +71,50 @@ const PROGMEM __menu_descr_t _DESCRNAME = {
   .data = _DATANAME,                                                                           \
   .text = _TEXTNAME,                                                                           \
   .locks = LOCKS,                                                                              \
-  .reserved = 0                                                                                \
+  .dataLength = sizeof(_DATANAME)                                                              \
 };                                                                                             \
 MenuNodeP NAME(&_DESCRNAME, NULL)
 #define PgmMenuLeaf(NAME, ID, LOCKS, TEXT, DATA...)       _PgmMenuLeafHelper(NAME, _PASTE(__MENU_DESCR_, __LINE__), ID, LOCKS, _PASTE(__MENU_TITLE_, __LINE__), TEXT, _PASTE(__MENU_DATA_, __LINE__), ## DATA)
 
 #define PgmMenuText(NAME, ID, LOCKS, TEXT)                _PgmMenuNodeHelper(NAME, _PASTE(__MENU_DESCR_, __LINE__), ID, LOCKS, _PASTE(__MENU_TITLE_, __LINE__), TEXT, NULL)
 
+// Index of menu nodes for MenuNodeP::findById; nodes MUST be listed in ascending order of ID since the index is binary searched
+// (check it with MenuNodeP::checkIndex at startup)
+#define PgmMenuIndex(NAME, NODES...)                      MenuNodeP * const NAME[] PROGMEM = { NODES }
+
 class MenuNodeP
 {
   public:
     MenuNodeP(const __menu_descr_t *descr, ...);
     ~MenuNodeP(void);
     static void setLocks(uint8_t locks);
+    static MenuNodeP *findById(MenuNodeP * const *index, uint8_t count, uint32_t id);
+    static uint8_t checkIndex(MenuNodeP * const *index, uint8_t count);   // position of the first node in the index whose ID is not above the one before it, or count if the index is sorted
     uint32_t getId(void);
     uint8_t getLocks(void);
     const void *getData(void);
     boolean hasData(void);
-    uint8_t getDataByte(int n);
+    uint8_t getDataLength(void);
+    uint8_t getDataByte(int n);                             // data byte n, or 0 past the end of the data
     PGM_P getText(void);
     char *readText(char *buf, size_t n);
+    MenuNodeView *readView(MenuNodeView *view);
     MenuNodeP *getParent(void);
     int getChildCount(void);
     MenuNodeP *getChild(int n);
+    int getChildIndex(MenuNodeP *child);
   private:
     static uint8_t _locks;
+    static MenuNodeP *_allNodes;      // every constructed node, so setLocks can refresh visibility without allocating
     const __menu_descr_t *_descr;
     MenuNodeP *_parent;
-    int _childCount;
+    MenuNodeP *_nextNode;
+    uint8_t _index;                   // position of this node in its parent's _children
+    uint8_t _childCount;
     MenuNodeP **_children;
-    uint8_t _lastLocks;
-    uint8_t _unlockedCount;
-    MenuNodeP **_unlockedChildren;
-    void _checkLocks(void);
+    uint16_t _visibleMask;            // bit i set if _children[i] is unlocked
+    uint8_t _visibleCount;            // number of bits set in _visibleMask
+    void _updateVisible(void);
 };
 
 #endif
@@ -0,0 +1,201 @@
+/*
+  NetworkCounter.cpp - Library for estimating how many different networks the scanner has seen, and how many are new since the last scan.
+  Released under the MIT License.
+*/
+
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "NetworkCounter.h"
+
+#define MAC_LENGTH    6
+
+// 128 * ln(128 / V) for V = 1 to 128 empty registers; small counts are estimated from the number of empty registers (linear
+// counting), since HyperLogLog overestimates them
+const uint16_t NetCountLinear[NETCOUNT_REGISTERS] PROGMEM = {
+  621, 532, 480, 444, 415, 392, 372, 355, 340, 326, 314, 303, 293, 283, 274, 266,
+  258, 251, 244, 238, 231, 225, 220, 214, 209, 204, 199, 195, 190, 186, 182, 177,
+  174, 170, 166, 162, 159, 155, 152, 149, 146, 143, 140, 137, 134, 131, 128, 126,
+  123, 120, 118, 115, 113, 110, 108, 106, 104, 101, 99, 97, 95, 93, 91, 89,
+  87, 85, 83, 81, 79, 77, 75, 74, 72, 70, 68, 67, 65, 63, 62, 60,
+  59, 57, 55, 54, 52, 51, 49, 48, 47, 45, 44, 42, 41, 40, 38, 37,
+  35, 34, 33, 32, 30, 29, 28, 27, 25, 24, 23, 22, 21, 19, 18, 17,
+  16, 15, 14, 13, 12, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+};
+
+// Mixes a hash so every output bit depends on every input bit
+static uint32_t netMix(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bUL;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35UL;
+  h ^= h >> 16;
+  return h;
+}
+
+// FNV-1a over the BSSID and SSID, then mixed (the registers take their index from the top bits and their rank from the bits
+// below, as far down as the first 1)
+static uint32_t netHash(const uint8_t *mac, const char *ssid)
+{
+  uint32_t h = 2166136261UL;
+  uint8_t i;
+
+  for (i = 0; i < MAC_LENGTH; i++)
+  {
+    h = (h ^ mac[i]) * 16777619UL;
+  }
+  while (*ssid)
+  {
+    h = (h ^ (uint8_t) *ssid++) * 16777619UL;
+  }
+  return netMix(h);
+}
+
+NetworkCounter::NetworkCounter(uint16_t eepromAddr)
+{
+  _addr = eepromAddr;
+  _lastCheckpoint = 0;
+  clear();
+}
+
+uint8_t NetworkCounter::_check(void)
+{
+  uint8_t i, c;
+
+  c = NETCOUNT_MAGIC;
+  for (i = 0; i < sizeof(_regs); i++)
+  {
+    c = (c << 1 | c >> 7) ^ _regs[i];
+  }
+  return c;
+}
+
+void NetworkCounter::begin(void)
+{
+  if ((_addr == NETCOUNT_NO_EEPROM) || (eeprom_read_byte((const uint8_t *) _addr) != NETCOUNT_MAGIC))
+  {
+    return;
+  }
+  eeprom_read_block(_regs, (const void *) (_addr + 1), sizeof(_regs));
+  if (eeprom_read_byte((const uint8_t *) (_addr + 1 + sizeof(_regs))) != _check())
+  {
+    memset(_regs, 0, sizeof(_regs));
+  }
+  _estimateValid = false;
+}
+
+void NetworkCounter::clear(void)
+{
+  memset(_regs, 0, sizeof(_regs));
+  memset(_bloom, 0, sizeof(_bloom));
+  _scan = 0;
+  _newCount = 0;
+  _estimateValid = false;
+  _dirty = true;
+}
+
+void NetworkCounter::startScan(void)
+{
+  _scan ^= 1;
+  memset(_bloom[_scan], 0, sizeof(_bloom[_scan]));
+  _newCount = 0;
+}
+
+void NetworkCounter::add(const uint8_t *mac, const char *ssid)
+{
+  uint32_t h, w;
+  uint8_t i, b, idx, rank, reg;
+  boolean inLast, inScan;
+
+  h = netHash(mac, ssid);
+
+  // HyperLogLog: the rank is the position of the first 1 bit after the register index
+  idx = h >> NETCOUNT_INDEX_SH;
+  w = h << (32 - NETCOUNT_INDEX_SH);
+  for (rank = 1; (rank < NETCOUNT_RANK_MAX) && !(w & 0x80000000UL); rank++)
+  {
+    w <<= 1;
+  }
+  reg = (idx & 1) ? _regs[idx >> 1] >> 4 : _regs[idx >> 1] & 0x0f;
+  if (rank > reg)
+  {
+    _regs[idx >> 1] = (idx & 1) ? (_regs[idx >> 1] & 0x0f) | (rank << 4) : (_regs[idx >> 1] & 0xf0) | rank;
+    _estimateValid = false;
+    _dirty = true;
+  }
+
+  // Bloom filters: new if the last scan didn't have it and this scan hasn't had it yet (the ESP can list a network twice). Their
+  // bits come from mixing the hash again, as a rank of 9 or more reaches down into any bits of h they could take.
+  h = netMix(h ^ NETCOUNT_BLOOM_SEED);
+  inLast = true;
+  inScan = true;
+  for (i = 0; i < NETCOUNT_BLOOM_HASHES; i++)
+  {
+    b = h >> (i << 3);
+    if (!(_bloom[_scan ^ 1][b >> 3] & (1 << (b & 7))))
+    {
+      inLast = false;
+    }
+    if (!(_bloom[_scan][b >> 3] & (1 << (b & 7))))
+    {
+      inScan = false;
+      _bloom[_scan][b >> 3] |= 1 << (b & 7);
+    }
+  }
+  if (!inLast && !inScan && (_newCount < 0xff))
+  {
+    _newCount++;
+  }
+}
+
+uint16_t NetworkCounter::getCount(void)
+{
+  uint32_t sum, e;
+  uint8_t i, j, reg, empty;
+
+  if (_estimateValid)
+  {
+    return _estimate;
+  }
+  sum = 0;
+  empty = 0;
+  for (i = 0; i < sizeof(_regs); i++)
+  {
+    for (j = 0; j < 2; j++)
+    {
+      reg = j ? _regs[i] >> 4 : _regs[i] & 0x0f;
+      sum += 1UL << (NETCOUNT_RANK_MAX - reg);   // 2^-reg, scaled by 2^15
+      if (!reg)
+      {
+        empty++;
+      }
+    }
+  }
+  e = NETCOUNT_ALPHA_MM / sum;
+  if ((e <= NETCOUNT_REGISTERS * 5 / 2) && empty)
+  {
+    e = pgm_read_word(&NetCountLinear[empty - 1]);
+  }
+  _estimate = (e < 0xffff) ? e : 0xffff;
+  _estimateValid = true;
+  return _estimate;
+}
+
+uint8_t NetworkCounter::getNewCount(void)
+{
+  return _newCount;
+}
+
+void NetworkCounter::run(long t)
+{
+  if (!_dirty || (_addr == NETCOUNT_NO_EEPROM) || (t - _lastCheckpoint < (long) NETCOUNT_CHECKPOINT_MILLIS))
+  {
+    return;
+  }
+  eeprom_update_byte((uint8_t *) _addr, NETCOUNT_MAGIC);
+  eeprom_update_block(_regs, (void *) (_addr + 1), sizeof(_regs));
+  eeprom_update_byte((uint8_t *) (_addr + 1 + sizeof(_regs)), _check());
+  _dirty = false;
+  _lastCheckpoint = t;
+}
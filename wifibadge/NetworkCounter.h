@@ -0,0 +1,54 @@
+/*
+  NetworkCounter.h - Library for estimating how many different networks the scanner has seen, and how many are new since the last scan.
+  Released under the MIT License.
+*/
+
+#ifndef NetworkCounter_h
+#define NetworkCounter_h
+
+#include "Arduino.h"
+
+// The total is a HyperLogLog estimate: each network's hash picks a register and records the longest run of leading zero bits seen
+// there, which grows with the number of different networks. 128 4-bit registers keep it within about 9% (1.04 / sqrt(128)).
+#define NETCOUNT_REGISTERS        128
+#define NETCOUNT_INDEX_SH         25                  // the top 7 bits of the hash pick the register
+#define NETCOUNT_RANK_MAX         15                  // most a 4-bit register can hold (enough for millions of networks)
+#define NETCOUNT_ALPHA_MM         384007922UL         // the HyperLogLog constant for 128 registers, times 128^2, times 2^15
+
+// Networks new since the last scan are found with two Bloom filters, one for the scan in progress and one for the scan before it;
+// a network counts as new if the last scan's filter doesn't have it (wrongly "not new" about 3% of the time with 30 networks)
+#define NETCOUNT_BLOOM_BITS       256
+#define NETCOUNT_BLOOM_HASHES     3                   // bits set per network, each picked by 8 bits of a second hash
+#define NETCOUNT_BLOOM_SEED       0x9e3779b9UL        // mixed into the hash to make the second one
+
+// The registers are checkpointed to EEPROM (if an address is given) at most this often, so the count survives a restart
+#define NETCOUNT_CHECKPOINT_MILLIS  600000UL
+#define NETCOUNT_NO_EEPROM        0xffff              // pass as the EEPROM address to keep the count in RAM only
+#define NETCOUNT_MAGIC            'U'
+#define NETCOUNT_EEPROM_SIZE      (NETCOUNT_REGISTERS / 2 + 2)   // magic, registers, and a check byte
+
+class NetworkCounter
+{
+  public:
+    NetworkCounter(uint16_t eepromAddr);
+    void begin(void);                                       // pick up the checkpointed count, if there is one
+    void startScan(void);                                   // a scan is starting: the one just finished becomes the one networks are compared against
+    void add(const uint8_t *mac, const char *ssid);         // count a network from the scan in progress (in constant time)
+    uint16_t getCount(void);                                // estimated number of different networks seen
+    uint8_t getNewCount(void);                              // networks in the scan in progress that weren't in the last one
+    void run(long t);                                       // checkpoint the count to EEPROM if it has changed and NETCOUNT_CHECKPOINT_MILLIS has passed
+    void clear(void);                                       // start counting from zero (e.g. at the start of a day)
+  private:
+    uint16_t _addr;
+    uint8_t _regs[NETCOUNT_REGISTERS / 2];                  // two 4-bit registers per byte
+    uint8_t _bloom[2][NETCOUNT_BLOOM_BITS / 8];
+    uint8_t _scan;                                          // index of the scan in progress's Bloom filter
+    uint8_t _newCount;
+    uint16_t _estimate;                                     // cached getCount() result
+    boolean _estimateValid;
+    boolean _dirty;                                         // registers changed since the last checkpoint
+    long _lastCheckpoint;
+    uint8_t _check(void);
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+  PowerMonitor.cpp - Library for watching the supply voltages, estimating how long the battery will last, and saying when to save power.
+  Released under the MIT License.
+*/
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "PowerMonitor.h"
+
+// low and critical millivolts for each source (USB never runs low; empty is the end of each source's discharge curve)
+static const PROGMEM uint16_t powerThresholds[POWER_SOURCES][2] = {
+  { 0, 0 },
+  { POWER_LIPO_LOW_MV, POWER_LIPO_CRITICAL_MV },
+  { POWER_AA_LOW_MV, POWER_AA_CRITICAL_MV }
+};
+
+// voltage of each source at each tenth of its charge used, from full to empty: a typical LiPo cell, and a pair of alkaline AAs
+// (USB has no charge)
+static const PROGMEM uint16_t powerCurves[POWER_SOURCES][POWER_CURVE_POINTS] = {
+  { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  { 4200, 4060, 3980, 3920, 3870, 3820, 3790, 3770, 3740, 3680, POWER_LIPO_EMPTY_MV },
+  { 3000, 2760, 2640, 2560, 2500, 2440, 2380, 2320, 2240, 2140, POWER_AA_EMPTY_MV }
+};
+
+// charge left in a source at a filtered voltage (millivolts << POWER_FILTER_FRAC), in hundredths of a percent, going in a
+// straight line between the points on its curve
+static uint16_t powerChargeFor(uint8_t source, uint16_t volts)
+{
+  uint32_t hi, lo;
+  uint8_t i;
+
+  hi = (uint32_t)pgm_read_word(&powerCurves[source][0]) << POWER_FILTER_FRAC;
+  if (volts >= hi)
+  {
+    return POWER_CHARGE_FULL;
+  }
+  for (i = 1; i < POWER_CURVE_POINTS; i++)
+  {
+    lo = (uint32_t)pgm_read_word(&powerCurves[source][i]) << POWER_FILTER_FRAC;
+    if (volts > lo)
+    {
+      return (POWER_CHARGE_FULL / (POWER_CURVE_POINTS - 1)) * (POWER_CURVE_POINTS - 1 - i) +
+        (POWER_CHARGE_FULL / (POWER_CURVE_POINTS - 1)) * (volts - lo) / (hi - lo);
+    }
+    hi = lo;
+  }
+  return 0;
+}
+
+// level a source is at for a voltage, without hysteresis
+static uint8_t powerLevelFor(uint8_t source, int16_t mv)
+{
+  if (mv >= (int16_t)pgm_read_word(&powerThresholds[source][0]))
+  {
+    return POWER_LEVEL_OK;
+  }
+  if (mv >= (int16_t)pgm_read_word(&powerThresholds[source][1]))
+  {
+    return POWER_LEVEL_LOW;
+  }
+  return POWER_LEVEL_CRITICAL;
+}
+
+PowerMonitor::PowerMonitor(void)
+{
+  _ui = NULL;
+  _seenPackets = 0;
+  _nextSample = 0;
+  _primed = false;
+  memset(_volts, 0, sizeof(_volts));
+  _source = TINYUI_POWER_USB;
+  _level = POWER_LEVEL_OK;
+  _slopeTime = 0;
+  _slopeCharge = 0;
+  _drop = 0;
+}
+
+void PowerMonitor::setUi(TinyUI *ui)
+{
+  _ui = ui;
+}
+
+uint8_t PowerMonitor::getFlags(long t)
+{
+  if (t - _nextSample < 0)
+  {
+    return 0;
+  }
+  // if the ADC data doesn't make it into this update, ask again next time around rather than every update
+  _nextSample = t + POWER_SAMPLE_MILLIS;
+  return TINYUI_GET_POWER;
+}
+
+boolean PowerMonitor::run(long t)
+{
+  uint32_t packets;
+  uint16_t mv;
+  uint8_t i, source, level;
+
+  packets = _ui->getStats()->powerPackets;
+  if (packets == _seenPackets)
+  {
+    return false;
+  }
+  _seenPackets = packets;
+  _nextSample = t + POWER_SAMPLE_MILLIS;
+
+  for (i = 0; i < POWER_SOURCES; i++)
+  {
+    mv = _ui->getPower(i) << POWER_FILTER_FRAC;
+    if (_primed)
+    {
+      _volts[i] += ((int32_t)mv - _volts[i]) >> POWER_FILTER_SH;
+    }
+    else
+    {
+      _volts[i] = mv;
+    }
+  }
+
+  // A battery only powers the badge without USB; with both batteries in, the fuller one does
+  if (_volts[TINYUI_POWER_USB] >= ((uint16_t)POWER_USB_PRESENT_MV << POWER_FILTER_FRAC))
+  {
+    source = TINYUI_POWER_USB;
+  }
+  else
+  {
+    source = (_volts[TINYUI_POWER_LIPO] >= _volts[TINYUI_POWER_AA]) ? TINYUI_POWER_LIPO : TINYUI_POWER_AA;
+  }
+
+  level = _level;
+  if (!_primed || (source != _source))
+  {
+    _source = source;
+    _level = powerLevelFor(_source, getVoltage(_source));
+    _restartSlope(t);
+  }
+  else
+  {
+    _updateLevel();
+    _updateSlope(t);
+  }
+  _primed = true;
+  return _level != level;
+}
+
+// Drops a level as soon as the voltage falls past a threshold, but only goes back up once it is POWER_HYSTERESIS_MV past it
+// again, so a battery sitting right on a threshold (or sagging while the LEDs are busy) doesn't flip back and forth
+void PowerMonitor::_updateLevel(void)
+{
+  int16_t mv;
+  uint8_t down, up;
+
+  mv = getVoltage(_source);
+  down = powerLevelFor(_source, mv);
+  up = powerLevelFor(_source, mv - POWER_HYSTERESIS_MV);
+  if (down > _level)
+  {
+    _level = down;
+  }
+  else if (up < _level)
+  {
+    _level = up;
+  }
+}
+
+void PowerMonitor::_restartSlope(long t)
+{
+  _slopeTime = t;
+  _slopeCharge = getCharge();
+  _drop = 0;
+}
+
+void PowerMonitor::_updateSlope(long t)
+{
+  int32_t d;
+  uint16_t charge;
+
+  if ((_source == TINYUI_POWER_USB) || (t - _slopeTime < POWER_SLOPE_MILLIS))
+  {
+    return;
+  }
+  charge = getCharge();
+  d = ((int32_t)_slopeCharge - charge) << POWER_SLOPE_FRAC;
+  if (_drop)
+  {
+    _drop += (d - _drop) >> POWER_SLOPE_SH;
+  }
+  else
+  {
+    _drop = d;
+  }
+  _slopeTime = t;
+  _slopeCharge = charge;
+}
+
+uint16_t PowerMonitor::getVoltage(uint8_t source)
+{
+  return (source < POWER_SOURCES) ? _volts[source] >> POWER_FILTER_FRAC : 0;
+}
+
+uint8_t PowerMonitor::getSource(void)
+{
+  return _source;
+}
+
+uint8_t PowerMonitor::getLevel(void)
+{
+  return _level;
+}
+
+uint16_t PowerMonitor::getCharge(void)
+{
+  return (_source == TINYUI_POWER_USB) ? 0 : powerChargeFor(_source, _volts[_source]);
+}
+
+uint16_t PowerMonitor::getRuntime(void)
+{
+  uint32_t minutes;
+
+  if ((_source == TINYUI_POWER_USB) || (_drop <= 0))
+  {
+    return POWER_RUNTIME_UNKNOWN;
+  }
+  minutes = ((uint32_t)getCharge() << POWER_SLOPE_FRAC) * POWER_SLOPE_MINUTES / _drop;
+  return (minutes < POWER_RUNTIME_UNKNOWN) ? minutes : POWER_RUNTIME_UNKNOWN - 1;
+}
@@ -0,0 +1,73 @@
+/*
+  PowerMonitor.h - Library for watching the supply voltages, estimating how long the battery will last, and saying when to save power.
+  Released under the MIT License.
+*/
+
+#ifndef PowerMonitor_h
+#define PowerMonitor_h
+
+#include "Arduino.h"
+#include "TinyUI.h"
+
+#define POWER_SOURCES             3                   // TINYUI_POWER_USB, TINYUI_POWER_LIPO, and TINYUI_POWER_AA
+
+// levels, from plenty of power to nearly flat; each level is meant to cut back more
+#define POWER_LEVEL_OK            0
+#define POWER_LEVEL_LOW           1
+#define POWER_LEVEL_CRITICAL      2
+
+#define POWER_SAMPLE_MILLIS       2000                // supply voltages are asked for this often
+#define POWER_FILTER_FRAC         3                   // fraction bits kept in the filtered voltages
+#define POWER_FILTER_SH           3                   // each sample moves the filtered voltage 1/8 of the way (a time constant of about 16 seconds)
+#define POWER_HYSTERESIS_MV       50                  // a battery has to come back this far above a threshold to go back up a level
+#define POWER_USB_PRESENT_MV      4200                // USB is taken to be powering the badge at or above this voltage
+
+// The battery's charge is read off its discharge curve (powerCurves in PowerMonitor.cpp), since a LiPo's voltage falls fast when
+// it is full and when it is nearly empty but hardly at all in between. The runtime estimate comes from how fast the charge is going
+// down, measured over POWER_SLOPE_MILLIS and averaged.
+#define POWER_CURVE_POINTS        11                  // points on each discharge curve: the voltage at each tenth of the charge used, from full to empty
+#define POWER_CHARGE_FULL         10000               // getCharge() of a full battery (hundredths of a percent)
+#define POWER_SLOPE_MILLIS        300000              // 5 minutes
+#define POWER_SLOPE_MINUTES       5
+#define POWER_SLOPE_FRAC          4                   // fraction bits kept in the averaged charge drop
+#define POWER_SLOPE_SH            4                   // each window moves the averaged drop 1/16 of the way (through a LiPo's flat middle, one of the ADC's 5.5mV steps is nearly 3% of the charge)
+#define POWER_RUNTIME_UNKNOWN     0xffff              // getRuntime() result on USB, while the battery isn't falling, or before the first window is over
+
+// Battery thresholds in millivolts: low, critical, and empty (where the runtime estimate runs out). The LiPo figures are for a
+// single cell; the AA figures are for a pair of alkaline cells. Adjust these, and the discharge curves, for other batteries.
+#define POWER_LIPO_LOW_MV         3600
+#define POWER_LIPO_CRITICAL_MV    3450
+#define POWER_LIPO_EMPTY_MV       3300
+#define POWER_AA_LOW_MV           2400
+#define POWER_AA_CRITICAL_MV      2200
+#define POWER_AA_EMPTY_MV         2000
+
+class PowerMonitor
+{
+  public:
+    PowerMonitor(void);
+    void setUi(TinyUI *ui);
+    uint8_t getFlags(long t);                               // TINYUI_GET_POWER when a new sample is due (OR it into the flags of the next update), otherwise 0
+    boolean run(long t);                                    // take in new supply voltages, if any came in; returns true if getLevel() changed
+    uint16_t getVoltage(uint8_t source);                    // filtered voltage of a TINYUI_POWER_... source, in millivolts
+    uint8_t getSource(void);                                // TINYUI_POWER_... source powering the badge
+    uint8_t getLevel(void);                                 // POWER_LEVEL_...
+    uint16_t getCharge(void);                               // estimated charge left in the battery powering the badge, in hundredths of a percent (0 on USB)
+    uint16_t getRuntime(void);                              // estimated minutes until the battery is empty, or POWER_RUNTIME_UNKNOWN
+  private:
+    TinyUI *_ui;
+    uint32_t _seenPackets;                                  // TinyUI's powerPackets count at the last sample taken in
+    long _nextSample;                                       // millis() time the next sample is due
+    boolean _primed;                                        // true once the first sample is in
+    uint16_t _volts[POWER_SOURCES];                         // filtered voltages, millivolts << POWER_FILTER_FRAC
+    uint8_t _source;
+    uint8_t _level;
+    long _slopeTime;                                        // millis() time the current slope window started
+    uint16_t _slopeCharge;                                  // battery charge when it started
+    int32_t _drop;                                          // averaged charge drop per window, hundredths of a percent << POWER_SLOPE_FRAC; 0 if not known yet
+    void _restartSlope(long t);
+    void _updateLevel(void);
+    void _updateSlope(long t);
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+  Profiler.cpp - Library for timing sections of the badge code with Timer1, keeping a log2 histogram and worst case for each.
+  Released under the MIT License.
+*/
+
+#include <avr/pgmspace.h>
+#include "Arduino.h"
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+
+#define PROFILER_TICK_MICROS      (PROFILER_TICK_CYCLES / (F_CPU / 1000000L))
+
+// section names for dump(), in PROF_... order
+const char ProfEspName[] PROGMEM = "esp";
+const char ProfUiUpdateName[] PROGMEM = "ui_update";
+const char ProfUiButtonsName[] PROGMEM = "ui_buttons";
+const char ProfDrawName[] PROGMEM = "draw";
+const char ProfDisplayName[] PROGMEM = "display";
+const char ProfGameName[] PROGMEM = "game";
+const char * const ProfSectionNames[PROF_SECTIONS] PROGMEM = { ProfEspName, ProfUiUpdateName, ProfUiButtonsName, ProfDrawName, ProfDisplayName, ProfGameName };
+
+Profiler profiler;
+
+Profiler::Profiler(void)
+{
+  reset();
+}
+
+void Profiler::begin(void)
+{
+  // Normal mode, counting up from 0 to 0xffff at clock / 64 (the Arduino core sets Timer1 up for 8-bit PWM)
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  TCNT1 = 0;
+}
+
+void Profiler::_record(uint8_t section, uint16_t ticks)
+{
+  ProfilerSection *s;
+  uint8_t b, i;
+  uint16_t n;
+
+  s = _sections + section;
+  for (b = 0, n = ticks; (n > 1) && (b < PROFILER_BUCKETS - 1); n >>= 1)
+  {
+    b++;
+  }
+  if (s->buckets[b] == 0xffff)
+  {
+    for (i = 0; i < PROFILER_BUCKETS; i++)
+    {
+      s->buckets[i] >>= 1;
+    }
+  }
+  s->buckets[b]++;
+  s->count++;
+  if (ticks > s->worst)
+  {
+    s->worst = ticks;
+  }
+}
+
+const ProfilerSection *Profiler::getSection(uint8_t section)
+{
+  return (section < PROF_SECTIONS) ? _sections + section : NULL;
+}
+
+void Profiler::dump(Print *out)
+{
+  uint8_t n, b;
+  ProfilerSection *s;
+
+  for (n = 0; n < PROF_SECTIONS; n++)
+  {
+    s = _sections + n;
+    out->print((const __FlashStringHelper *) pgm_read_ptr(ProfSectionNames + n));
+    out->print(',');
+    out->print(s->count);
+    out->print(',');
+    out->print((uint32_t) s->worst * PROFILER_TICK_MICROS);
+    for (b = 0; b < PROFILER_BUCKETS; b++)
+    {
+      out->print(',');
+      out->print(s->buckets[b]);
+    }
+    out->println();
+  }
+}
+
+void Profiler::reset(void)
+{
+  memset(_sections, 0, sizeof(_sections));
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+  Profiler.h - Library for timing sections of the badge code with Timer1, keeping a log2 histogram and worst case for each.
+  Released under the MIT License.
+*/
+
+#ifndef Profiler_h
+#define Profiler_h
+
+#include "Arduino.h"
+
+// Set to 1 to build the profiler in (it takes 192 bytes of RAM, so it is left out unless the RAM report shows room for it; while
+// it is out, PROFILE_START and PROFILE_STOP do nothing)
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED          0
+#endif
+
+// Timer1 runs free at the CPU clock / 64 while profiling, so a tick is 64 cycles (4us at 16MHz); this takes Timer1 away from
+// analogWrite() on pins 9 and 10. Sections longer than 65536 ticks (262ms) wrap around.
+#define PROFILER_TICK_CYCLES      64
+#define PROFILER_BUCKETS          12                  // bucket 0 counts sections under 2 ticks, bucket n counts 2^n to 2^(n+1) - 1 ticks, and the last counts the rest
+
+// sections
+#define PROF_ESP                  0                   // esp.handleData()
+#define PROF_UI_UPDATE            1                   // leds.run() and ui.updateAsync(): issuing LED changes and starting a transaction with the ATTINY
+#define PROF_UI_BUTTONS           2                   // ui.poll() and ui.getButtonEvents(): capacitive touch filtering and button events
+#define PROF_DRAW                 3                   // redrawing the list on the screen (draw_menu() and drawWifiList())
+#define PROF_DISPLAY              4                   // display.display(): sending a frame to the screen
+#define PROF_GAME                 5                   // games.run()
+#define PROF_SECTIONS             6
+
+#if PROFILER_ENABLED
+
+#define PROFILE_START(section)    profiler.start(section)
+#define PROFILE_STOP(section)     profiler.stop(section)
+
+// timing of one section
+typedef struct {
+  uint16_t buckets[PROFILER_BUCKETS];                 // log2 histogram of durations in ticks (halved when a bucket fills, so it keeps its shape)
+  uint16_t worst;                                     // longest duration in ticks
+  uint32_t count;                                     // number of times the section has run
+} ProfilerSection;
+
+class Profiler
+{
+  public:
+    Profiler(void);
+    void begin(void);                                       // start Timer1
+    inline void start(uint8_t section) { _start[section] = TCNT1; }
+    inline void stop(uint8_t section) { _record(section, TCNT1 - _start[section]); }
+    const ProfilerSection *getSection(uint8_t section);
+    void dump(Print *out);                                  // print every section as CSV: name, count, worst (us), then the bucket counts
+    void reset(void);                                       // clear the histograms
+  private:
+    uint16_t _start[PROF_SECTIONS];                         // TCNT1 when each section last started
+    ProfilerSection _sections[PROF_SECTIONS];
+    void _record(uint8_t section, uint16_t ticks);
+};
+
+extern Profiler profiler;
+
+#else
+
+#define PROFILE_START(section)
+#define PROFILE_STOP(section)
+
+#endif
+
+#endif
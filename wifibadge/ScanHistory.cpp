@@ -0,0 +1,391 @@
+/*
+  ScanHistory.cpp - Library for logging per-channel WiFi scan results over time to EEPROM, delta-encoded and varint-packed.
+  Released under the MIT License.
+*/
+
+#include <avr/eeprom.h>
+#include "Arduino.h"
+#include "ScanHistory.h"
+
+// page header
+#define PAGE_MAGIC            0       // HISTORY_MAGIC, to tell a page of the log from whatever was in the EEPROM before
+#define PAGE_SEQ              1       // sequence number of the page (2 bytes), for finding the newest and oldest pages
+#define PAGE_COUNT            3       // number of records on the page
+#define PAGE_USED             4       // number of bytes of records on the page
+#define PAGE_HEADER_SIZE      5
+#define PAGE_PAYLOAD          (HISTORY_PAGE_SIZE - PAGE_HEADER_SIZE)
+
+#define HISTORY_MAGIC         'I'     // ('H' pages coded peaks against -64 dBm)
+#define MAX_RECORD_SIZE       (3 + 3 + 4 * HISTORY_CHANNELS)   // gap, mask, and a count and RSSI change for every channel
+
+static uint8_t putVarint(uint8_t *buf, uint16_t v)
+{
+  uint8_t n;
+
+  // 7 bits per byte, low bits first, high bit set on every byte but the last
+  for (n = 0; v >= 0x80; v >>= 7)
+  {
+    buf[n++] = (v & 0x7f) | 0x80;
+  }
+  buf[n++] = v;
+  return n;
+}
+
+static inline uint16_t zigzag(int16_t v)
+{
+  return (v << 1) ^ (v >> 15);
+}
+
+static inline int16_t unzigzag(uint16_t v)
+{
+  return (v >> 1) ^ -(int16_t) (v & 1);
+}
+
+ScanHistory::ScanHistory(uint16_t addr, uint16_t size)
+{
+  _addr = addr;
+  _pages = size / HISTORY_PAGE_SIZE;
+  if (_pages > HISTORY_MAX_PAGES)
+  {
+    _pages = HISTORY_MAX_PAGES;
+  }
+  _page = _pages - 1;
+  _seq = 0xffff;
+  _used = HISTORY_PAGE_SIZE;   // no page open yet, so the first record starts one
+  _count = 0;
+  _batchLen = 0;
+  _batchRecords = 0;
+  _intervalValid = false;
+  _logged = false;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+uint16_t ScanHistory::_pageAddr(uint8_t page)
+{
+  return _addr + page * HISTORY_PAGE_SIZE;
+}
+
+uint8_t ScanHistory::_sortPages(uint8_t *order)
+{
+  uint8_t i, j, n, count;
+  uint16_t seq[HISTORY_MAX_PAGES];
+
+  // List the pages that hold records, newest first
+  n = 0;
+  for (i = 0; i < _pages; i++)
+  {
+    count = eeprom_read_byte((const uint8_t *) (_pageAddr(i) + PAGE_COUNT));
+    if ((eeprom_read_byte((const uint8_t *) (_pageAddr(i) + PAGE_MAGIC)) != HISTORY_MAGIC) || !count || (count == 0xff))
+    {
+      continue;
+    }
+    seq[i] = eeprom_read_word((const uint16_t *) (_pageAddr(i) + PAGE_SEQ));
+    for (j = n; (j > 0) && ((int16_t) (seq[i] - seq[order[j - 1]]) > 0); j--)
+    {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+    n++;
+  }
+  return n;
+}
+
+void ScanHistory::begin(void)
+{
+  uint8_t order[HISTORY_MAX_PAGES];
+
+  // Carry on after the newest page
+  if (_sortPages(order))
+  {
+    _page = order[0];
+    _seq = eeprom_read_word((const uint16_t *) (_pageAddr(_page) + PAGE_SEQ));
+  }
+}
+
+void ScanHistory::addScan(const uint8_t *count, const int8_t *peak, long t)
+{
+  uint8_t i;
+
+  // Log what the last interval's scans added up to once a new interval starts
+  if (_intervalValid && (t - _intervalStart >= HISTORY_INTERVAL_MILLIS))
+  {
+    _logRecord();
+    _intervalValid = false;
+  }
+
+  // Keep the most APs and the strongest signal seen on each channel during the interval
+  for (i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    if (!_intervalValid)
+    {
+      _intervalCount[i] = 0;
+      _intervalPeak[i] = HISTORY_RSSI_NONE;
+    }
+    if (count[i])
+    {
+      if (count[i] > _intervalCount[i])
+      {
+        _intervalCount[i] = count[i];
+      }
+      if (peak[i] > _intervalPeak[i])
+      {
+        _intervalPeak[i] = peak[i];
+      }
+    }
+  }
+  if (!_intervalValid)
+  {
+    _intervalStart = t;
+    _intervalValid = true;
+  }
+}
+
+uint8_t ScanHistory::_encode(uint8_t *buf, uint16_t gap)
+{
+  uint8_t i, n;
+  uint16_t mask;
+
+  mask = 0;
+  for (i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    if ((_intervalCount[i] != _lastCount[i]) || (_intervalPeak[i] != _lastPeak[i]))
+    {
+      mask |= 1 << i;
+    }
+  }
+  n = putVarint(buf, gap);
+  n += putVarint(buf + n, mask);
+  for (i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    if (mask & (1 << i))
+    {
+      n += putVarint(buf + n, zigzag((int16_t) _intervalCount[i] - _lastCount[i]));
+      n += putVarint(buf + n, zigzag((int16_t) _intervalPeak[i] - _lastPeak[i]));
+    }
+  }
+  return n;
+}
+
+void ScanHistory::_newPage(void)
+{
+  uint16_t addr;
+  uint8_t i;
+
+  // Take over the next page (the oldest, once the log has wrapped around), and code the first record against empty channels
+  _page = (_page + 1 < _pages) ? _page + 1 : 0;
+  _seq++;
+  _used = 0;
+  _count = 0;
+  addr = _pageAddr(_page);
+  eeprom_update_byte((uint8_t *) (addr + PAGE_COUNT), 0);
+  eeprom_update_byte((uint8_t *) (addr + PAGE_USED), 0);
+  eeprom_update_word((uint16_t *) (addr + PAGE_SEQ), _seq);
+  eeprom_update_byte((uint8_t *) (addr + PAGE_MAGIC), HISTORY_MAGIC);
+  for (i = 0; i < HISTORY_CHANNELS; i++)
+  {
+    _lastCount[i] = 0;
+    _lastPeak[i] = HISTORY_RSSI_NONE;
+  }
+}
+
+void ScanHistory::_logRecord(void)
+{
+  uint8_t buf[MAX_RECORD_SIZE];
+  uint8_t n;
+  uint16_t gap;
+
+  if (!_pages)
+  {
+    return;
+  }
+
+  // Minutes since the last record, or 0 for the first record since startup
+  if (_logged)
+  {
+    gap = (_intervalStart - _lastRecord + HISTORY_INTERVAL_MILLIS / 2) / HISTORY_INTERVAL_MILLIS;
+    gap = gap ? gap : 1;
+  }
+  else
+  {
+    gap = 0;
+  }
+
+  n = _encode(buf, gap);
+  if ((_used + n > PAGE_PAYLOAD) || !_logged)
+  {
+    flush();
+    _newPage();
+    n = _encode(buf, gap);
+  }
+  if (_batchLen + n > HISTORY_BATCH_SIZE)
+  {
+    flush();
+  }
+  memcpy(_batch + _batchLen, buf, n);
+  _batchLen += n;
+  _batchRecords++;
+  _used += n;
+  _count++;
+  memcpy(_lastCount, _intervalCount, HISTORY_CHANNELS);
+  memcpy(_lastPeak, _intervalPeak, HISTORY_CHANNELS);
+  _lastRecord = _intervalStart;
+  _logged = true;
+  _stats.records++;
+  if (_batchRecords >= HISTORY_BATCH_RECORDS)
+  {
+    flush();
+  }
+}
+
+void ScanHistory::flush(void)
+{
+  uint16_t addr;
+
+  if (!_batchLen)
+  {
+    return;
+  }
+
+  // Write the records, then the header that makes them part of the page
+  addr = _pageAddr(_page);
+  eeprom_update_block(_batch, (void *) (addr + PAGE_HEADER_SIZE + _used - _batchLen), _batchLen);
+  eeprom_update_byte((uint8_t *) (addr + PAGE_USED), _used);
+  eeprom_update_byte((uint8_t *) (addr + PAGE_COUNT), _count);
+  _stats.writes++;
+  _stats.bytes += _batchLen;
+  _batchLen = 0;
+  _batchRecords = 0;
+}
+
+boolean ScanHistory::_readVarint(uint16_t addr, uint8_t *pos, uint8_t used, uint16_t *v)
+{
+  uint8_t b, shift;
+
+  *v = 0;
+  for (shift = 0; shift < 16; shift += 7)
+  {
+    if (*pos >= used)
+    {
+      return false;
+    }
+    b = eeprom_read_byte((const uint8_t *) (addr + (*pos)++));
+    *v |= (uint16_t) (b & 0x7f) << shift;
+    if (!(b & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+boolean ScanHistory::_decodePage(uint8_t page, int target, HistoryRecord *rec, uint16_t *age)
+{
+  uint8_t count[HISTORY_CHANNELS];
+  int8_t peak[HISTORY_CHANNELS];
+  uint8_t used, records, pos, ch;
+  uint16_t addr, gap, mask, v;
+  int r;
+
+  addr = _pageAddr(page);
+  used = eeprom_read_byte((const uint8_t *) (addr + PAGE_USED));
+  records = eeprom_read_byte((const uint8_t *) (addr + PAGE_COUNT));
+  addr += PAGE_HEADER_SIZE;
+  if (used > PAGE_PAYLOAD)
+  {
+    return false;
+  }
+  for (ch = 0; ch < HISTORY_CHANNELS; ch++)
+  {
+    count[ch] = 0;
+    peak[ch] = HISTORY_RSSI_NONE;
+  }
+
+  // Replay the records up to the target (-1 for none), then add up the gaps of the ones after it
+  pos = 0;
+  *age = 0;
+  for (r = 0; r < records; r++)
+  {
+    if (!_readVarint(addr, &pos, used, &gap) || !_readVarint(addr, &pos, used, &mask))
+    {
+      return false;
+    }
+    if (r > target)
+    {
+      *age = ((*age == HISTORY_AGE_UNKNOWN) || !gap) ? HISTORY_AGE_UNKNOWN : *age + gap;
+    }
+    for (ch = 0; ch < HISTORY_CHANNELS; ch++)
+    {
+      if (!(mask & (1 << ch)))
+      {
+        continue;
+      }
+      if (!_readVarint(addr, &pos, used, &v))
+      {
+        return false;
+      }
+      count[ch] += unzigzag(v);
+      if (!_readVarint(addr, &pos, used, &v))
+      {
+        return false;
+      }
+      peak[ch] += unzigzag(v);
+    }
+    if (r == target)
+    {
+      memcpy(rec->count, count, HISTORY_CHANNELS);
+      memcpy(rec->peak, peak, HISTORY_CHANNELS);
+    }
+  }
+  return true;
+}
+
+boolean ScanHistory::getRecord(uint16_t n, HistoryRecord *rec)
+{
+  uint8_t order[HISTORY_MAX_PAGES];
+  uint8_t i, pages, count;
+  uint16_t age, pageAge;
+
+  // Pages newer than the one holding the record only add their gaps to its age
+  pages = _sortPages(order);
+  age = 0;
+  for (i = 0; i < pages; i++)
+  {
+    count = eeprom_read_byte((const uint8_t *) (_pageAddr(order[i]) + PAGE_COUNT));
+    if (n < count)
+    {
+      if (!_decodePage(order[i], count - 1 - n, rec, &pageAge))
+      {
+        return false;
+      }
+      rec->age = ((age == HISTORY_AGE_UNKNOWN) || (pageAge == HISTORY_AGE_UNKNOWN)) ? HISTORY_AGE_UNKNOWN : age + pageAge;
+      return true;
+    }
+    n -= count;
+    if (!_decodePage(order[i], -1, NULL, &pageAge))
+    {
+      return false;
+    }
+    age = ((age == HISTORY_AGE_UNKNOWN) || (pageAge == HISTORY_AGE_UNKNOWN)) ? HISTORY_AGE_UNKNOWN : age + pageAge;
+  }
+  return false;
+}
+
+uint16_t ScanHistory::getRecordCount(void)
+{
+  uint8_t order[HISTORY_MAX_PAGES];
+  uint8_t i, n;
+  uint16_t total;
+
+  n = _sortPages(order);
+  total = 0;
+  for (i = 0; i < n; i++)
+  {
+    total += eeprom_read_byte((const uint8_t *) (_pageAddr(order[i]) + PAGE_COUNT));
+  }
+  return total;
+}
+
+const ScanHistoryStats *ScanHistory::getStats(void)
+{
+  return &_stats;
+}
@@ -0,0 +1,77 @@
+/*
+  ScanHistory.h - Library for logging per-channel WiFi scan results over time to EEPROM, delta-encoded and varint-packed.
+  Released under the MIT License.
+*/
+
+#ifndef ScanHistory_h
+#define ScanHistory_h
+
+#include "Arduino.h"
+
+#define HISTORY_CHANNELS          14                  // number of WiFi channels logged
+#define HISTORY_INTERVAL_MILLIS   60000               // scans are combined into one record per this many milliseconds
+#define HISTORY_PAGE_SIZE         128                 // EEPROM is used in pages of this many bytes; the oldest page is dropped when the log is full
+#define HISTORY_MAX_PAGES         8                   // most pages that can be used (1KB)
+#define HISTORY_BATCH_SIZE        64                  // bytes of records held in RAM before they are written
+#define HISTORY_BATCH_RECORDS     4                   // records held in RAM before they are written
+#define HISTORY_RSSI_NONE         -128                // peak RSSI logged for a channel with no networks (weaker than any real network), and the starting point for each page
+#define HISTORY_AGE_UNKNOWN       0xffff              // age of a record from before a restart, since the time in between isn't known
+
+// Each page starts with a header (see ScanHistory.cpp) and holds a run of records. A record is the minutes since the
+// record before it (0 after a restart), a mask of the channels that changed, and for each of those the change in AP
+// count and peak RSSI, all as zigzag varints. The first record on a page is coded against empty channels, so every
+// page can be read on its own. A quiet minute with nothing changed takes two bytes.
+
+// one record, as read back
+typedef struct {
+  uint16_t age;                                       // minutes between this record and the newest one (HISTORY_AGE_UNKNOWN if there was a restart in between)
+  uint8_t count[HISTORY_CHANNELS];                    // most APs seen on each channel in one scan
+  int8_t peak[HISTORY_CHANNELS];                      // strongest RSSI on each channel (HISTORY_RSSI_NONE if there were no APs)
+} HistoryRecord;
+
+// counters for measuring how well the log packs
+typedef struct {
+  uint16_t records;                                   // number of records logged
+  uint16_t writes;                                    // number of batches written to EEPROM
+  uint32_t bytes;                                     // number of record bytes written
+} ScanHistoryStats;
+
+class ScanHistory
+{
+  public:
+    ScanHistory(uint16_t addr, uint16_t size);              // keep the log in the EEPROM from addr to addr + size
+    void begin(void);                                       // find where the log left off (records from now on start a new page)
+    void addScan(const uint8_t *count, const int8_t *peak, long t);   // add the AP counts and peak RSSIs from one scan
+    void flush(void);                                       // write any records held in RAM
+    uint16_t getRecordCount(void);                          // number of records written to EEPROM
+    boolean getRecord(uint16_t n, HistoryRecord *rec);      // read record n, counting back from the newest (0); returns false if there is no such record
+    const ScanHistoryStats *getStats(void);
+  private:
+    uint16_t _addr;
+    uint8_t _pages;                                         // number of pages
+    uint8_t _page;                                          // page being written
+    uint16_t _seq;                                          // sequence number of the page being written
+    uint8_t _used;                                          // bytes of records in the page being written, including the batch
+    uint8_t _count;                                         // number of records in the page being written, including the batch
+    uint8_t _batch[HISTORY_BATCH_SIZE];                     // records not yet written
+    uint8_t _batchLen;
+    uint8_t _batchRecords;
+    uint8_t _lastCount[HISTORY_CHANNELS];                   // the last record logged, which the next one is coded against
+    int8_t _lastPeak[HISTORY_CHANNELS];
+    uint8_t _intervalCount[HISTORY_CHANNELS];               // scans combined so far for the next record
+    int8_t _intervalPeak[HISTORY_CHANNELS];
+    boolean _intervalValid;
+    long _intervalStart;                                    // millis() time of the first scan in the interval
+    long _lastRecord;                                       // millis() time of the last record logged
+    boolean _logged;                                        // true once a record has been logged since startup
+    ScanHistoryStats _stats;
+    uint16_t _pageAddr(uint8_t page);
+    uint8_t _sortPages(uint8_t *order);
+    void _logRecord(void);
+    uint8_t _encode(uint8_t *buf, uint16_t gap);
+    void _newPage(void);
+    boolean _readVarint(uint16_t addr, uint8_t *pos, uint8_t used, uint16_t *v);
+    boolean _decodePage(uint8_t page, int target, HistoryRecord *rec, uint16_t *age);
+};
+
+#endif
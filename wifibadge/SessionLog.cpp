@@ -0,0 +1,283 @@
+/*
+  SessionLog.cpp - Library for recording everything that comes into the badge (touch and power data, ESP module bytes) and replaying it.
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "SessionLog.h"
+
+#if SESSION_LOG_ENABLED
+
+#define PLAY_IDLE     0
+#define PLAY_TIME     1
+#define PLAY_DATA     2
+#define PLAY_READY    3
+
+SessionLog *SessionLog::_active = NULL;
+
+SessionLog::SessionLog(void)
+{
+  _mode = SESSION_OFF;
+  _ui = NULL;
+  _esp = NULL;
+  _port = NULL;
+  _start = 0;
+}
+
+void SessionLog::record(TinyUI *ui, EspModule *esp, Stream *port, long t)
+{
+  stop(t);
+  _ui = ui;
+  _esp = esp;
+  _port = port;
+  _start = t;
+  memset(&_u, 0, sizeof(_u));
+  _mode = SESSION_RECORD;
+  _active = this;
+  _ui->setPacketTap(_tap);
+  _esp->setTap(this);
+}
+
+void SessionLog::replay(TinyUI *ui, EspModule *esp, Stream *port, long t)
+{
+  stop(t);
+  _ui = ui;
+  _esp = esp;
+  _port = port;
+  _start = t;
+  memset(&_u, 0, sizeof(_u));
+  _mode = SESSION_REPLAY;
+  _ui->setReplay(true);
+  _esp->setInput(this);
+}
+
+void SessionLog::stop(long t)
+{
+  if (_mode == SESSION_RECORD)
+  {
+    _ui->setPacketTap(NULL);
+    _esp->setTap(NULL);
+    _drain();
+    _flushUart();
+    _writeLine(SESSION_KIND_END, t - _start, NULL, 0);
+  }
+  else if (_mode == SESSION_REPLAY)
+  {
+    _ui->setReplay(false);
+    _esp->setInput(&Serial1);
+  }
+  _mode = SESSION_OFF;
+}
+
+uint8_t SessionLog::getMode(void)
+{
+  return _mode;
+}
+
+// (called from the SPI interrupt)
+void SessionLog::_tap(uint8_t op, const uint8_t *payload)
+{
+  SessionLog *s = _active;
+  SessionPacket *p;
+
+  if (s->_u.rec.count >= SESSION_SPI_SLOTS)
+  {
+    s->_u.rec.dropped++;
+    return;
+  }
+  p = s->_u.rec.slots + ((s->_u.rec.head + s->_u.rec.count) % SESSION_SPI_SLOTS);
+  p->time = millis() - s->_start;
+  p->packet[0] = op;
+  memcpy(p->packet + 1, payload, TINYUI_PAYLOAD_LENGTH);
+  s->_u.rec.count++;
+}
+
+void SessionLog::_writeLine(char kind, long time, const uint8_t *data, uint8_t len)
+{
+  uint8_t i;
+
+  _port->write(kind);
+  _port->print(time);
+  _port->write(',');
+  for (i = 0; i < len; i++)
+  {
+    _port->write("0123456789abcdef"[data[i] >> 4]);
+    _port->write("0123456789abcdef"[data[i] & 0x0f]);
+  }
+  _port->write('\n');
+}
+
+// Writes out the packets from the SPI interrupt (their slots are only given back once written, so the interrupt never touches them)
+void SessionLog::_drain(void)
+{
+  SessionPacket *p;
+  uint16_t dropped;
+
+  while (_u.rec.count)
+  {
+    p = _u.rec.slots + _u.rec.head;
+    _writeLine(SESSION_KIND_SPI, p->time, p->packet, TINYUI_PACKET_LENGTH);
+    _u.rec.head = (_u.rec.head + 1) % SESSION_SPI_SLOTS;
+    noInterrupts();
+    _u.rec.count--;
+    interrupts();
+  }
+  if (_u.rec.dropped)
+  {
+    noInterrupts();
+    dropped = _u.rec.dropped;
+    _u.rec.dropped = 0;
+    interrupts();
+    _port->write(SESSION_KIND_DROP);
+    _port->println(dropped);
+  }
+}
+
+void SessionLog::_flushUart(void)
+{
+  if (_u.rec.uartCount)
+  {
+    _writeLine(SESSION_KIND_UART, _u.rec.uartTime, _u.rec.uart, _u.rec.uartCount);
+    _u.rec.uartCount = 0;
+  }
+}
+
+size_t SessionLog::write(uint8_t b)
+{
+  long time;
+
+  if (_mode != SESSION_RECORD)
+  {
+    return 0;
+  }
+  // ESP module bytes go on one line until it is full or the time changes
+  time = millis() - _start;
+  if (_u.rec.uartCount && ((_u.rec.uartCount >= SESSION_UART_BATCH) || (time != _u.rec.uartTime)))
+  {
+    _drain();   // (so SPI packets that came in before these bytes are written first)
+    _flushUart();
+  }
+  if (!_u.rec.uartCount)
+  {
+    _u.rec.uartTime = time;
+  }
+  _u.rec.uart[_u.rec.uartCount++] = b;
+  return 1;
+}
+
+// Reads the next line of a replayed session from the port, as far as the port has it; returns true once a whole line is waiting
+boolean SessionLog::_advance(void)
+{
+  int c;
+  uint8_t d;
+
+  while ((_u.play.state != PLAY_READY) && ((c = _port->read()) >= 0))
+  {
+    if ((c == '\n') || (c == '\r'))
+    {
+      if (_u.play.state != PLAY_IDLE)
+      {
+        _u.play.state = (_u.play.kind == SESSION_KIND_DROP) ? PLAY_IDLE : PLAY_READY;
+      }
+    }
+    else if (_u.play.state == PLAY_IDLE)
+    {
+      _u.play.kind = c;
+      _u.play.time = 0;
+      _u.play.nibbles = 0;
+      _u.play.pos = 0;
+      memset(_u.play.data, 0, sizeof(_u.play.data));
+      _u.play.state = PLAY_TIME;
+    }
+    else if (_u.play.state == PLAY_TIME)
+    {
+      if (c == ',')
+      {
+        _u.play.state = PLAY_DATA;
+      }
+      else
+      {
+        _u.play.time = _u.play.time * 10 + (c - '0');
+      }
+    }
+    else if (_u.play.nibbles < (TINYUI_PACKET_LENGTH << 1))
+    {
+      d = (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10;
+      _u.play.data[_u.play.nibbles >> 1] |= (_u.play.nibbles & 1) ? d : d << 4;
+      _u.play.nibbles++;
+    }
+  }
+  return _u.play.state == PLAY_READY;
+}
+
+boolean SessionLog::run(long t)
+{
+  if (_mode == SESSION_RECORD)
+  {
+    _drain();
+    _flushUart();
+  }
+  else if ((_mode == SESSION_REPLAY) && _advance() && (t - _start >= _u.play.time))
+  {
+    switch (_u.play.kind)
+    {
+      case SESSION_KIND_END:
+        stop(t);
+        return true;
+      case SESSION_KIND_SPI:
+        // one packet per run, so each one is turned into button events before the next comes in, as it was when recorded
+        if (_ui->injectPacket(_u.play.data))
+        {
+          _u.play.state = PLAY_IDLE;
+        }
+        break;
+      case SESSION_KIND_UART:
+        break;   // (the ESP module reads these)
+      default:
+        _u.play.state = PLAY_IDLE;   // skip anything else
+        break;
+    }
+  }
+  return false;
+}
+
+int SessionLog::available(void)
+{
+  if ((_mode != SESSION_REPLAY) || !_advance() || (_u.play.kind != SESSION_KIND_UART) || ((long)(millis() - _start) < _u.play.time))
+  {
+    return 0;
+  }
+  return (_u.play.nibbles >> 1) - _u.play.pos;
+}
+
+int SessionLog::read(void)
+{
+  uint8_t b;
+
+  if (!available())
+  {
+    return -1;
+  }
+  b = _u.play.data[_u.play.pos++];
+  if (_u.play.pos >= (_u.play.nibbles >> 1))
+  {
+    _u.play.state = PLAY_IDLE;
+  }
+  return b;
+}
+
+int SessionLog::peek(void)
+{
+  return available() ? _u.play.data[_u.play.pos] : -1;
+}
+
+void SessionLog::flush(void)
+{
+  if (_mode == SESSION_RECORD)
+  {
+    _drain();
+    _flushUart();
+  }
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+  SessionLog.h - Library for recording everything that comes into the badge (touch and power data, ESP module bytes) and replaying it.
+  Released under the MIT License.
+*/
+
+#ifndef SessionLog_h
+#define SessionLog_h
+
+#include "Arduino.h"
+#include "TinyUI.h"
+#include "EspModule.h"
+
+// Set to 1 to build the recorder and replayer in (it takes 130 bytes of RAM, so it is left out unless the RAM report shows room for
+// it; host/replay needs it, and the host build turns it on). The session format below is there either way.
+#ifndef SESSION_LOG_ENABLED
+#define SESSION_LOG_ENABLED       0
+#endif
+
+// modes
+#define SESSION_OFF               0
+#define SESSION_RECORD            1
+#define SESSION_REPLAY            2
+
+// A session is sent and received as lines of text: a kind letter, the millis() time since the session started, a comma, and the
+// data in hex. D lines (records lost because the USB serial port couldn't keep up) are skipped when replaying.
+#define SESSION_KIND_SPI          'S'                 // touch or ADC data packet from the ATTINY (TINYUI_PACKET_LENGTH bytes)
+#define SESSION_KIND_UART         'U'                 // bytes from the ESP module
+#define SESSION_KIND_DROP         'D'                 // number of SPI records lost
+#define SESSION_KIND_END          'E'                 // end of the session (no data)
+
+#define SESSION_SPI_SLOTS         4                   // packets buffered between the SPI interrupt and run()
+#define SESSION_UART_BATCH        16                  // ESP module bytes per line
+
+typedef struct {
+  long time;
+  uint8_t packet[TINYUI_PACKET_LENGTH];
+} SessionPacket;
+
+#if SESSION_LOG_ENABLED
+
+// A SessionLog is the ESP module's input while replaying and its tap while recording, so it is a Stream of ESP module bytes
+class SessionLog : public Stream
+{
+  public:
+    SessionLog(void);
+    void record(TinyUI *ui, EspModule *esp, Stream *port, long t);   // start writing a session to port
+    void replay(TinyUI *ui, EspModule *esp, Stream *port, long t);   // start taking inputs from a session read from port instead of the ATTINY and ESP module
+    void stop(long t);                                      // stop recording (ending the session with an E line) or replaying
+    uint8_t getMode(void);                                  // SESSION_...
+    boolean run(long t);                                    // write out buffered records, or pass on the next replayed SPI packet once it is due (SPI must
+                                                            //   be free, as after TinyUI::poll()); returns true when a replay has just reached its E line
+    size_t write(uint8_t b);                                // (Stream) a byte read from the ESP module, while recording
+    int available(void);                                    // (Stream) replayed ESP module bytes that are due
+    int read(void);
+    int peek(void);
+    void flush(void);
+    using Print::write;
+  private:
+    static SessionLog *_active;                             // the session the TinyUI packet tap goes to
+    static void _tap(uint8_t op, const uint8_t *payload);
+    uint8_t _mode;
+    TinyUI *_ui;
+    EspModule *_esp;
+    Stream *_port;
+    long _start;                                            // millis() time the session started
+    union {
+      struct {
+        SessionPacket slots[SESSION_SPI_SLOTS];             // ring buffer of packets from the SPI interrupt
+        volatile uint8_t head;
+        volatile uint8_t count;
+        volatile uint16_t dropped;                          // packets that didn't fit since the last D line
+        uint8_t uart[SESSION_UART_BATCH];                   // ESP module bytes waiting to be written
+        uint8_t uartCount;
+        long uartTime;                                      // time of the first of them
+      } rec;
+      struct {
+        uint8_t kind;                                       // SESSION_KIND_... of the line being read
+        long time;
+        uint8_t data[TINYUI_PACKET_LENGTH];
+        uint8_t nibbles;                                    // hex digits of data read so far
+        uint8_t pos;                                        // bytes of a U line's data passed on so far
+        uint8_t state;                                      // 0 between lines, 1 in the time, 2 in the data, 3 when a whole line is waiting
+      } play;
+    } _u;
+    void _writeLine(char kind, long time, const uint8_t *data, uint8_t len);
+    void _drain(void);
+    void _flushUart(void);
+    boolean _advance(void);
+};
+
+#endif
+
+#endif
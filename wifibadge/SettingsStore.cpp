@@ -0,0 +1,143 @@
+/*
+  SettingsStore.cpp - Library for keeping a block of settings in the ATTINY's EEPROM as a journal of records that rotates across the EEPROM.
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "TinyUI.h"
+#include "SettingsStore.h"
+
+#define CRC8_POLY   0x31      // CRC-8 polynomial x^8 + x^5 + x^4 + 1
+
+SettingsStore::SettingsStore(TinyUI *ui, uint16_t addr, uint16_t size, void *data, uint8_t len, uint8_t version)
+{
+  _ui = ui;
+  _addr = addr;
+  _data = (uint8_t *) data;
+  _len = (len > SETTINGS_MAX_LENGTH) ? SETTINGS_MAX_LENGTH : len;
+  _version = version;
+  _slots = ((size > SETTINGS_MAX_JOURNAL) ? SETTINGS_MAX_JOURNAL : size) / (_len + SETTINGS_RECORD_OVERHEAD);
+  _slot = _slots - 1;   // with nothing stored, the first record goes in slot 0
+  _seq = 0xff;
+  _stored = false;
+  _pending = false;
+  memset(_saved, 0, sizeof(_saved));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+uint8_t SettingsStore::_crc(uint8_t seq, const uint8_t *data)
+{
+  uint8_t crc, i, j;
+
+  // Start from the version so records from a different layout never pass
+  crc = _version ^ seq;
+  for (j = 0; j < 8; j++)
+  {
+    crc = (crc & 0x80) ? (crc << 1) ^ CRC8_POLY : crc << 1;
+  }
+  for (i = 0; i < _len; i++)
+  {
+    crc ^= data[i];
+    for (j = 0; j < 8; j++)
+    {
+      crc = (crc & 0x80) ? (crc << 1) ^ CRC8_POLY : crc << 1;
+    }
+  }
+  return crc;
+}
+
+boolean SettingsStore::load(void)
+{
+  uint8_t buf[SETTINGS_MAX_JOURNAL];
+  uint8_t *rec;
+  uint8_t i;
+  boolean found;
+
+  // Read the whole journal at once and keep the valid record with the newest sequence number
+  if (!_slots || !_ui->readEEPROM(_addr, _slots * (_len + SETTINGS_RECORD_OVERHEAD), buf))
+  {
+    return false;
+  }
+  found = false;
+  for (i = 0; i < _slots; i++)
+  {
+    rec = buf + i * (_len + SETTINGS_RECORD_OVERHEAD);
+    if ((rec[_len + 1] == _crc(rec[0], rec + 1)) && (!found || ((int8_t) (rec[0] - _seq) > 0)))
+    {
+      found = true;
+      _slot = i;
+      _seq = rec[0];
+    }
+  }
+  if (found)
+  {
+    _stored = true;
+    rec = buf + _slot * (_len + SETTINGS_RECORD_OVERHEAD);
+    memcpy(_data, rec + 1, _len);
+    memcpy(_saved, rec + 1, _len);
+  }
+  return found;
+}
+
+void SettingsStore::changed(void)
+{
+  _stats.changes++;
+  _pending = true;
+  _due = millis() + SETTINGS_SAVE_DELAY;
+}
+
+void SettingsStore::run(long t)
+{
+  if (_pending && (t - _due >= 0))
+  {
+    flush();
+  }
+}
+
+void SettingsStore::flush(void)
+{
+  uint8_t rec[SETTINGS_MAX_LENGTH + SETTINGS_RECORD_OVERHEAD];
+  uint8_t slot;
+
+  if (!_pending || !_slots)
+  {
+    return;
+  }
+  _pending = false;
+  if (_stored && !memcmp(_data, _saved, _len))
+  {
+    _stats.skipped++;
+    return;
+  }
+
+  // Write the next slot along; the newest record stays valid until this one is complete
+  slot = (_slot + 1 < _slots) ? _slot + 1 : 0;
+  rec[0] = _seq + 1;
+  memcpy(rec + 1, _data, _len);
+  rec[_len + 1] = _crc(rec[0], rec + 1);
+  if (_ui->writeEEPROM(_addr + slot * (_len + SETTINGS_RECORD_OVERHEAD), _len + SETTINGS_RECORD_OVERHEAD, rec))
+  {
+    _slot = slot;
+    _seq = rec[0];
+    _stored = true;
+    memcpy(_saved, _data, _len);
+    _stats.writes++;
+    _stats.bytesWritten += _len + SETTINGS_RECORD_OVERHEAD;
+  }
+  else
+  {
+    // Try again later
+    _pending = true;
+    _due = millis() + SETTINGS_SAVE_DELAY;
+  }
+}
+
+uint8_t SettingsStore::getSlotCount(void)
+{
+  return _slots;
+}
+
+const SettingsStoreStats *SettingsStore::getStats(void)
+{
+  return &_stats;
+}
@@ -0,0 +1,56 @@
+/*
+  SettingsStore.h - Library for keeping a block of settings in the ATTINY's EEPROM as a journal of records that rotates across the EEPROM.
+  Released under the MIT License.
+*/
+
+#ifndef SettingsStore_h
+#define SettingsStore_h
+
+#include "Arduino.h"
+#include "TinyUI.h"
+
+#define SETTINGS_MAX_LENGTH       16                  // largest block of settings that can be stored
+#define SETTINGS_MAX_JOURNAL      64                  // largest EEPROM area the journal can use (all of the ATTINY88's EEPROM)
+#define SETTINGS_SAVE_DELAY       3000                // milliseconds to wait after the last change before writing, so a burst of changes costs one write
+#define SETTINGS_RECORD_OVERHEAD  2                   // bytes added to each record (sequence number and CRC)
+
+// Each record is a sequence number, a copy of the settings, and a CRC-8 over both. Records are written to the slots
+// in turn, so every slot wears at the same rate, and a record cut short by a power loss fails its CRC and is ignored,
+// leaving the one before it in place.
+
+// counters for measuring EEPROM wear
+typedef struct {
+  uint16_t changes;                                   // number of times changed() was called
+  uint16_t writes;                                    // number of records written
+  uint16_t skipped;                                   // number of writes skipped because the settings were changed back to what was already stored
+  uint32_t bytesWritten;                              // number of EEPROM bytes written
+} SettingsStoreStats;
+
+class SettingsStore
+{
+  public:
+    SettingsStore(TinyUI *ui, uint16_t addr, uint16_t size, void *data, uint8_t len, uint8_t version);   // keep the len bytes at data in the EEPROM from addr to addr + size; changing version discards records written by other versions
+    boolean load(void);                                     // restore data from the newest valid record (in one EEPROM read); returns false if there isn't one, leaving data as it is
+    void changed(void);                                     // note that data has changed; it is written SETTINGS_SAVE_DELAY after the last change
+    void run(long t);                                       // write data if a change is due to be saved; call every loop
+    void flush(void);                                       // write data now if there is an unsaved change
+    uint8_t getSlotCount(void);                             // number of records that fit, so each EEPROM byte is written once per this many writes
+    const SettingsStoreStats *getStats(void);
+  private:
+    TinyUI *_ui;
+    uint16_t _addr;
+    uint8_t *_data;
+    uint8_t _len;
+    uint8_t _version;
+    uint8_t _slots;                                         // number of records that fit
+    uint8_t _slot;                                          // slot of the newest record
+    uint8_t _seq;                                           // sequence number of the newest record
+    uint8_t _saved[SETTINGS_MAX_LENGTH];                    // copy of the newest record's data
+    boolean _stored;                                        // true if there is a valid record in the EEPROM
+    boolean _pending;                                       // true if a change is waiting to be written
+    long _due;                                              // millis() time the change is written
+    SettingsStoreStats _stats;
+    uint8_t _crc(uint8_t seq, const uint8_t *data);
+};
+
+#endif
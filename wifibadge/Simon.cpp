@@ -7,117 +7,140 @@
 #include <Adafruit_SSD1306.h>
 #include "Arduino.h"
 #include "TinyUI.h"
+#include "LedSequencer.h"
 #include "Simon.h"
 
+// LEDs around each button
+#define SIMON_PIXELS_SELECT     ((1 << 0) | (1 << 3) | (1 << 6) | (1 << 9))
+#define SIMON_PIXELS_UP         ((1 << 11) | (1 << 0) | (1 << 1))
+#define SIMON_PIXELS_RIGHT      ((1 << 2) | (1 << 3) | (1 << 4))
+#define SIMON_PIXELS_DOWN       ((1 << 5) | (1 << 6) | (1 << 7))
+#define SIMON_PIXELS_LEFT       ((1 << 8) | (1 << 9) | (1 << 10))
+
+// Light up a symbol's LEDs, then let them fade out
+PgmLedAnimation(SimonFlash) = {
+  { 0, LEDSEQ_KEY_PIXELS_ARG, 255, 0, TINYUI_TRANS_IMMEDIATE, 0 },
+  { 0, LEDSEQ_KEY_PIXELS_ARG, 0, 0, SIMON_FLASH_FRAMES, 0 }
+};
+PgmLedAnimation(SimonWrong) = {
+  { 0, LEDSEQ_KEY_PIXELS_ARG, 255, 0, TINYUI_TRANS_IMMEDIATE, 0 },
+  { 0, LEDSEQ_KEY_PIXELS_ARG, 0, 0, SIMON_WRONG_FRAMES, 0 }
+};
+
+// Chase around the ring: each step lights one LED and starts the rest fading (LEDs already fading or off are left alone by TinyUI)
+#define SIMON_WINNER_STEP(n) \
+  { LEDSEQ_PIXELS_ALL & ~(1 << (n)), 0, 0, 0, SIMON_WINNER_FRAMES, 0 }, \
+  { 1 << (n), 0, 255, 0, TINYUI_TRANS_IMMEDIATE, SIMON_WINNER_DT }
+PgmLedAnimation(SimonWinner) = {
+  SIMON_WINNER_STEP(0), SIMON_WINNER_STEP(1), SIMON_WINNER_STEP(2), SIMON_WINNER_STEP(3), SIMON_WINNER_STEP(4),
+  SIMON_WINNER_STEP(5), SIMON_WINNER_STEP(6), SIMON_WINNER_STEP(7), SIMON_WINNER_STEP(8), SIMON_WINNER_STEP(9),
+  SIMON_WINNER_STEP(10), SIMON_WINNER_STEP(11), SIMON_WINNER_STEP(12), SIMON_WINNER_STEP(13),
+  { LEDSEQ_PIXELS_ALL, 0, 0, 0, SIMON_WINNER_FRAMES, 0 }
+};
+
 Simon::Simon(void)
 {
   _ui = NULL;
 }
 
-void Simon::setUi(TinyUI *ui, Adafruit_SSD1306 *display)
+void Simon::setUi(TinyUI *ui, LedSequencer *leds)
 {
   _ui = ui;
-  _display = display;
+  _leds = leds;
   _gameData = NULL;
   _ui->seedRandom();
 }
 
-void Simon::start(void)
+void Simon::start(void *state)
 {
-  _gameData = (SimonGameData *) malloc(sizeof(SimonGameData));
-  memset(_gameData, 0, sizeof(SimonGameData));
-  _display->clearDisplay();
-  _display->display();
+  _gameData = (SimonGameData *) state;
   _addSymbol();
   _ui->blingOff();
   _ui->buttonFeedbackOff();
-  _ui->update(TINYUI_GET_DEFAULT);
   _ui->seedRandom();
-  _gameData->tAdvance = millis() + SIMON_ROUND_DT;
+  _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_ROUND_DT);
 }
 
-boolean Simon::play(uint8_t btn)
+uint8_t Simon::tick(void *state, uint8_t btn)
 {
-  long t;
-  if (!_gameData) {
-    start();
+  _gameData = (SimonGameData *) state;
+  if (_gameData->wait) {
+    _gameData->wait--;
   }
-  t = millis();
   if (btn && (_gameData->gameState == SIMON_STATE_PLAY)) {
     if (btn == _gameData->symbol[_gameData->curSymbol]) {
-      _flashSymbol(btn, SIMON_FLASH_FRAMES);
+      _flashSymbol(btn, SimonFlash, LedAnimationLength(SimonFlash));
       _gameData->curSymbol++;
       if (_gameData->curSymbol < _gameData->symbolCount) {
-        _gameData->tAdvance = t + SIMON_PLAY_DT;
+        _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_PLAY_DT);
       } else if (_addSymbol()) {
         _gameData->curSymbol = 0;
         _gameData->gameState = SIMON_STATE_SHOW;
-        _gameData->tAdvance = t + SIMON_ROUND_DT;
+        _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_ROUND_DT);
       } else {
         _gameData->gameState = SIMON_STATE_WINNER;
-        _gameData->tAdvance = t + SIMON_WINNER_PAUSE;
+        _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_WINNER_PAUSE);
         _gameData->flashCount = 0;
         _gameData->curSymbol = 0;
       }
     } else {
       _gameData->gameState = SIMON_STATE_WRONG;
-      _flashSymbol(_gameData->symbol[_gameData->curSymbol], SIMON_WRONG_FRAMES);
-      _gameData->tAdvance = t + SIMON_WRONG_DT;
+      _flashSymbol(_gameData->symbol[_gameData->curSymbol], SimonWrong, LedAnimationLength(SimonWrong));
+      _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_WRONG_DT);
       _gameData->flashCount = 0;
     }
-  } else if (t >= _gameData->tAdvance) {
+  } else if (!_gameData->wait) {
     switch (_gameData->gameState) {
     case SIMON_STATE_SHOW:
       if (_gameData->curSymbol < _gameData->symbolCount) {
-        _flashSymbol(_gameData->symbol[_gameData->curSymbol], SIMON_FLASH_FRAMES);
+        _flashSymbol(_gameData->symbol[_gameData->curSymbol], SimonFlash, LedAnimationLength(SimonFlash));
         _gameData->curSymbol++;
-        _gameData->tAdvance = t + SIMON_FLASH_DT;
+        _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_FLASH_DT);
       } else {
         _gameData->curSymbol = 0;
         _gameData->gameState = SIMON_STATE_PLAY;
-        _gameData->tAdvance = t + SIMON_PLAY_DT;
+        _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_PLAY_DT);
       }
       break;
     case SIMON_STATE_PLAY:
       _gameData->gameState = SIMON_STATE_WRONG;
-      _flashSymbol(_gameData->symbol[_gameData->curSymbol], SIMON_WRONG_FRAMES);
-      _gameData->tAdvance = t + SIMON_WRONG_DT;
+      _flashSymbol(_gameData->symbol[_gameData->curSymbol], SimonWrong, LedAnimationLength(SimonWrong));
+      _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_WRONG_DT);
       _gameData->flashCount = 0;
       break;
     case SIMON_STATE_WRONG:
       if (++_gameData->flashCount < SIMON_WRONG_COUNT) {
-        _flashSymbol(_gameData->symbol[_gameData->curSymbol], SIMON_WRONG_FRAMES);
-        _gameData->tAdvance = t + SIMON_WRONG_DT;
+        _flashSymbol(_gameData->symbol[_gameData->curSymbol], SimonWrong, LedAnimationLength(SimonWrong));
+        _gameData->wait = GAME_MILLIS_TO_TICKS(SIMON_WRONG_DT);
       } else {
-        return false;
+        return 0;
       }
       break;
     case SIMON_STATE_WINNER:
-      _ui->setPixel(_gameData->curSymbol, 255);
-      _ui->update(TINYUI_GET_DEFAULT);
-      _ui->setPixelTransition(_gameData->curSymbol, 0, SIMON_WINNER_FRAMES);
-      if (++_gameData->curSymbol >= TINYUI_LED_COUNT) {
-        _gameData->curSymbol = 0;
-        if (++_gameData->flashCount >= SIMON_WINNER_CYCLES) {
-          return false;
-        }
+      if (!_gameData->flashCount) {
+        _leds->play(SimonWinner, LedAnimationLength(SimonWinner), 0, SIMON_WINNER_CYCLES);
+        _gameData->flashCount = 1;
+      } else if (!_leds->isPlaying()) {
+        return 0;
       }
-      _gameData->tAdvance = t + SIMON_WINNER_DT;
       break;
     default:
       _gameData->gameState = SIMON_STATE_SHOW;
       break;
     }
   }
-  return true;
+  return GAME_RUNNING;
 }
 
-void Simon::release(void)
+// Simon is all LEDs; the screen stays blank
+void Simon::render(void *state, Adafruit_SSD1306 *display)
 {
-  if (_gameData) {
-    free(_gameData);
-    _gameData = NULL;
-  }
+}
+
+void Simon::stop(void *state)
+{
+  _leds->stop();
+  _gameData = NULL;
 }
 
 boolean Simon::isWinner(void)
@@ -125,51 +148,23 @@ boolean Simon::isWinner(void)
   return _gameData && (_gameData->gameState == SIMON_STATE_WINNER);
 }
 
-void Simon::_flashSymbol(uint8_t sym, uint8_t frames)
+void Simon::_flashSymbol(uint8_t sym, const LedKeyframe *animation, uint8_t count)
 {
+  uint16_t pixels;
   if (sym == TINYUI_BUTTON_SELECT) {
-    _ui->setPixel(0, 255);
-    _ui->setPixel(3, 255);
-    _ui->setPixel(6, 255);
-    _ui->setPixel(9, 255);
-    _ui->update(TINYUI_GET_DEFAULT);
-    _ui->setPixelTransition(0, 0, frames);
-    _ui->setPixelTransition(3, 0, frames);
-    _ui->setPixelTransition(6, 0, frames);
-    _ui->setPixelTransition(9, 0, frames);
+    pixels = SIMON_PIXELS_SELECT;
   } else if (sym == TINYUI_BUTTON_UP) {
-    _ui->setPixel(11, 255);
-    _ui->setPixel(0, 255);
-    _ui->setPixel(1, 255);
-    _ui->update(TINYUI_GET_DEFAULT);
-    _ui->setPixelTransition(11, 0, frames);
-    _ui->setPixelTransition(0, 0, frames);
-    _ui->setPixelTransition(1, 0, frames);
+    pixels = SIMON_PIXELS_UP;
   } else if (sym == TINYUI_BUTTON_RIGHT) {
-    _ui->setPixel(2, 255);
-    _ui->setPixel(3, 255);
-    _ui->setPixel(4, 255);
-    _ui->update(TINYUI_GET_DEFAULT);
-    _ui->setPixelTransition(2, 0, frames);
-    _ui->setPixelTransition(3, 0, frames);
-    _ui->setPixelTransition(4, 0, frames);
+    pixels = SIMON_PIXELS_RIGHT;
   } else if (sym == TINYUI_BUTTON_DOWN) {
-    _ui->setPixel(5, 255);
-    _ui->setPixel(6, 255);
-    _ui->setPixel(7, 255);
-    _ui->update(TINYUI_GET_DEFAULT);
-    _ui->setPixelTransition(5, 0, frames);
-    _ui->setPixelTransition(6, 0, frames);
-    _ui->setPixelTransition(7, 0, frames);
+    pixels = SIMON_PIXELS_DOWN;
   } else if (sym == TINYUI_BUTTON_LEFT) {
-    _ui->setPixel(8, 255);
-    _ui->setPixel(9, 255);
-    _ui->setPixel(10, 255);
-    _ui->update(TINYUI_GET_DEFAULT);
-    _ui->setPixelTransition(8, 0, frames);
-    _ui->setPixelTransition(9, 0, frames);
-    _ui->setPixelTransition(10, 0, frames);
+    pixels = SIMON_PIXELS_LEFT;
+  } else {
+    return;
   }
+  _leds->play(animation, count, pixels);
 }
 
 boolean Simon::_addSymbol(void)
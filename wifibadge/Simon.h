@@ -10,6 +10,8 @@
 #include <Adafruit_SSD1306.h>
 #include "Arduino.h"
 #include "TinyUI.h"
+#include "LedSequencer.h"
+#include "GameRuntime.h"
 
 #define SIMON_MAX_ROUNDS        10
 #define SIMON_FLASH_FRAMES      16
@@ -29,29 +31,32 @@
 #define SIMON_STATE_WRONG        2
 #define SIMON_STATE_WINNER       3
 
+// times above are in milliseconds; the game counts them in GAME_TICK_MILLIS steps
 typedef struct {
-  long tAdvance;
+  uint16_t wait;                // steps until the game moves on by itself
   uint8_t gameState;
   uint8_t symbolCount;
   uint8_t curSymbol;
   uint8_t flashCount;
   uint8_t symbol[SIMON_MAX_ROUNDS];
 } SimonGameData;
+GAME_STATE_CHECK(SimonGameData);
 
-class Simon
+class Simon : public Game
 {
   public:
     Simon(void);
-    void setUi(TinyUI *ui, Adafruit_SSD1306 *display);
-    void start(void);
-    boolean play(uint8_t btn);
-    void release(void);
+    void setUi(TinyUI *ui, LedSequencer *leds);
+    void start(void *state);
+    uint8_t tick(void *state, uint8_t btn);
+    void render(void *state, Adafruit_SSD1306 *display);
+    void stop(void *state);
     boolean isWinner(void);
   private:
     TinyUI *_ui;
-    Adafruit_SSD1306 *_display;
+    LedSequencer *_leds;
     SimonGameData *_gameData;
-    void _flashSymbol(uint8_t sym, uint8_t frames);
+    void _flashSymbol(uint8_t sym, const LedKeyframe *animation, uint8_t count);
     boolean _addSymbol(void);
 };
 
@@ -0,0 +1,172 @@
+/*
+  TaskScheduler.cpp - Library for running the sketch's work as prioritized run-to-completion tasks, with deadline and timing counters.
+  Released under the MIT License.
+*/
+
+#include "Arduino.h"
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(void)
+{
+  _count = 0;
+  _eventMask = 0;
+  _triggerMask = 0;
+  resetStats();
+}
+
+uint8_t TaskScheduler::_add(TaskFunction run, uint8_t priority, uint16_t period, uint16_t deadline)
+{
+  uint8_t n, i;
+
+  if (_count >= TASK_MAX)
+  {
+    return TASK_NONE;
+  }
+  n = _count++;
+  _run[n] = run;
+  _priority[n] = priority;
+  _period[n] = period;
+  _deadline[n] = deadline;
+  _due[n] = millis();
+  _last[n] = _due[n] - period;
+
+  // Keep _order sorted by priority (tasks with the same priority run in the order they were added)
+  for (i = n; (i > 0) && (_priority[_order[i - 1]] > priority); i--)
+  {
+    _order[i] = _order[i - 1];
+  }
+  _order[i] = n;
+  return n;
+}
+
+uint8_t TaskScheduler::addPeriodic(TaskFunction run, uint8_t priority, uint16_t period, uint16_t deadline)
+{
+  return _add(run, priority, period, deadline);
+}
+
+uint8_t TaskScheduler::addEvent(TaskFunction run, uint8_t priority, uint16_t interval, uint16_t deadline)
+{
+  uint8_t n;
+
+  n = _add(run, priority, interval, deadline);
+  if (n != TASK_NONE)
+  {
+    _eventMask |= 1 << n;
+  }
+  return n;
+}
+
+void TaskScheduler::trigger(uint8_t task)
+{
+  long t;
+
+  if (task >= _count)
+  {
+    return;
+  }
+  t = millis();
+  if (_eventMask & (1 << task))
+  {
+    if (!(_triggerMask & (1 << task)))
+    {
+      // Due now, or once the minimum interval since the last run is up
+      _triggerMask |= 1 << task;
+      _due[task] = ((long) (_last[task] + _period[task] - t) > 0) ? _last[task] + _period[task] : t;
+    }
+  }
+  else if ((long) (_due[task] - t) > 0)
+  {
+    _due[task] = t;
+  }
+}
+
+void TaskScheduler::setPeriod(uint8_t task, uint16_t period)
+{
+  long t;
+
+  if ((task >= _count) || (period == _period[task]))
+  {
+    return;
+  }
+  _period[task] = period;
+  t = millis();
+  if (!(_eventMask & (1 << task)) && ((long) (_due[task] - (t + period)) > 0))
+  {
+    _due[task] = t + period;
+  }
+}
+
+boolean TaskScheduler::run(long t)
+{
+  uint8_t i, n;
+  uint32_t us;
+  uint16_t clipped;
+  long late;
+  TaskStats *s;
+
+  for (i = 0; i < _count; i++)
+  {
+    n = _order[i];
+    if (((_eventMask & (1 << n)) && !(_triggerMask & (1 << n))) || ((long) (t - _due[n]) < 0))
+    {
+      continue;
+    }
+    us = micros();
+    if (!_run[n](t))
+    {
+      continue;   // blocked; let a less urgent task have a go
+    }
+    us = micros() - us;
+    clipped = (us < 0xffff) ? us : 0xffff;   // (the 16 bit figures stick at 0xffff for runs of 65.5ms or more; the total has room)
+
+    // Account for the run, then work out when the task is next due
+    s = _stats + n;
+    late = t - _due[n];
+    if (late > _deadline[n])
+    {
+      s->misses++;
+    }
+    if (late > s->maxLateness)
+    {
+      s->maxLateness = (late < 0xffff) ? late : 0xffff;
+    }
+    s->runs++;
+    s->lastMicros = clipped;
+    s->totalMicros += us;
+    if (clipped > s->maxMicros)
+    {
+      s->maxMicros = clipped;
+    }
+    _last[n] = t;
+    if (_eventMask & (1 << n))
+    {
+      _triggerMask &= ~(1 << n);
+    }
+    else
+    {
+      // Stay on the period's beat, unless the task has fallen a whole period behind (those runs are skipped, and show up as misses)
+      _due[n] += _period[n];
+      if ((long) (t - _due[n]) >= 0)
+      {
+        _due[n] = t + _period[n];
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+uint8_t TaskScheduler::getTaskCount(void)
+{
+  return _count;
+}
+
+const TaskStats *TaskScheduler::getStats(uint8_t task)
+{
+  return (task < _count) ? _stats + task : NULL;
+}
+
+void TaskScheduler::resetStats(void)
+{
+  memset(_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,55 @@
+/*
+  TaskScheduler.h - Library for running the sketch's work as prioritized run-to-completion tasks, with deadline and timing counters.
+  Released under the MIT License.
+*/
+
+#ifndef TaskScheduler_h
+#define TaskScheduler_h
+
+#include "Arduino.h"
+
+#define TASK_MAX                  8                   // most tasks that can be added
+#define TASK_NONE                 0xff                // returned by add...() when there is no room for another task
+
+// A task does one short piece of work and returns true, or returns false if it can't run yet (say, because the SPI bus
+// is busy); it stays ready and is tried again on the next run(), after the other ready tasks have had a chance.
+typedef boolean (*TaskFunction)(long t);
+
+// timing of one task
+typedef struct {
+  uint32_t runs;                                      // number of times the task has run
+  uint16_t misses;                                    // number of runs that started more than the task's deadline after it was due
+  uint16_t maxLateness;                               // longest time from due to start, in milliseconds
+  uint16_t lastMicros;                                // duration of the last run (0xffff for 65535us or more)
+  uint16_t maxMicros;                                 // duration of the longest run (0xffff for 65535us or more)
+  uint32_t totalMicros;                               // time spent in all runs (divide by runs for the average)
+} TaskStats;
+
+class TaskScheduler
+{
+  public:
+    TaskScheduler(void);
+    uint8_t addPeriodic(TaskFunction run, uint8_t priority, uint16_t period, uint16_t deadline);   // run every period milliseconds (0 for every run()); returns the task number
+    uint8_t addEvent(TaskFunction run, uint8_t priority, uint16_t interval, uint16_t deadline);    // run once each time trigger() is called, at most once every interval milliseconds; returns the task number
+    void trigger(uint8_t task);                             // make an event task ready, or run a periodic task now rather than when it is next due
+    void setPeriod(uint8_t task, uint16_t period);          // change a periodic task's period (or an event task's interval); a shorter period takes effect right away
+    boolean run(long t);                                    // run the most urgent ready task (priority 0 first); returns false if no task ran
+    uint8_t getTaskCount(void);
+    const TaskStats *getStats(uint8_t task);
+    void resetStats(void);
+  private:
+    TaskFunction _run[TASK_MAX];
+    uint8_t _priority[TASK_MAX];
+    uint16_t _period[TASK_MAX];                             // period of a periodic task, or minimum interval of an event task
+    uint16_t _deadline[TASK_MAX];
+    long _due[TASK_MAX];                                    // millis() time the task is next due (event tasks: only while triggered)
+    long _last[TASK_MAX];                                   // millis() time the task last ran
+    uint8_t _order[TASK_MAX];                               // task numbers, most urgent first
+    uint8_t _count;
+    uint8_t _eventMask;                                     // bit n is set for event tasks
+    uint8_t _triggerMask;                                   // bit n is set for event tasks that have been triggered and not run yet
+    TaskStats _stats[TASK_MAX];
+    uint8_t _add(TaskFunction run, uint8_t priority, uint16_t period, uint16_t deadline);
+};
+
+#endif
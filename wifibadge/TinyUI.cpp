@@ -11,6 +11,10 @@
 #define SPI_PAYLOAD_LENGTH    15        // number of bytes that follow an opcode
 #define SPI_MAX_RX_TIMEOUT    96        // maximum number of bytes to wait for requested data
 
+// Stops the compiler moving memory accesses across it; the buffers the SPI interrupt reads and fills (_btn, _capAvg, _nvmBuf,
+// the packets being sent, ...) are not volatile, so this is put wherever a background update is handed to or back from it
+#define SPI_BARRIER()         __asm__ __volatile__ ("" ::: "memory")
+
 #define SPI_OP_DIM            0x6c      // set dimming data
 #define SPI_OP_PULSE          0x69      // set pulse data
 #define SPI_OP_TRANSITION     0x66      // set transition data for remainder of SPI transaction
@@ -45,7 +49,9 @@
 #define NVM_OP_ERROR          0xf0      // error performing NVM operation
 #define NVM_LEN_MASK          0x0f      // NVM length bitmask
 
-#define NVM_BUFFER_SIZE       12        // maximum number of bytes in NVM operation buffer
+#define NVM_BUFFER_SIZE       TINYUI_NVM_BUFFER_SIZE   // maximum number of bytes in NVM operation buffer
+
+#define LED_MASK_ALL          ((1 << TINYUI_LED_COUNT) - 1)   // per-LED bitmask with every LED set
 
 #define BLING_MODE_NONE       0x00      // no bling mode
 #define BLING_MODE_SPIN       0x01      // spinner with 1, 2, 3, or 4 lights
@@ -58,20 +64,65 @@
 
 #define DEBOUNCE_MILLIS       200       // minimum number of milliseconds between recognized button presses
 #define BUTTON_HASH_IV        0         // IV to use for getButtonHash
-#define CAPSENSE_THRESHOLD_SH 6         // number of bits to shift when averaging in new capacitive touch threshold data
 
-SPISettings TINYUI_SPISettings(250000, MSBFIRST, SPI_MODE0);   // should be able to communicate at 1MHz? Arduino SPI library doesn't seem to obey this exactly, so tell it much slower
-
-TinyUI::TinyUI(int csPin, int echPin)
+// Capacitive touch filtering (used when the ATTINY firmware doesn't debounce): a touch pulls a button's reading down from its baseline,
+// and a press is detected once it is down by more than the press threshold, which is a share of the baseline or a multiple of the
+// measured noise, whichever is bigger. It is released once the reading comes back above the press threshold less a hysteresis, which
+// also grows with the noise. Baselines follow drift while buttons are released (quickly upward, since touches only pull readings down).
+#define CAPSENSE_BASE_FRAC    2         // fraction bits in the baselines
+#define CAPSENSE_NOISE_FRAC   4         // fraction bits in the noise levels
+#define CAPSENSE_NOISE_INIT   (4 << CAPSENSE_NOISE_FRAC)   // noise level to assume until it has been measured
+#define CAPSENSE_NOISE_MAX    0x3ff     // largest change between readings counted as noise
+#define CAPSENSE_RISE_SH      2         // number of bits to shift when averaging in a reading above the baseline
+#define CAPSENSE_FALL_SH      5         // number of bits to shift when averaging in a reading below the baseline
+#define CAPSENSE_NOISE_SH     4         // number of bits to shift when averaging in the noise level
+#define CAPSENSE_PRESS_SH     3         // the press threshold is at least the baseline >> this (1/8; the old fixed threshold was 1/4)
+#define CAPSENSE_PRESS_NOISE  8         // ...and at least this many times the noise level
+#define CAPSENSE_HYST_SH      2         // the hysteresis is at least the press threshold >> this...
+#define CAPSENSE_HYST_NOISE   4         // ...and at least this many times the noise level, but no more than half the press threshold
+#define CAPSENSE_ONSET_NOISE  3         // a reading this many times the noise level below the baseline starts the latency measurement
+#define CAPSENSE_GLITCH_MILLIS 30       // presses shorter than this are counted as glitches
+#define CAPSENSE_STUCK_MILLIS 30000     // a button pressed this long is taken to be stuck (say, by a damp finger or a big drift) and its baseline is reset
+
+// SPI clock rates to try, slowest first; 250kHz is known to work with every board, and calibrateSpiClock() finds out how much faster this one goes
+static const PROGMEM uint32_t spiClocks[] = { 250000, 500000, 1000000, 2000000 };
+#define SPI_CLOCK_COUNT       (sizeof(spiClocks) / sizeof(spiClocks[0]))
+#define SPI_CALIBRATION_ADDR  0x0000    // FLASH address read to check the link during calibration (the ATTINY's vector table never changes)
+#define SPI_CALIBRATION_TRIES 8         // number of reads that must match at a clock rate for it to pass calibration
+#define SPI_ERROR_LIMIT       3         // number of transactions in a row with framing errors before the clock rate is dropped
+
+// ATTINY88 firmware images this code knows, by the FNV-1a hash of the whole FLASH, ended by a hash of 0. An image not listed is
+// taken to be the original firmware, with the packet parsing bug and press counts that need refiltering. The original firmware
+// has none of the features, so it needs no entry; firmware that fixes either bug gets one here when it ships (the 'u' serial
+// command prints the hash begin() took, for reading it off a badge).
+typedef struct {
+  uint32_t hash;
+  uint8_t features;                     // TINYUI_FIRMWARE_...
+} _TinyUIFirmware;
+static const PROGMEM _TinyUIFirmware firmwares[] = {
+  { 0, 0 }
+};
+#define FIRMWARE_HASH_CHUNK   64        // bytes of FLASH read at a time while hashing it
+#define FIRMWARE_HASH_IV      2166136261UL   // FNV-1a offset basis...
+#define FIRMWARE_HASH_PRIME   16777619UL     // ...and prime
+
+TinyUI::TinyUI(void)
 {
-  uint8_t i;
-
-  _csPin = csPin;
-  _echPin = echPin;
-  digitalWrite(_csPin, HIGH);
-  pinMode(_csPin, OUTPUT);
-  digitalWrite(_echPin, HIGH);
-  pinMode(_echPin, OUTPUT);
+  _setSpiClock(0);
+  _fwHash = 0;
+  _fwFeatures = 0;
+  _asyncBusy = false;
+  _asyncDone = false;
+  _rxDrop = false;
+  _replay = false;
+  _packetTap = NULL;
+  memset(&_stats, 0, sizeof(_stats));
+  // (high before they become outputs, so neither glitches low)
+  TINYUI_CS_PORT |= _BV(TINYUI_CS_BIT);
+  TINYUI_CS_DDR |= _BV(TINYUI_CS_BIT);
+  TINYUI_ECH_PORT |= _BV(TINYUI_ECH_BIT);
+  TINYUI_ECH_DDR |= _BV(TINYUI_ECH_BIT);
+  setButtonRepeat(TINYUI_LONG_PRESS_MILLIS, TINYUI_REPEAT_MILLIS, TINYUI_REPEAT_MIN_MILLIS, TINYUI_REPEAT_ACCEL_SH);
 }
 
 boolean TinyUI::isRefilterCapSense(void)
@@ -90,10 +141,17 @@ void TinyUI::begin(void)
     _btn[i] = 0;
     _press[i] = 0;
     _capAvg[i] = 0x3fff;
-    _capThrPress[i] = 0;
-    _capThrRelease[i] = 0;
   }
+  _capReady = false;
+  _touchFresh = false;
+  _touchTime = millis();
+  _capOnsetMask = 0;
   _btnMask = 0;
+  _touchMask = 0;
+  _downMask = 0;
+  _longMask = 0;
+  _eventHead = 0;
+  _eventCount = 0;
   _navHistory = 0;
   for (i = 0; i < TINYUI_POWER_COUNT; i++) {
     _pwr[i] = 0;
@@ -108,14 +166,16 @@ void TinyUI::begin(void)
     _bling[i] = 0;
   }
   _isExtraChannels = false;
-  _dimDirty = true;
-  _pulseDirty = true;
+  _dimDirty = LED_MASK_ALL;
+  _pulseDirty = LED_MASK_ALL;
+  _transMask = 0;
   _lenDirty = true;
   _blingDirty = true;
+
   update(TINYUI_GET_BUTTONS | TINYUI_GET_POWER);
-  _refilterCapSense = true;
-  //FIXME: for next code version, check ATTINY88 firmware version and set _refilterCapSense accordingly
-  //       (this is not needed until hardware is released with a newer version of the ATTINY88 firmware)
+  calibrateSpiClock();
+  _probeFirmware();
+  _refilterCapSense = !(_fwFeatures & TINYUI_FIRMWARE_DEBOUNCE);
   if (_refilterCapSense)
   {
     for (i = 0; i < TINYUI_BUTTON_COUNT; i++)
@@ -130,13 +190,17 @@ void TinyUI::begin(void)
       _press[i] = _btn[i];
     }
   }
+  // Forget anything the updates above made of button data from before reset
   _pressMask = 0;
   _pressAck = 0;
+  _downMask = 0;
+  _eventCount = 0;
+  _navHistory = 0;
 }
 
 void TinyUI::enableExtraChannels(void)
 {
-  digitalWrite(_echPin, LOW);
+  TINYUI_ECH_PORT &= ~_BV(TINYUI_ECH_BIT);
   TXLED1;
   RXLED1;
   _isExtraChannels = true;
@@ -144,65 +208,59 @@ void TinyUI::enableExtraChannels(void)
 
 void TinyUI::disableExtraChannels(void)
 {
-  digitalWrite(_echPin, HIGH);
+  TINYUI_ECH_PORT |= _BV(TINYUI_ECH_BIT);
   _isExtraChannels = false;
 }
 
-void TinyUI::setPixel(uint8_t n, uint8_t v)
+void TinyUI::_setLed(uint8_t *buf, uint16_t *dirty, uint8_t n, uint8_t v, uint8_t frames)
 {
+  uint16_t bit;
+
   if (n < TINYUI_LED_COUNT)
   {
-    _dim[n] = v;
-    _trans[n] = TINYUI_TRANS_IMMEDIATE;
-    _dimDirty = true;
+    // Skip the change if the LED is already showing this value: either the same change has already been made,
+    // or the LED is settled at this value with nothing pending, so no transition to it would make a difference
+    bit = 1 << n;
+    if ((buf[n] == v) && ((_trans[n] == frames) || !((_transMask | _dimDirty | _pulseDirty) & bit)))
+    {
+      _stats.ledNoops++;
+      return;
+    }
+    buf[n] = v;
+    _trans[n] = frames;
+    *dirty |= bit;
   }
 }
 
+void TinyUI::setPixel(uint8_t n, uint8_t v)
+{
+  _setLed(_dim, &_dimDirty, n, v, TINYUI_TRANS_IMMEDIATE);
+}
+
 void TinyUI::setPixelTransition(uint8_t n, uint8_t v, uint8_t frames)
 {
-  if (n < TINYUI_LED_COUNT)
-  {
-    _dim[n] = v;
-    _trans[n] = frames;
-    _dimDirty = true;
-  }
+  _setLed(_dim, &_dimDirty, n, v, frames);
 }
 
 void TinyUI::setPulse(uint8_t n, uint8_t v)
 {
-  if (n < TINYUI_LED_COUNT)
-  {
-    _pulse[n] = v;
-    _trans[n] = TINYUI_TRANS_IMMEDIATE;
-    _pulseDirty = true;
-  }
+  _setLed(_pulse, &_pulseDirty, n, v, TINYUI_TRANS_IMMEDIATE);
 }
 
 void TinyUI::setPulseTransition(uint8_t n, uint8_t v, uint8_t frames)
 {
-  if (n < TINYUI_LED_COUNT)
-  {
-    _pulse[n] = v;
-    _trans[n] = frames;
-    _pulseDirty = true;
-  }
+  _setLed(_pulse, &_pulseDirty, n, v, frames);
 }
 
 void TinyUI::setPixelPulseTransition(uint8_t n, uint8_t dim, uint8_t pulse, uint8_t frames)
 {
-  if (n < TINYUI_LED_COUNT)
-  {
-    _dim[n] = dim;
-    _pulse[n] = pulse;
-    _trans[n] = frames;
-    _dimDirty = true;
-    _pulseDirty = true;
-  }
+  _setLed(_dim, &_dimDirty, n, dim, frames);
+  _setLed(_pulse, &_pulseDirty, n, pulse, frames);
 }
 
 void TinyUI::setPulseLength(uint8_t n, uint8_t v)
 {
-  if (n < TINYUI_LED_COUNT)
+  if ((n < TINYUI_LED_COUNT) && (_len[n] != v))
   {
     _len[n] = v;
     _lenDirty = true;
@@ -276,9 +334,33 @@ void TinyUI::blingClock(uint8_t hours, uint8_t minutes, uint8_t seconds)
 void TinyUI::_rxBegin(void)
 {
   _rxOpcode = 0;
+  _rxErrors = 0;
+}
+
+// Returns true if b is an opcode for either direction
+static inline boolean isOpcode(uint8_t b)
+{
+  switch (b)
+  {
+    case SPI_OP_DIM:
+    case SPI_OP_PULSE:
+    case SPI_OP_TRANSITION:
+    case SPI_OP_PULSE_CMP:
+    case SPI_OP_BLING_MODE:
+    case SPI_OP_NAVHASH_IVS:
+    case SPI_OP_NVM_REQUEST:
+    case SPI_OP_RESERVED_33:
+    case SPI_OP_ADC_DATA:
+    case SPI_OP_RESERVED_C9:
+    case SPI_OP_NAVHASH_OUT:
+    case SPI_OP_NVM_RESULT:
+      return true;
+  }
+  return (b & SPI_OP_TOUCH_MASK) == SPI_OP_TOUCH;
 }
 
-void TinyUI::_rxByte(uint8_t b)
+// (always inlined so the transfer loops in update() and the SPI interrupt parse each byte without a call)
+inline __attribute__((always_inline)) void TinyUI::_rxByte(uint8_t b)
 {
   uint8_t i;
 
@@ -287,15 +369,22 @@ void TinyUI::_rxByte(uint8_t b)
     _rxBuf[_rxPtr++] = b;
     if (_rxPtr >= SPI_PAYLOAD_LENGTH)
     {
-      if (_rxOpcode == SPI_OP_TOUCH)
+      if (_rxDrop)
+      {
+        // dropped while replaying, but it still counts as received so the transaction ends as usual
+        _rxFlags &= (_rxOpcode == SPI_OP_TOUCH) ? ~TINYUI_GET_BUTTONS : ~TINYUI_GET_POWER;
+      }
+      else if (_rxOpcode == SPI_OP_TOUCH)
       {
         _rxFlags &= ~TINYUI_GET_BUTTONS;
+        _touchTime = millis();   // (the time the buttons were sensed, as near as can be told; events are stamped with it)
         if (_refilterCapSense)
         {
           for (i = 0; i < TINYUI_BUTTON_COUNT; i++)
           {
             _capAvg[i] = ((uint16_t *)(_rxBuf + TINYUI_BUTTON_COUNT))[i];
           }
+          _touchFresh = true;
         }
         else
         {
@@ -312,6 +401,7 @@ void TinyUI::_rxByte(uint8_t b)
         {
           _pwr[i] = ((uint16_t *)_rxBuf)[i];
         }
+        _stats.powerPackets++;
       }
       else if (_rxOpcode == SPI_OP_NAVHASH_OUT)
       {
@@ -329,23 +419,40 @@ void TinyUI::_rxByte(uint8_t b)
           _nvmBuf[i] = _rxBuf[i];
         }
       }
+      if (_packetTap && !_rxDrop && ((_rxOpcode == SPI_OP_TOUCH) || (_rxOpcode == SPI_OP_ADC_DATA)))
+      {
+        _packetTap(_rxOp, _rxBuf);
+      }
       _rxOpcode = 0;
     }
   }
   else
   {
+    _rxOp = b;
+    _rxDrop = false;
     if ((b & SPI_OP_TOUCH_MASK) == SPI_OP_TOUCH)
     {
       _rxOpcode = SPI_OP_TOUCH;
-      if (!_refilterCapSense)
+      _rxDrop = _replay;
+      if (!_refilterCapSense && !_rxDrop)
       {
+        _touchMask = b & ~SPI_OP_TOUCH_MASK;
         _pressMask &= ~_pressAck;
-        _pressMask |= b & ~SPI_OP_TOUCH_MASK;
+        _pressMask |= _touchMask;
       }
     }
     else if ((b == SPI_OP_ADC_DATA) || (b == SPI_OP_RESERVED_C9) || (b == SPI_OP_NAVHASH_OUT) || (b == SPI_OP_NVM_RESULT))
     {
       _rxOpcode = b;
+      _rxDrop = _replay && (b == SPI_OP_ADC_DATA);
+    }
+    else if (b && !isOpcode(b))
+    {
+      // Between packets the ATTINY is taken to send 0x00 (or an opcode, which the original firmware may echo back from the
+      // packets it is receiving); anything else means the link has lost framing. This has not been checked against traffic
+      // from a real board, so the byte is kept for getStats() to show what turns up.
+      _rxErrors++;
+      _stats.lastFramingByte = b;
     }
     _rxPtr = 0;
   }
@@ -353,27 +460,60 @@ void TinyUI::_rxByte(uint8_t b)
 
 void TinyUI::_txPacket(uint8_t op, uint8_t len, const void *ptr)
 {
-  uint8_t i;
-  const uint8_t *p = (const uint8_t *) ptr;
-
-  _rxByte(SPI.transfer(op));
-  for (i = len; i; i--)
+  _TinyUITxPacket *p;
+  if (_txCount < TINYUI_TX_QUEUE_LENGTH)
   {
-    _rxByte(SPI.transfer(*p++));
+    p = _txQueue + _txCount++;
+    p->op = op;
+    p->len = len;
+    p->ptr = (const uint8_t *) ptr;
   }
-  if (len < SPI_PAYLOAD_LENGTH)
+}
+
+boolean TinyUI::_txNext(uint8_t *b)
+{
+  _TinyUITxPacket *p;
+
+  // Send each queued packet: the opcode, the payload padded out to SPI_PAYLOAD_LENGTH, and one extra byte (unless the firmware
+  // is known not to need it)
+  if (_txIndex < _txCount)
   {
-    for (i = SPI_PAYLOAD_LENGTH - len; i; i--)
+    p = _txQueue + _txIndex;
+    if (_txPos == 0)
     {
-      _rxByte(SPI.transfer(0x00));
+      *b = p->op;
     }
+    else if (_txPos <= p->len)
+    {
+      *b = p->ptr[_txPos - 1];
+    }
+    else
+    {
+      *b = 0x00;   // padding, plus the extra byte the bug in the original ATTINY firmware requires between packets to parse correctly
+    }
+    if (++_txPos > SPI_PAYLOAD_LENGTH + ((_fwFeatures & TINYUI_FIRMWARE_NO_PAD) ? 0 : 1))
+    {
+      _txPos = 0;
+      _txIndex++;
+    }
+    return true;
   }
-  _rxByte(SPI.transfer(0x00));   // bug in the ATTINY firmware is making it require an extra byte between packets to parse correctly
+
+  // Keep receiving packets until all requested data has been received
+  if (_txTimeout && _rxFlags)
+  {
+    _txTimeout--;
+    *b = 0x00;
+    return true;
+  }
+  return false;
 }
 
-void TinyUI::update(uint8_t flags)
+void TinyUI::_txBegin(uint8_t flags)
 {
   uint8_t i;
+  uint16_t changed, bit;
+  boolean transitions;
 
   // Fix RX and TX LEDs if ATTINY is supposed to be controlling them (Arduino stuff tends to take them back periodically)
   if (_isExtraChannels)
@@ -382,11 +522,10 @@ void TinyUI::update(uint8_t flags)
     RXLED1;
   }
 
-  // Set up the SPI transaction
-  _rxBegin();
-  _rxFlags = flags;
-  digitalWrite(_csPin, LOW);
-  SPI.beginTransaction(TINYUI_SPISettings);
+  _txCount = 0;
+  _txIndex = 0;
+  _txPos = 0;
+  _txTimeout = SPI_MAX_RX_TIMEOUT;
 
   // Start with bling mode data
   if (_blingDirty)
@@ -402,33 +541,57 @@ void TinyUI::update(uint8_t flags)
     _lenDirty = false;
   }
 
-  // If all pixels will be updated, we can skip the transitions packet; else, we need to send it
-  for (i = 0; (i < TINYUI_LED_COUNT) && (_trans[i] == TINYUI_TRANS_IMMEDIATE); i++) ;
-  if (i < TINYUI_LED_COUNT)
+  // Work out the transition for each LED: changed LEDs use the one they were set with, unchanged LEDs that may still be running
+  // a transition are told to ignore the values resent for them, and the rest get their unchanged values resent immediately
+  // (which the ATTINY does anyway without a transitions packet, so the packet is only sent if some LED needs otherwise)
+  changed = _dimDirty | _pulseDirty;
+  if (changed)
   {
-    _txPacket(SPI_OP_TRANSITION, TINYUI_LED_COUNT, _trans);
-    // If a transition has been specified for a pixel, set the transition mask to ignore it in future updates (explicitly setting the pixel value will reset this)
-    for (i = 0; i < TINYUI_LED_COUNT; i++)
+    transitions = false;
+    for (i = 0, bit = 1; i < TINYUI_LED_COUNT; i++, bit <<= 1)
     {
-      if (_trans[i] != TINYUI_TRANS_IMMEDIATE)
+      if (changed & bit)
+      {
+        _txTrans[i] = _trans[i];
+        if (_trans[i] == TINYUI_TRANS_IMMEDIATE)
+        {
+          _transMask &= ~bit;
+        }
+        else
+        {
+          _transMask |= bit;
+        }
+      }
+      else
       {
-        _trans[i] = TINYUI_TRANS_IGNORE;
+        _txTrans[i] = (_transMask & bit) ? TINYUI_TRANS_IGNORE : TINYUI_TRANS_IMMEDIATE;
+      }
+      if (_txTrans[i] != TINYUI_TRANS_IMMEDIATE)
+      {
+        transitions = true;
       }
     }
-  }
-
-  // Send updated dimming values
-  if (_dimDirty)
-  {
-    _txPacket(SPI_OP_DIM, TINYUI_LED_COUNT, _dim);
-    _dimDirty = false;
-  }
+    if (transitions)
+    {
+      _txPacket(SPI_OP_TRANSITION, TINYUI_LED_COUNT, _txTrans);
+      _stats.ledPackets++;
+    }
 
-  // Send updated pulsing values
-  if (_pulseDirty)
-  {
-    _txPacket(SPI_OP_PULSE, TINYUI_LED_COUNT, _pulse);
-    _pulseDirty = false;
+    // Send only the kinds of values that have changed
+    if (_dimDirty)
+    {
+      memcpy(_txDim, _dim, TINYUI_LED_COUNT);
+      _txPacket(SPI_OP_DIM, TINYUI_LED_COUNT, _txDim);
+      _stats.ledPackets++;
+      _dimDirty = 0;
+    }
+    if (_pulseDirty)
+    {
+      memcpy(_txPulse, _pulse, TINYUI_LED_COUNT);
+      _txPacket(SPI_OP_PULSE, TINYUI_LED_COUNT, _txPulse);
+      _stats.ledPackets++;
+      _pulseDirty = 0;
+    }
   }
 
   // Execute a NavHash or NVM operation if one has been requested
@@ -441,15 +604,269 @@ void TinyUI::update(uint8_t flags)
     _txPacket(SPI_OP_NVM_REQUEST, TINYUI_PAYLOAD_LENGTH, _nvmBuf);
   }
 
-  // Keep receiving packets until all requested data has been received
-  for (i = SPI_MAX_RX_TIMEOUT; i && _rxFlags; i--)
-  {
-    _rxByte(SPI.transfer(0x00));
-  }
+  // Set up the SPI transaction
+  _rxBegin();
+  _rxFlags = flags;
+  _stats.updates++;
+  _stats.packets += _txCount;
+  _statStart = micros();
+  TINYUI_CS_PORT &= ~_BV(TINYUI_CS_BIT);
+  SPI.beginTransaction(_spiSettings);
+}
 
+void TinyUI::_txEnd(void)
+{
   // Transaction cleanup
   SPI.endTransaction();
-  digitalWrite(_csPin, HIGH);
+  TINYUI_CS_PORT |= _BV(TINYUI_CS_BIT);
+  _stats.lastMicros = (uint16_t) micros() - _statStart;
+  _stats.totalMicros += _stats.lastMicros;
+
+  // If framing errors keep happening, the clock is too fast for this board; slow down a step
+  if (_rxErrors)
+  {
+    _stats.framingErrors += _rxErrors;
+    if ((++_errorRun >= SPI_ERROR_LIMIT) && _clockIndex)
+    {
+      _setSpiClock(_clockIndex - 1);
+      _stats.clockDrops++;
+    }
+  }
+  else
+  {
+    _errorRun = 0;
+  }
+}
+
+void TinyUI::_txRun(void)
+{
+  uint8_t b;
+
+  while (_txNext(&b))
+  {
+    // Work the SPI registers directly rather than through SPI.transfer
+    SPDR = b;
+    _stats.bytes++;
+    while (!(SPSR & _BV(SPIF))) ;
+    _rxByte(SPDR);
+  }
+}
+
+void TinyUI::update(uint8_t flags)
+{
+  finish();
+  _txBegin(flags);
+  _txRun();
+  _txEnd();
+
+  // Turn any new button data into events (and send any long press or repeat events that are due)
+  _scanButtons();
+}
+
+static TinyUI *_asyncUi = NULL;   // TinyUI running a background update, for the SPI interrupt
+
+boolean TinyUI::updateAsync(uint8_t flags)
+{
+  uint8_t b;
+
+  if (!poll())
+  {
+    return false;
+  }
+  _txBegin(flags);
+  if (!_txNext(&b))
+  {
+    _txEnd();
+    return true;
+  }
+  _asyncUi = this;
+  SPI_BARRIER();   // everything _txBegin() set up is in memory before the interrupt can use it
+  _asyncBusy = true;
+  SPCR |= _BV(SPIE);
+  SPDR = b;
+  _stats.bytes++;   // the rest of the bytes are sent from the interrupt as each one completes
+  return true;
+}
+
+void TinyUI::_spiInterrupt(void)
+{
+  uint8_t b;
+
+  _rxByte(SPDR);
+  if (_txNext(&b))
+  {
+    SPDR = b;
+    _stats.bytes++;
+  }
+  else
+  {
+    SPCR &= ~_BV(SPIE);
+    _txEnd();
+    _asyncBusy = false;
+    _asyncDone = true;
+  }
+}
+
+ISR(SPI_STC_vect)
+{
+  if (_asyncUi)
+  {
+    _asyncUi->_spiInterrupt();
+  }
+}
+
+boolean TinyUI::poll(void)
+{
+  if (_asyncBusy)
+  {
+    return false;
+  }
+  SPI_BARRIER();   // nothing the interrupt filled in is read before it is finished
+  if (_asyncDone)
+  {
+    _asyncDone = false;
+    _scanButtons();
+  }
+  return true;
+}
+
+void TinyUI::finish(void)
+{
+  while (!poll()) ;
+}
+
+const TinyUIStats *TinyUI::getStats(void)
+{
+  return &_stats;
+}
+
+void TinyUI::setPacketTap(TinyUIPacketTap tap)
+{
+  _packetTap = tap;
+}
+
+void TinyUI::setReplay(boolean replay)
+{
+  _replay = replay;
+}
+
+boolean TinyUI::injectPacket(const uint8_t *packet)
+{
+  uint8_t i;
+  boolean replay;
+
+  if (_asyncBusy)
+  {
+    return false;   // the SPI interrupt is using the receive state
+  }
+  replay = _replay;
+  _replay = false;
+  _rxBegin();
+  for (i = 0; i < TINYUI_PACKET_LENGTH; i++)
+  {
+    _rxByte(packet[i]);
+  }
+  _replay = replay;
+  _asyncDone = true;   // poll() turns the new data into button events as if a background update had just finished
+  return true;
+}
+
+uint32_t TinyUI::getSpiClock(void)
+{
+  return pgm_read_dword(spiClocks + _clockIndex);
+}
+
+uint32_t TinyUI::getFirmwareHash(void)
+{
+  return _fwHash;
+}
+
+uint8_t TinyUI::getFirmwareFeatures(void)
+{
+  return _fwFeatures;
+}
+
+void TinyUI::_probeFirmware(void)
+{
+  uint8_t buf[FIRMWARE_HASH_CHUNK];
+  uint16_t addr;
+  uint8_t i;
+  const _TinyUIFirmware *fw;
+
+  // Nothing the original firmware sends back tells its version (NVM_OP_GET_SIZES only reports the chip's memory sizes), so
+  // hash the whole image through the FLASH read path instead; the packets go out padded until it is known they needn't be
+  _fwFeatures = 0;
+  _fwHash = FIRMWARE_HASH_IV;
+  for (addr = 0; addr < TINYUI_FIRMWARE_SIZE; addr += FIRMWARE_HASH_CHUNK)
+  {
+    if (!readFLASH(addr, FIRMWARE_HASH_CHUNK, buf))
+    {
+      _fwHash = 0;   // (unknown, so today's behaviour)
+      return;
+    }
+    for (i = 0; i < FIRMWARE_HASH_CHUNK; i++)
+    {
+      _fwHash = (_fwHash ^ buf[i]) * FIRMWARE_HASH_PRIME;
+    }
+  }
+  for (fw = firmwares; pgm_read_dword(&fw->hash); fw++)
+  {
+    if (pgm_read_dword(&fw->hash) == _fwHash)
+    {
+      _fwFeatures = pgm_read_byte(&fw->features);
+      break;
+    }
+  }
+}
+
+void TinyUI::_setSpiClock(uint8_t n)
+{
+  _clockIndex = n;
+  _errorRun = 0;
+  _spiSettings = SPISettings(pgm_read_dword(spiClocks + n), MSBFIRST, SPI_MODE0);
+}
+
+boolean TinyUI::_checkLink(uint8_t *ref)
+{
+  uint8_t buf[NVM_BUFFER_SIZE];
+  uint16_t errors;
+
+  // Read a block of FLASH that never changes; the read must complete without framing errors (and match ref, if given)
+  errors = _stats.framingErrors;
+  if (!readFLASH(SPI_CALIBRATION_ADDR, NVM_BUFFER_SIZE, ref ? buf : _calBuf) || (errors != _stats.framingErrors))
+  {
+    return false;
+  }
+  return !ref || !memcmp(buf, ref, NVM_BUFFER_SIZE);
+}
+
+uint32_t TinyUI::calibrateSpiClock(void)
+{
+  uint8_t i, n, best;
+
+  // Get a reference reading at the rate every board can handle
+  _setSpiClock(0);
+  if (!_checkLink(NULL))
+  {
+    return getSpiClock();
+  }
+
+  // Step up the clock until a reading fails or doesn't match
+  best = 0;
+  for (i = 1; i < SPI_CLOCK_COUNT; i++)
+  {
+    _setSpiClock(i);
+    for (n = 0; (n < SPI_CALIBRATION_TRIES) && _checkLink(_calBuf); n++) ;
+    if (n < SPI_CALIBRATION_TRIES)
+    {
+      break;
+    }
+    best = i;
+  }
+
+  // Settle one step below the fastest rate that worked, for margin against temperature and supply changes
+  _setSpiClock(best ? best - 1 : 0);
+  return getSpiClock();
 }
 
 boolean TinyUI::isPressed(uint8_t btn)
@@ -458,57 +875,244 @@ boolean TinyUI::isPressed(uint8_t btn)
   return (_pressMask & btn) ? true : false;
 }
 
-uint8_t TinyUI::getButton(void)
+void TinyUI::_filterCapSense(uint16_t t)
 {
-  uint8_t r, h;
-  uint16_t capTgt;
+  uint8_t h, r;
+  uint16_t x, base, noise, d, press, hyst;
+  int16_t dev, last, band;
+  int32_t diff;
 
-  // Internal capacitive sense filtering
-  if (_refilterCapSense)
+  for (h = 0, r = 0x10; h < TINYUI_BUTTON_COUNT; h++, r >>= 1)
   {
-    for (h = 0, r = 0x10; h < TINYUI_BUTTON_COUNT; h++, r >>= 1)
+    x = _capAvg[h];
+    if (!_capReady)
+    {
+      _capBase[h] = x << CAPSENSE_BASE_FRAC;
+      _capNoise[h] = CAPSENSE_NOISE_INIT;
+      _capLast[h] = x;
+    }
+    base = _capBase[h] >> CAPSENSE_BASE_FRAC;
+    noise = _capNoise[h] >> CAPSENSE_NOISE_FRAC;
+    dev = base - x;   // how far a touch has pulled the reading down
+
+    // Thresholds from the baseline and the noise
+    press = base >> CAPSENSE_PRESS_SH;
+    if (press < noise * CAPSENSE_PRESS_NOISE)
+    {
+      press = noise * CAPSENSE_PRESS_NOISE;
+    }
+    hyst = press >> CAPSENSE_HYST_SH;
+    if (hyst < noise * CAPSENSE_HYST_NOISE)
+    {
+      hyst = noise * CAPSENSE_HYST_NOISE;
+    }
+    if (hyst > (press >> 1))
+    {
+      hyst = press >> 1;
+    }
+
+    if (_btnMask & r)
     {
-      if (_capAvg[h] < _capThrPress[h])
+      if (dev < (int16_t) (press - hyst))
       {
-        // Lower than the press threshold means the button has been pressed; see if that means it has changed state
-        if ((_btnMask & r) == 0)
+        // Released
+        _btnMask &= ~r;
+        if ((uint16_t) (t - _capTime[h]) < CAPSENSE_GLITCH_MILLIS)
         {
-          _btnMask |= r;
-          _btn[h]++;
+          _stats.touchGlitches++;
         }
       }
-      else if (_capAvg[h] > _capThrRelease[h])
+      else if ((uint16_t) (t - _capTime[h]) >= CAPSENSE_STUCK_MILLIS)
       {
-        // Higher than the release threshold means the button has been released
+        // Held far longer than anyone would; take this reading as the new baseline
         _btnMask &= ~r;
-        // If the button is safely in the released region, tweak the thresholds (this adapts the thresholds to changes in baseline capacitance due to environmental factors)
-        capTgt = _capAvg[h] >> 1;   // observations show a press will quickly generate some values below 3/4 the baseline reading, so gravitate toward that
-        capTgt = (capTgt + _capAvg[h]) >> 1;   // (we get 3/4 by taking 1/2 and averaging it with the full value)
-        _capThrPress[h] += (capTgt >> CAPSENSE_THRESHOLD_SH) - (_capThrPress[h] >> CAPSENSE_THRESHOLD_SH);
-        capTgt = (capTgt + _capAvg[h]) >> 1;   // observations show that a return to 7/8 baseline reading fairly accurately indicates a button release
-        _capThrRelease[h] += (capTgt >> CAPSENSE_THRESHOLD_SH) - (_capThrRelease[h] >> CAPSENSE_THRESHOLD_SH);
+        _capBase[h] = x << CAPSENSE_BASE_FRAC;
+        _stats.touchRecalibrations++;
+      }
+    }
+    else if (dev > (int16_t) press)
+    {
+      // Pressed
+      _btnMask |= r;
+      _btn[h]++;
+      _stats.touchPresses++;
+      _stats.touchLatencyMillis += (_capOnsetMask & r) ? (uint16_t) (t - _capTime[h]) : 0;
+      _capOnsetMask &= ~r;
+      _capTime[h] = t;
+    }
+    else
+    {
+      // Released: note when the reading starts to fall out of the noise, for measuring latency
+      if (dev > (int16_t) (noise * CAPSENSE_ONSET_NOISE))
+      {
+        if (!(_capOnsetMask & r))
+        {
+          _capOnsetMask |= r;
+          _capTime[h] = t;
+        }
+      }
+      else
+      {
+        _capOnsetMask &= ~r;
+      }
+
+      // Follow baseline drift, but hold it while the reading is well on its way to a press
+      if (dev < (int16_t) (press - hyst))
+      {
+        diff = ((int32_t) x << CAPSENSE_BASE_FRAC) - _capBase[h];
+        _capBase[h] += (diff > 0) ? (diff >> CAPSENSE_RISE_SH) : -(-diff >> CAPSENSE_FALL_SH);
+      }
+
+      // Average the change between readings as the noise level, but only while this reading and the last are both within the
+      // onset band around the baseline; readings falling toward a press or climbing back after one would raise the noise
+      // level (and with it the press threshold) on every touch
+      band = noise * CAPSENSE_ONSET_NOISE;
+      last = base - _capLast[h];
+      if ((dev <= band) && (dev >= -band) && (last <= band) && (last >= -band))
+      {
+        d = (x > _capLast[h]) ? x - _capLast[h] : _capLast[h] - x;
+        if (d > CAPSENSE_NOISE_MAX)
+        {
+          d = CAPSENSE_NOISE_MAX;
+        }
+        _capNoise[h] += (d << (CAPSENSE_NOISE_FRAC - CAPSENSE_NOISE_SH)) - (_capNoise[h] >> CAPSENSE_NOISE_SH);
       }
     }
+    _capLast[h] = x;
+  }
+  _capReady = true;
+  _stats.touchPackets++;
+}
+
+void TinyUI::_scanButtons(void)
+{
+  uint8_t r, h, down;
+  uint16_t t, rx;
+
+  // Presses and releases are timed from the touch packet that shows them, not from now (the packet may have come in a while
+  // before poll() got to it); long presses and repeats are timed from now
+  t = millis();
+  rx = _touchTime;
+
+  // Internal capacitive sense filtering, once for each touch packet received
+  if (_refilterCapSense)
+  {
+    if (_touchFresh)
+    {
+      _touchFresh = false;
+      _filterCapSense(rx);
+    }
     // Handle acknowledged presses
     _pressMask &= ~_pressAck;
     _pressMask |= _btnMask;
   }
+  down = _refilterCapSense ? _btnMask : _touchMask;
+
+  for (h = 0, r = 0x10; h < TINYUI_BUTTON_COUNT; h++, r >>= 1)
+  {
+    // Each press counted since the last scan is a down event (the ATTINY may count a whole press and release between packets)
+    while (_press[h] != _btn[h])
+    {
+      _press[h]++;
+      if (_downMask & r)
+      {
+        _pushEvent(TINYUI_EVENT_UP, r, rx);
+      }
+      _pushEvent(TINYUI_EVENT_DOWN, r, rx);
+      _navHistory = (_navHistory << 3) | (h + 1);
+      _downMask |= r;
+      _longMask &= ~r;
+      _repeatTime[h] = rx + _longPressMillis;
+      _repeatInterval[h] = _repeatMillis;
+    }
+    if (_downMask & r)
+    {
+      if (!(down & r))
+      {
+        _downMask &= ~r;
+        _pushEvent(TINYUI_EVENT_UP, r, rx);
+      }
+      else if (((int16_t)(t - _repeatTime[h]) >= 0) && (!(_longMask & r) || _repeatInterval[h]))
+      {
+        // Held long enough for a long press, or for the next auto-repeat (which speeds up each time until it reaches the minimum interval)
+        if (_longMask & r)
+        {
+          _pushEvent(TINYUI_EVENT_REPEAT, r, t);
+          if (_repeatAccelSh)
+          {
+            _repeatInterval[h] -= _repeatInterval[h] >> _repeatAccelSh;
+          }
+          if (_repeatInterval[h] < _repeatMinMillis)
+          {
+            _repeatInterval[h] = _repeatMinMillis;
+          }
+        }
+        else
+        {
+          _longMask |= r;
+          _pushEvent(TINYUI_EVENT_LONG, r, t);
+        }
+        _repeatTime[h] = t + _repeatInterval[h];
+      }
+    }
+  }
+}
+
+void TinyUI::_pushEvent(uint8_t type, uint8_t btn, uint16_t t)
+{
+  TinyUIButtonEvent *e;
+  if (_eventCount < TINYUI_EVENT_QUEUE_SIZE)   // if nobody is reading events, drop new ones rather than old ones
+  {
+    e = _events + ((_eventHead + _eventCount) % TINYUI_EVENT_QUEUE_SIZE);
+    e->time = t;
+    e->type = type;
+    e->button = btn;
+    _eventCount++;
+  }
+}
 
-  // Find a button that has been pressed more times than it has been returned by this function
-  for (h = 0, r = 0x10; r && (_btn[h] == _press[h]); h++, r >>= 1) ;
-  if (r)
+boolean TinyUI::getButtonEvent(TinyUIButtonEvent *event)
+{
+  if (!_eventCount)
   {
-    _press[h]++;
+    return false;
   }
+  *event = _events[_eventHead];
+  _eventHead = (_eventHead + 1) % TINYUI_EVENT_QUEUE_SIZE;
+  _eventCount--;
+  return true;
+}
+
+uint8_t TinyUI::getButtonEvents(TinyUIButtonEvent *events, uint8_t n)
+{
+  uint8_t i;
+  for (i = 0; (i < n) && getButtonEvent(events + i); i++) ;
+  return i;
+}
+
+uint8_t TinyUI::getButton(void)
+{
+  TinyUIButtonEvent e;
 
-  // If reporting a button press, acknowledge it for the currently-pressed-buttons field and enter it into the history
-  if (r)
+  // Find the next button down event
+  while (getButtonEvent(&e))
   {
-    _pressAck |= r;
-    _navHistory = (_navHistory << 3) | (h + 1);
+    if (e.type == TINYUI_EVENT_DOWN)
+    {
+      // Acknowledge it for the currently-pressed-buttons field
+      _pressAck |= e.button;
+      return e.button;
+    }
   }
+  return TINYUI_BUTTON_NONE;
+}
 
-  return r;
+void TinyUI::setButtonRepeat(uint16_t longPress, uint8_t interval, uint8_t minInterval, uint8_t accelSh)
+{
+  _longPressMillis = longPress;
+  _repeatMillis = interval;
+  _repeatMinMillis = minInterval;
+  _repeatAccelSh = accelSh;
 }
 
 uint16_t TinyUI::getPower(uint8_t powerType)
@@ -591,19 +1195,280 @@ void TinyUI::_nvmOp(uint8_t opcode, uint8_t len, uint8_t outlen, uint16_t addr,
   }
 }
 
-void TinyUI::readFLASH(uint16_t addr, uint8_t len, void *data)
+void TinyUI::_nvmRequest(uint8_t *req, uint8_t opcode, uint16_t addr, uint8_t n, const uint8_t *wdata)
 {
-  _nvmOp(NVM_OP_FLASH_READ, len, len, addr, data, NULL);
+  uint8_t i;
+
+  req[0] = opcode | n;
+  *((uint16_t *) (req + 1)) = addr;
+  for (i = 0; i < NVM_BUFFER_SIZE; i++)
+  {
+    req[i + 3] = (wdata && (i < n)) ? wdata[i] : 0;
+  }
+  if (_txIndex >= _txCount)
+  {
+    _txCount = 0;
+    _txIndex = 0;
+  }
+  _txPacket(SPI_OP_NVM_REQUEST, TINYUI_PAYLOAD_LENGTH, req);
+  _stats.packets++;
+  _rxFlags |= TINYUI_GET_NVM_RESULT;
+  _txTimeout = SPI_MAX_RX_TIMEOUT;
+}
+
+void TinyUI::_nvmBegin(void)
+{
+  // Any pending LED packets go out once, ahead of the first request
+  finish();
+  _nvmStart = micros();
+  _txBegin(TINYUI_GET_DEFAULT);
+}
+
+boolean TinyUI::_nvmExchange(uint8_t opcode, uint16_t addr, uint8_t n, const uint8_t *wdata)
+{
+  uint8_t req[TINYUI_PAYLOAD_LENGTH];
+
+  _nvmRequest(req, opcode, addr, n, wdata);
+  _txRun();
+  return !_rxFlags && ((_nvmBuf[0] & NVM_OP_MASK) != NVM_OP_ERROR);
+}
+
+void TinyUI::_nvmEnd(uint8_t opcode, uint16_t len)
+{
+  _txEnd();
+  _scanButtons();
+  if ((opcode & NVM_OP_MASK) >= NVM_OP_ENCRYPT)
+  {
+    _stats.cryptoBytes += len;
+    _stats.cryptoMicros += micros() - _nvmStart;
+  }
+  else
+  {
+    _stats.nvmBytes += len;
+    _stats.nvmMicros += micros() - _nvmStart;
+  }
+}
+
+boolean TinyUI::_nvmBulk(uint8_t opcode, uint16_t addr, boolean addressed, uint16_t len, void *rdata, const void *wdata)
+{
+  uint8_t req[TINYUI_PAYLOAD_LENGTH];
+  uint8_t b, i, n, pending;
+  uint16_t sent, done;
+  boolean ok;
+
+  // Move every chunk in one transaction
+  _nvmBegin();
+  sent = 0;
+  done = 0;
+  pending = 0;
+  ok = true;
+  while (ok && (done < len))
+  {
+    // Send the next request as soon as the last result is in (the ATTINY firmware has one NVM buffer, so a request sent
+    // while a result is still coming in could overwrite it)
+    if ((sent < len) && !pending)
+    {
+      n = ((len - sent) > NVM_BUFFER_SIZE) ? NVM_BUFFER_SIZE : (len - sent);
+      _nvmRequest(req, opcode, addressed ? addr + sent : addr, n, wdata ? ((const uint8_t *) wdata) + sent : NULL);
+      sent += n;
+      pending++;
+    }
+    if (!_txNext(&b))
+    {
+      ok = false;   // timed out waiting for a result
+      break;
+    }
+    SPDR = b;
+    _stats.bytes++;
+    while (!(SPSR & _BV(SPIF))) ;
+    _rxByte(SPDR);
+
+    // Collect each result as it completes, stopping at the first chunk that failed
+    if (pending && !(_rxFlags & TINYUI_GET_NVM_RESULT))
+    {
+      n = ((len - done) > NVM_BUFFER_SIZE) ? NVM_BUFFER_SIZE : (len - done);
+      ok = ((_nvmBuf[0] & NVM_OP_MASK) != NVM_OP_ERROR);
+      if (ok && rdata)
+      {
+        for (i = 0; i < n; i++)
+        {
+          ((uint8_t *) rdata)[done + i] = _nvmBuf[i + 3];
+        }
+      }
+      done += n;
+      pending = 0;
+    }
+  }
+  _nvmEnd(opcode, ok ? len : 0);
+  return ok;
+}
+
+boolean TinyUI::readFLASH(uint16_t addr, uint16_t len, void *data)
+{
+  return _nvmBulk(NVM_OP_FLASH_READ, addr, true, len, data, NULL);
+}
+
+boolean TinyUI::readEEPROM(uint16_t addr, uint16_t len, void *data)
+{
+  return _nvmBulk(NVM_OP_EEPROM_READ, addr, true, len, data, NULL);
+}
+
+boolean TinyUI::writeEEPROM(uint16_t addr, uint16_t len, const void *data)
+{
+  return _nvmBulk(NVM_OP_EEPROM_WRITE, addr, true, len, NULL, data);
+}
+
+uint16_t TinyUI::getNvmRate(void)
+{
+  uint32_t ms;
+  ms = _stats.nvmMicros / 1000;
+  return ms ? (_stats.nvmBytes * 1000) / ms : 0;
+}
+
+void TinyUI::encryptInit(TinyUICryptoStream *s, uint8_t key)
+{
+  s->op = NVM_OP_ENCRYPT;
+  s->arg = key;
+  s->count = 0;
+  s->failed = false;
+}
+
+void TinyUI::decryptInit(TinyUICryptoStream *s, uint8_t key)
+{
+  s->op = NVM_OP_DECRYPT;
+  s->arg = key;
+  s->count = 0;
+  s->failed = false;
+}
+
+int TinyUI::cryptUpdate(TinyUICryptoStream *s, const void *in, uint16_t len, void *out)
+{
+  const uint8_t *src;
+  uint8_t *dst;
+  uint16_t n;
+
+  // Finish off the block left over from last time first (this costs a transaction of its own, so feed whole blocks where possible)
+  src = (const uint8_t *) in;
+  dst = (uint8_t *) out;
+  if (s->count)
+  {
+    while ((s->count < TINYUI_CRYPTO_BLOCK) && len)
+    {
+      s->buf[s->count++] = *src++;
+      len--;
+    }
+    if (s->count < TINYUI_CRYPTO_BLOCK)
+    {
+      return 0;
+    }
+    if (!_nvmBulk(s->op, s->arg, false, TINYUI_CRYPTO_BLOCK, dst, s->buf))
+    {
+      return -1;
+    }
+    dst += TINYUI_CRYPTO_BLOCK;
+    s->count = 0;
+  }
+
+  // Then every whole block in one pipelined transaction, keeping what's left over for next time
+  n = len & ~(TINYUI_CRYPTO_BLOCK - 1);
+  if (n && !_nvmBulk(s->op, s->arg, false, n, dst, src))
+  {
+    return -1;
+  }
+  dst += n;
+  for (len -= n; len; len--)
+  {
+    s->buf[s->count++] = src[n++];
+  }
+  return dst - (uint8_t *) out;
+}
+
+int TinyUI::cryptFinal(TinyUICryptoStream *s, void *out)
+{
+  uint8_t i;
+
+  // Pad the last partial block with zeros
+  if (!s->count)
+  {
+    return 0;
+  }
+  for (i = s->count; i < TINYUI_CRYPTO_BLOCK; i++)
+  {
+    s->buf[i] = 0;
+  }
+  s->count = 0;
+  return _nvmBulk(s->op, s->arg, false, TINYUI_CRYPTO_BLOCK, out, s->buf) ? TINYUI_CRYPTO_BLOCK : -1;
+}
+
+void TinyUI::hashInit(TinyUICryptoStream *s, uint8_t iv)
+{
+  s->op = NVM_OP_HASH;
+  s->arg = iv;
+  s->count = 0;
+  s->failed = false;
+  memset(s->buf, 0, TINYUI_HASH_LENGTH);
+}
+
+boolean TinyUI::hashUpdate(TinyUICryptoStream *s, const void *data, uint16_t len)
+{
+  const uint8_t *src;
+  uint16_t n;
+  boolean ok, open;
+
+  // The ATTINY hashes 12 bytes at a time, so each block is the hash so far followed by 8 bytes of data; since every block
+  // needs the result of the one before, the blocks are sent one after another, but all in the same transaction
+  src = (const uint8_t *) data;
+  n = len;
+  ok = !s->failed;
+  open = false;
+  while (ok && len)
+  {
+    s->buf[TINYUI_HASH_LENGTH + s->count++] = *src++;
+    len--;
+    if (s->count == NVM_BUFFER_SIZE - TINYUI_HASH_LENGTH)
+    {
+      if (!open)
+      {
+        _nvmBegin();
+        open = true;
+      }
+      ok = _nvmExchange(s->op, s->arg, NVM_BUFFER_SIZE, s->buf);
+      memcpy(s->buf, _nvmBuf + 3, TINYUI_HASH_LENGTH);
+      s->count = 0;
+    }
+  }
+  if (open)
+  {
+    _nvmEnd(s->op, ok ? n : 0);
+  }
+  s->failed = !ok;
+  return ok;
 }
 
-void TinyUI::readEEPROM(uint16_t addr, uint8_t len, void *data)
+boolean TinyUI::hashFinal(TinyUICryptoStream *s, uint32_t *out)
 {
-  _nvmOp(NVM_OP_EEPROM_READ, len, len, addr, data, NULL);
+  boolean ok;
+
+  if (s->failed)
+  {
+    s->count = 0;
+    return false;
+  }
+
+  // The last block is always shorter than a full one, which marks the end of the data
+  _nvmBegin();
+  ok = _nvmExchange(s->op, s->arg, TINYUI_HASH_LENGTH + s->count, s->buf);
+  _nvmEnd(s->op, 0);
+  memcpy(out, _nvmBuf + 3, TINYUI_HASH_LENGTH);
+  s->count = 0;
+  return ok;
 }
 
-void TinyUI::writeEEPROM(uint16_t addr, uint8_t len, const void *data)
+uint16_t TinyUI::getCryptoRate(void)
 {
-  _nvmOp(NVM_OP_EEPROM_WRITE, len, len, addr, NULL, data);
+  uint32_t ms;
+  ms = _stats.cryptoMicros / 1000;
+  return ms ? (_stats.cryptoBytes * 1000) / ms : 0;
 }
 
 void TinyUI::encrypt(uint8_t key, uint8_t len, void *data)
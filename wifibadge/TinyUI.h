@@ -7,9 +7,26 @@
 #ifndef TinyUI_h
 #define TinyUI_h
 
+#include <SPI.h>
 #include "Arduino.h"
 
 #define TINYUI_PAYLOAD_LENGTH           15                  // number of data bytes in a packet
+#define TINYUI_PACKET_LENGTH            16                  // opcode and payload, as passed to a TinyUIPacketTap or injectPacket()
+
+// ATTINY chip select and extra channel pins, each given once as its port letter and bit so they can be switched with
+// single-instruction port writes (on the Leonardo, PB4 is digital pin 8 and PB5 is digital pin 9)
+#define TINYUI_CS_PORT_NAME             B
+#define TINYUI_CS_BIT                   4
+#define TINYUI_ECH_PORT_NAME            B
+#define TINYUI_ECH_BIT                  5
+
+// the registers for those pins, made from the port letters
+#define _TINYUI_REG(reg, name)          _TINYUI_REG_PASTE(reg, name)
+#define _TINYUI_REG_PASTE(reg, name)    reg##name
+#define TINYUI_CS_PORT                  _TINYUI_REG(PORT, TINYUI_CS_PORT_NAME)
+#define TINYUI_CS_DDR                   _TINYUI_REG(DDR, TINYUI_CS_PORT_NAME)
+#define TINYUI_ECH_PORT                 _TINYUI_REG(PORT, TINYUI_ECH_PORT_NAME)
+#define TINYUI_ECH_DDR                  _TINYUI_REG(DDR, TINYUI_ECH_PORT_NAME)
 
 // parameters to update(uint8_t)
 #define TINYUI_GET_DEFAULT              0x00                // don't wait for any specific information
@@ -26,6 +43,12 @@
 #define TINYUI_BUTTON_DOWN              0x02                // down button pressed
 #define TINYUI_BUTTON_LEFT              0x01                // left button pressed
 
+// button event types for getButtonEvent(TinyUIButtonEvent *)
+#define TINYUI_EVENT_DOWN               0x01                // button was pressed
+#define TINYUI_EVENT_UP                 0x02                // button was released
+#define TINYUI_EVENT_LONG               0x03                // button has been held for the long press time
+#define TINYUI_EVENT_REPEAT             0x04                // button is still held after a long press (sent at the auto-repeat rate)
+
 // power supply types for getPower(uint8_t)
 #define TINYUI_POWER_USB                0x00                // USB voltage
 #define TINYUI_POWER_LIPO               0x01                // LiPo battery voltage
@@ -35,13 +58,82 @@
 #define TINYUI_LED_COUNT                14                  // number of LEDs that can be controlled
 #define TINYUI_BUTTON_COUNT             5                   // number of buttons that can be pressed
 #define TINYUI_POWER_COUNT              5                   // number of supply voltages that can be queried (only 3 are implemented)
+#define TINYUI_EVENT_QUEUE_SIZE         8                   // number of button events buffered until they are read
+#define TINYUI_TX_QUEUE_LENGTH          6                   // maximum number of packets sent in one update (bling, pulse lengths, transitions, dim, pulse, NavHash/NVM)
 
 // miscellaneous constants
 #define TINYUI_PULSE_LENGTH             10                  // this is the default pulse length found in the ATTINY's firmware
+#define TINYUI_CRYPTO_BLOCK             4                   // encryption and decryption work on blocks of this many bytes
+#define TINYUI_FIRMWARE_SIZE            8192                // bytes of ATTINY88 FLASH hashed by begin() to tell which firmware it runs
+
+// ATTINY firmware features for getFirmwareFeatures() (firmware begin() doesn't recognize has none of them)
+#define TINYUI_FIRMWARE_NO_PAD          0x01                // parses packets without the extra byte between them
+#define TINYUI_FIRMWARE_DEBOUNCE        0x02                // its press counts are debounced well enough to use without refiltering
+#define TINYUI_HASH_LENGTH              4                   // number of bytes in a hash
+#define TINYUI_NVM_BUFFER_SIZE          12                  // most bytes one NVM operation (read, write, encryption, or hash) works on
 #define TINYUI_TRANS_IMMEDIATE          0x00                // this value for a transition means the new values take effect immediately
 #define TINYUI_TRANS_IGNORE             0xff                // this value for a transition means the ATTINY will ignore the new value
                                                             //   (TINYUI_TRANS_IGNORE is less useful since we buffer all the LED settings,
                                                             //    but still used to prevent interfering with previously started transitions)
+#define TINYUI_LONG_PRESS_MILLIS        500                 // default time a button must be held to send TINYUI_EVENT_LONG
+#define TINYUI_REPEAT_MILLIS            150                 // default time between the long press and the first TINYUI_EVENT_REPEAT
+#define TINYUI_REPEAT_MIN_MILLIS        40                  // default fastest auto-repeat rate
+#define TINYUI_REPEAT_ACCEL_SH          3                   // default auto-repeat acceleration (each repeat shortens the interval by 1/8)
+
+// a button event; time is the low 16 bits of millis() when the touch packet showing the change came in from the ATTINY (for
+// TINYUI_EVENT_LONG and TINYUI_EVENT_REPEAT, when the button had been held long enough)
+typedef struct {
+  uint16_t time;
+  uint8_t type;                                             // TINYUI_EVENT_...
+  uint8_t button;                                           // TINYUI_BUTTON_...
+} TinyUIButtonEvent;
+
+// counters of traffic with the ATTINY, for measuring protocol changes
+typedef struct {
+  uint32_t updates;                                         // number of SPI transactions
+  uint32_t packets;                                         // number of packets sent
+  uint32_t bytes;                                           // number of bytes clocked in each direction
+  uint16_t lastMicros;                                      // duration of the last transaction in microseconds (at 16MHz, x16 for cycles)
+  uint32_t totalMicros;                                     // duration of all transactions
+  uint16_t framingErrors;                                   // number of bytes received between packets that are neither 0x00 nor an opcode
+  uint8_t lastFramingByte;                                  // the last of those bytes
+  uint8_t clockDrops;                                       // number of times the SPI clock was slowed down because of framing errors
+  uint32_t ledPackets;                                      // number of dimming, pulsing, and transition packets sent
+  uint32_t ledNoops;                                        // number of LED changes skipped because they would not change anything
+  uint32_t nvmBytes;                                        // number of bytes read from or written to FLASH and EEPROM
+  uint32_t nvmMicros;                                       // time spent in those transfers
+  uint32_t cryptoBytes;                                     // number of bytes encrypted, decrypted, or hashed through the streaming functions
+  uint32_t cryptoMicros;                                    // time spent on those bytes
+  uint32_t touchPackets;                                    // number of touch packets run through the capacitive touch filter (only if isRefilterCapSense())
+  uint16_t touchPresses;                                    // number of presses the filter detected
+  uint16_t touchGlitches;                                   // number of those that were released again within CAPSENSE_GLITCH_MILLIS (most likely false triggers)
+  uint16_t touchRecalibrations;                             // number of presses held so long that the button was taken to be stuck and its baseline reset
+  uint32_t touchLatencyMillis;                              // total time from a reading first leaving the noise to the press being detected (divide by touchPresses for the average latency)
+  uint32_t powerPackets;                                    // number of ADC data packets received (getPower() has new values when this changes)
+} TinyUIStats;
+
+// called with each touch or ADC data packet received from the ATTINY (the opcode byte and TINYUI_PAYLOAD_LENGTH bytes of payload);
+// this is called from the SPI interrupt during a background update, so it must be quick and must not use SPI
+typedef void (*TinyUIPacketTap)(uint8_t op, const uint8_t *payload);
+
+// state of a streaming encryption, decryption, or hash (see encryptInit, decryptInit, and hashInit)
+// A streamed hash is not the same as hash() of the same data: the ATTINY hashes at most TINYUI_NVM_BUFFER_SIZE bytes at a
+// time, so a stream is hashed as a chain of blocks, each the hash so far (zeros for the first) followed by the next 8 bytes
+// of data. Only compare a streamed hash with another streamed hash.
+typedef struct {
+  uint8_t op;                                               // NVM operation
+  uint8_t arg;                                              // key or initial vector index
+  uint8_t count;                                            // number of data bytes waiting in buf for a whole block
+  boolean failed;                                           // true once a hash block has failed (buf no longer holds a good hash, so hashFinal() fails too)
+  uint8_t buf[TINYUI_NVM_BUFFER_SIZE];                      // encryption: data waiting for a whole block; hashing: the hash so far, then data waiting for a whole block
+} TinyUICryptoStream;
+
+// a packet waiting to be sent during an update
+typedef struct {
+  uint8_t op;
+  uint8_t len;
+  const uint8_t *ptr;
+} _TinyUITxPacket;
 
 // ATTINY does animations at 100 frames/sec.
 // default pulse length is 16 frames; pulse periods less than this will be on solid
@@ -49,7 +141,7 @@
 class TinyUI
 {
   public:
-    TinyUI(int csPin, int echPin);                          // chip select pin and extra channel pin
+    TinyUI(void);                                           // (the chip select and extra channel pins are set with TINYUI_CS_... and TINYUI_ECH_...)
     boolean isRefilterCapSense(void);                       // returns true if this module is applying its own capacitive touch data filtering
     void begin(void);                                       // initializes state and associated hardware
     void enableExtraChannels(void);                         // allow the ATTINY to control the RX and TX LEDs
@@ -70,8 +162,20 @@ class TinyUI
     void blingSweep(uint8_t speed, uint8_t period);         // sweep bling mode, period is number of animation frames between animations
     void blingClock(uint8_t hours, uint8_t minutes, uint8_t seconds);   // clock bling mode, with hours (0-23), minutes (0-59), and seconds (0-59)
     void update(uint8_t flags);                             // commit changes to the ATTINY and get updated button and power supply data
+    boolean updateAsync(uint8_t flags);                     // start an update that runs in the background from the SPI interrupt; returns false if one is already running
+                                                            //   (nothing else may use SPI, e.g. the display, until poll() returns true)
+    boolean poll(void);                                     // returns true once no update is running (button data from a finished background update is processed here)
+    void finish(void);                                      // wait for a background update to finish
+    const TinyUIStats *getStats(void);                      // get counters of traffic with the ATTINY
+    uint32_t calibrateSpiClock(void);                       // find the fastest SPI clock that reliably reads back from the ATTINY and use one step slower than that (done by begin()); returns the new clock rate
+    uint32_t getSpiClock(void);                             // get the SPI clock rate in use (this drops automatically if framing errors are detected)
+    uint32_t getFirmwareHash(void);                         // get the FNV-1a hash of the ATTINY's FLASH taken by begin() (0 if it couldn't be read)
+    uint8_t getFirmwareFeatures(void);                      // get the TINYUI_FIRMWARE_... features of the ATTINY firmware, if begin() recognized it
     boolean isPressed(uint8_t btn);                         // returns true if the given button is currently pressed
-    uint8_t getButton(void);                                // get the next button down event (returns TINYUI_BUTTON_NONE if there are no more button down events)
+    uint8_t getButton(void);                                // get the next button down event (returns TINYUI_BUTTON_NONE if there are no more button down events; other queued events are discarded)
+    boolean getButtonEvent(TinyUIButtonEvent *event);       // get the next queued button event (returns false if there are no more events)
+    uint8_t getButtonEvents(TinyUIButtonEvent *events, uint8_t n);   // get up to n queued button events at once; returns the number of events copied
+    void setButtonRepeat(uint16_t longPress, uint8_t interval, uint8_t minInterval, uint8_t accelSh);   // set long press time and auto-repeat rate in milliseconds (interval 0 disables auto-repeat); each repeat shortens the interval by interval >> accelSh (accelSh 0 for a fixed rate)
     uint16_t getPower(uint8_t powerType);                   // get the requested supply voltage in millivolts
     uint8_t getPixel(uint8_t n);                            // get the current dimming value for pixel n (this is the last set value; it may not have been commited to the ATTINY yet)
     uint8_t getPulse(uint8_t n);                            // get the current pulsing value for pixel n (this is the last set value; it may not have been commited to the ATTINY yet)
@@ -79,47 +183,118 @@ class TinyUI
     void getNavHashes(uint8_t len0, uint32_t *data0, uint8_t len1, uint32_t *data1, uint8_t len2, uint32_t *data2);   // get navigation hash values for the given initial vectors
     void getNavHashes(uint8_t len0, uint32_t *data0, uint8_t len1, uint32_t *data1);   // get navigation hash values for the given initial vectors
     void getNavHash(uint8_t len, uint32_t *data);           // get navigation hash value for the given initial vector
-    void readFLASH(uint16_t addr, uint8_t len, void *data);   // read from FLASH memory
-    void readEEPROM(uint16_t addr, uint8_t len, void *data);   // read from EEPROM memory
-    void writeEEPROM(uint16_t addr, uint8_t len, const void *data);   // write to EEPROM memory
+    boolean readFLASH(uint16_t addr, uint16_t len, void *data);   // read from FLASH memory (any length; longer reads are split into chunks that all go in one SPI transaction); returns false on error
+    boolean readEEPROM(uint16_t addr, uint16_t len, void *data);   // read from EEPROM memory (any length, as readFLASH); returns false on error
+    boolean writeEEPROM(uint16_t addr, uint16_t len, const void *data);   // write to EEPROM memory (any length, as readFLASH); returns false on error, and the data from the failed chunk on may not have been written
+    uint16_t getNvmRate(void);                              // average FLASH and EEPROM transfer rate so far, in bytes per second
     void encrypt(uint8_t key, uint8_t len, void *data);     // encrypt data with the key of the given index (len must be a multiple of 4; the data pointer is used for both plaintext in and ciphertext out)
     void decrypt(uint8_t key, uint8_t len, void *data);     // decrypt data with the key of the given index (len must be a multiple of 4; the data pointer is used for both ciphertext in and plaintext out)
     void hash(uint8_t iv, uint8_t len, const void *data, uint32_t *out);   // hash the given data using the initial vector of the given index
+    void encryptInit(TinyUICryptoStream *s, uint8_t key);   // start encrypting a stream of data with the key of the given index
+    void decryptInit(TinyUICryptoStream *s, uint8_t key);   // start decrypting a stream of data with the key of the given index
+    int cryptUpdate(TinyUICryptoStream *s, const void *in, uint16_t len, void *out);   // encrypt or decrypt the next len bytes of any length; returns the number of bytes written to out (whole blocks only; the rest is kept for the next call), or -1 on error (out can be in only if every len is a whole number of blocks)
+    int cryptFinal(TinyUICryptoStream *s, void *out);       // finish a stream, padding the last partial block with zeros; returns the number of bytes written to out (0 or TINYUI_CRYPTO_BLOCK), or -1 on error
+    void hashInit(TinyUICryptoStream *s, uint8_t iv);       // start hashing a stream of data with the initial vector of the given index
+    boolean hashUpdate(TinyUICryptoStream *s, const void *data, uint16_t len);   // hash the next len bytes of any length; returns false on error
+    boolean hashFinal(TinyUICryptoStream *s, uint32_t *out);   // finish a stream and get its hash (not the same as hash() of the same data; see TinyUICryptoStream); returns false on error, here or in any hashUpdate()
+    uint16_t getCryptoRate(void);                           // average streaming encryption, decryption, and hashing rate so far, in bytes per second
     void getButtonHash(uint8_t len, uint32_t *data);        // get navigation hash value based on debounced data
     void seedRandom(void);                                  // seed the random number generator using analog data from the ATTINY88
+    void setPacketTap(TinyUIPacketTap tap);                 // pass every touch and ADC data packet to tap as well (NULL to stop); for recording what the ATTINY sent
+    void setReplay(boolean replay);                         // while true, touch and ADC data from the ATTINY is dropped, and only packets passed to injectPacket() count
+    boolean injectPacket(const uint8_t *packet);            // process a touch or ADC data packet (TINYUI_PACKET_LENGTH bytes) as if the ATTINY had just sent it; returns false if an update is running
     uint32_t _getNavHistory(uint8_t n);                     // dirty hack, going away in the next version
+    void _spiInterrupt(void);                               // called from the SPI interrupt during a background update (not for general use)
   private:
+    uint32_t _fwHash;                                       // see getFirmwareHash()
+    uint8_t _fwFeatures;                                    // see getFirmwareFeatures()
     boolean _refilterCapSense;                              // true if TinyUI capacitive touch filtering algorithm is newer than ATTINY88 code; if so, TinyUI uses its own filtering to detect button presses
-    int _csPin, _echPin;                                    // chip select pin and extra channel pin
+    TinyUIStats _stats;                                     // traffic counters
+    SPISettings _spiSettings;                               // SPI settings for the current clock rate
+    uint8_t _clockIndex;                                    // index of the current clock rate in SpiClocks
+    uint8_t _errorRun;                                      // number of transactions in a row that had framing errors
+    uint8_t _rxErrors;                                      // framing errors in the current transaction
+    uint8_t _calBuf[12];                                    // reference data read at the slowest clock during calibration
+    uint16_t _statStart;                                    // micros() when the current transaction started
     uint8_t _btn[TINYUI_BUTTON_COUNT];                      // buffer of button press counts from the ATTINY (the ATTINY increments the corresponding counter each time a button is pressed)
     uint8_t _press[TINYUI_BUTTON_COUNT];                    // button press counter for acknowledged presses (this is incremented when getButton() returns the corresponding button until it is equal to _btn)
     uint16_t _capAvg[TINYUI_BUTTON_COUNT];                  // capacitive data for each button; this is the moving average filtered data provided by the ATTINY88 and needs to be thresholded to determine button state
-    uint16_t _capThrPress[TINYUI_BUTTON_COUNT];             // threshold for detecting a pressed button (used only if _refilterCapSense is true)
-    uint16_t _capThrRelease[TINYUI_BUTTON_COUNT];           // threshold for detecting a released button (used only if _refilterCapSense is true)
+    uint16_t _capBase[TINYUI_BUTTON_COUNT];                 // baseline (untouched) capacitive reading for each button, with CAPSENSE_BASE_FRAC fraction bits (used only if _refilterCapSense is true)
+    uint16_t _capNoise[TINYUI_BUTTON_COUNT];                // average change between readings of each untouched button, with CAPSENSE_NOISE_FRAC fraction bits (used only if _refilterCapSense is true)
+    uint16_t _capLast[TINYUI_BUTTON_COUNT];                 // previous reading for each button (used only if _refilterCapSense is true)
+    uint16_t _capTime[TINYUI_BUTTON_COUNT];                 // millis() (low 16 bits) when each button's reading left the noise, or when it was pressed (used only if _refilterCapSense is true)
+    uint8_t _capOnsetMask;                                  // buttons whose readings have left the noise but are not pressed yet (used only if _refilterCapSense is true)
+    boolean _capReady;                                      // true once the baselines have been set from a touch packet
+    volatile boolean _touchFresh;                           // set when a touch packet arrives, and reset when it has been filtered
+    uint16_t _touchTime;                                    // millis() (low 16 bits) when the last touch packet came in
     uint8_t _btnMask;                                       // currently pressed buttons (used only if _refilterCapSense is true)
     uint16_t _pwr[TINYUI_POWER_COUNT];                      // buffer of supply voltages received from the ATTINY (multiply each of these values by 5.5 to get a result in millivolts)
     uint8_t _dim[TINYUI_LED_COUNT];                         // buffer of LED dimming values
     uint8_t _pulse[TINYUI_LED_COUNT];                       // buffer of LED pulsing periods
-    uint8_t _trans[TINYUI_LED_COUNT];                       // buffer of transition lengths
+    uint8_t _trans[TINYUI_LED_COUNT];                       // buffer of transition lengths last set for each LED
     uint8_t _len[TINYUI_LED_COUNT];                         // buffer of pulse lengths
     uint8_t _bling[TINYUI_PAYLOAD_LENGTH];                  // parameters for bling modes
     uint32_t _navHistory;                                   // buttons pressed (this is handled here because of the debouncing bug)
-    boolean _dimDirty;                                      // set to true when a dimming value has been changed, then reset after the new dimming values have been sent to the ATTINY
-    boolean _pulseDirty;                                    // set to true when a pulsing value has been changed, then reset after the new pulsing values have been sent to the ATTINY
+    uint16_t _dimDirty;                                     // bit n is set when the dimming value of LED n has been changed, then reset after the new dimming values have been sent to the ATTINY
+    uint16_t _pulseDirty;                                   // bit n is set when the pulsing value of LED n has been changed, then reset after the new pulsing values have been sent to the ATTINY
+    uint16_t _transMask;                                    // bit n is set when LED n was last sent a transition that may still be running on the ATTINY
     boolean _lenDirty;                                      // set to true when a pulse length has been changed, then reset after the new pulse lengths have been sent to the ATTINY
     boolean _blingDirty;                                    // set to true when a bling mode has been changed, then reset after the new bling data has been sent to the ATTINY
     uint8_t _pressMask;                                     // mask of buttons that were pressed in a previous button state packet and have not yet been acknowledged
     uint8_t _pressAck;                                      // mask of button presses that have been acknowledged; if they are not present in the next button state packet, they will be removed from _pressMask
+    uint8_t _touchMask;                                     // buttons reported as down in the last touch data packet (used only if _refilterCapSense is false)
+    uint8_t _downMask;                                      // buttons that have had a down event and no up event yet
+    uint8_t _longMask;                                      // buttons that have had a long press event since they went down
+    uint16_t _repeatTime[TINYUI_BUTTON_COUNT];              // millis() (low 16 bits) when the next long press or repeat event is due for each held button
+    uint8_t _repeatInterval[TINYUI_BUTTON_COUNT];           // current auto-repeat interval for each held button
+    uint16_t _longPressMillis;                              // auto-repeat settings (see setButtonRepeat)
+    uint8_t _repeatMillis;
+    uint8_t _repeatMinMillis;
+    uint8_t _repeatAccelSh;
+    TinyUIButtonEvent _events[TINYUI_EVENT_QUEUE_SIZE];     // ring buffer of button events not yet read
+    uint8_t _eventHead;                                     // index of the oldest event in _events
+    uint8_t _eventCount;                                    // number of events in _events
     boolean _isExtraChannels;                               // set to true if the ATTINY is in control of the RX and TX LEDs (pins will be set low on each call to update(uint8_t) because Arduino sometimes messes with them)
     uint8_t _rxFlags;                                       // used during update(uint8_t) to track which update packet types need to be received; bits are cleared as the requested packet types are received
+    _TinyUITxPacket _txQueue[TINYUI_TX_QUEUE_LENGTH];       // packets to send in the current update
+    uint8_t _txCount;                                       // number of packets in _txQueue
+    uint8_t _txIndex;                                       // packet in _txQueue currently being sent
+    uint8_t _txPos;                                         // byte of that packet being sent next (0 is the opcode)
+    uint8_t _txTimeout;                                     // bytes left to wait for requested data after all packets are sent
+    uint8_t _txTrans[TINYUI_LED_COUNT];                     // transitions being sent in the current update
+    uint8_t _txDim[TINYUI_LED_COUNT];                       // dimming values being sent in the current update (so setPixel() during a background update can't change the packet on its way out)
+    uint8_t _txPulse[TINYUI_LED_COUNT];                     // pulsing periods being sent in the current update
+    volatile boolean _asyncBusy;                            // true while a background update is running
+    volatile boolean _asyncDone;                            // set by the SPI interrupt when a background update finishes; cleared by poll()
     uint8_t _rxOpcode;                                      // packet currently being parsed
+    uint8_t _rxOp;                                          // opcode byte as received (touch packets carry the touched buttons in it)
+    boolean _rxDrop;                                        // true if the packet being parsed is being dropped because of setReplay()
+    boolean _replay;                                        // see setReplay()
+    TinyUIPacketTap _packetTap;                             // see setPacketTap()
     uint8_t _rxPtr;                                         // offset into packet currently being parsed
     uint8_t _rxBuf[TINYUI_PAYLOAD_LENGTH];                  // packet currently being received
     uint8_t _nvmBuf[TINYUI_PAYLOAD_LENGTH];                 // NavHash and NVM packet buffer
+    void _setLed(uint8_t *buf, uint16_t *dirty, uint8_t n, uint8_t v, uint8_t frames);   // internal method to change a dimming or pulsing value unless it would have no effect
+    void _setSpiClock(uint8_t n);                           // internal method to select a clock rate from SpiClocks
+    void _probeFirmware(void);                              // internal method to hash the ATTINY's FLASH and look up the firmware's features
+    boolean _checkLink(uint8_t *ref);                       // internal method to do a test read from the ATTINY, comparing it against ref if not NULL
     void _rxBegin(void);                                    // internal method to reset received packet parsing state
+    void _scanButtons(void);                                // internal method to turn button data from the ATTINY into button events
+    void _filterCapSense(uint16_t t);                       // internal method to run new capacitive touch data through the press detector
+    void _pushEvent(uint8_t type, uint8_t btn, uint16_t t);   // internal method to queue a button event
     void _rxByte(uint8_t b);                                // internal method to parse a received data byte
-    void _txPacket(uint8_t op, uint8_t len, const void *ptr);   // transmit packet with opcode op, data length len, and payload data at ptr
+    void _txPacket(uint8_t op, uint8_t len, const void *ptr);   // queue packet with opcode op, data length len, and payload data at ptr
+    void _txBegin(uint8_t flags);                           // queue the packets for an update and start the SPI transaction
+    boolean _txNext(uint8_t *b);                            // get the next byte to send; returns false when the update is complete
+    void _txEnd(void);                                      // end the SPI transaction
+    void _txRun(void);                                      // send and receive bytes until the queued packets are sent and the requested data has arrived
     void _nvmOp(uint8_t opcode, uint8_t len, uint8_t outlen, uint16_t addr, void *rdata, const void *wdata);   // perform NVM operation
+    uint32_t _nvmStart;                                     // micros() when the current NVM transaction started
+    void _nvmBegin(void);                                   // internal method to start a transaction for NVM requests
+    boolean _nvmExchange(uint8_t opcode, uint16_t addr, uint8_t n, const uint8_t *wdata);   // internal method to send one NVM request and wait for its result in _nvmBuf
+    void _nvmEnd(uint8_t opcode, uint16_t len);             // internal method to end an NVM transaction, counting len bytes toward the throughput stats
+    boolean _nvmBulk(uint8_t opcode, uint16_t addr, boolean addressed, uint16_t len, void *rdata, const void *wdata);   // perform an NVM operation of any length, in chunks pipelined in one transaction (addressed is false when addr is a key or IV index rather than a memory address)
+    void _nvmRequest(uint8_t *req, uint8_t opcode, uint16_t addr, uint8_t n, const uint8_t *wdata);   // build an NVM request for n bytes in req and queue it
 };
 
 #endif
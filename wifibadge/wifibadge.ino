@@ -12,10 +12,20 @@
 #include "TinyUI.h"             // The user interface object - documented in TinyUI.h and below
 #include "MenuNodeP.h"          // The menu object - documented below
 #include "EspModule.h"          // The ESP module interface
+#include "GameRuntime.h"        // Runs games in fixed time steps - documented in GameRuntime.h
 #include "Simon.h"              // Simon Says game
-
-// Maximum (zero-based) line number in the menu display (this should probably not be changed unless you change the font on the screen)
-#define MENU_HEIGHT 3
+#include "ListView.h"           // Scrolling list on the screen, shared by the menu and the scanner
+#include "LedSequencer.h"       // Plays LED animations, letting the ATTiny88 do the fading
+#include "SettingsStore.h"      // Keeps the settings in the ATTiny88's EEPROM
+#include "ScanHistory.h"        // Logs what the scanner saw on each channel to EEPROM
+#include "NetworkCounter.h"     // Estimates how many different networks the scanner has seen
+#include "ChannelOccupancy.h"   // Works out how busy each channel is for the LEDs
+#include "TaskScheduler.h"      // Runs the work in loop() as tasks, most urgent first
+#include "Profiler.h"           // Times the busiest parts of the code (set PROFILER_ENABLED to 1 in Profiler.h to build it in)
+#include "MemoryMonitor.h"      // Reports how the RAM is being used
+#include "IdleSleep.h"          // Sleeps between tasks to save battery
+#include "PowerMonitor.h"       // Watches the battery and says when to save power
+#include "SessionLog.h"         // Records and replays the badge's inputs over the USB serial port (set SESSION_LOG_ENABLED to 1 in SessionLog.h to build it in)
 
 // The number of WiFi channels that can be scanned for
 #define CHANNEL_COUNT 14
@@ -23,10 +33,10 @@
 // Milliseconds between WiFi scans
 #define SCAN_INTERVAL 5000
 
-// Maximum amount of activity on a channel; e.g. if there are more than 16 accesss points in a channel it will hold the LED on solid instead of attempting to flash
+// Number of steps between the LED blink rate for the quietest channel and the busiest (see ChannelOccupancy.h); a channel at the top step holds the LED on solid instead of attempting to flash
 #define DEFAULT_MAX_ACTIVITY 16
 
-// Shift for multiplying channel activity; this is actually a bitshift meaning it multiplies activity by 4 making it more apparent when flashing the LEDs (you should probably not change this)
+// Shift for multiplying the channel occupancy level; this is actually a bitshift meaning it multiplies the level by 4 making it more apparent when flashing the LEDs (you should probably not change this)
 #define ACTIVITY_SH 2
 
 // Too many wifi networks can overflow the RAM... (you should probably not change this unless you make it smaller) -- NOTE Max = 256
@@ -35,9 +45,18 @@
 // Too many secrets
 #define SECRET_ANIMATE_MILLIS   1000
 
+// Maximum number of button events handled in one pass through loop()
+#define BUTTON_EVENT_BATCH  TINYUI_EVENT_QUEUE_SIZE
+
 // Easter egg stuff; good hunting!
 #define RED_PILL_INTERVAL   250
 #define RED_PILL_FRAMES      16
+PgmLedAnimation(red_pill_anim) = {
+  { LEDSEQ_PIXELS_ALL, LEDSEQ_KEY_RANDOM | LEDSEQ_KEY_TOGGLE, 255, 0, RED_PILL_FRAMES, RED_PILL_INTERVAL }
+};
+PgmLedAnimation(red_pill_off_anim) = {
+  { LEDSEQ_PIXELS_ALL, 0, 0, 0, RED_PILL_FRAMES, 0 }
+};
 
 // Setup hardware SPI parameters (you probably shouldn't change these)
 #define OLED_DC     5
@@ -89,6 +108,7 @@ static const unsigned char PROGMEM mr_blinky_bling_logo_bmp[] =
 #define MENU_TYPE_GAME           0x03
 #define MENU_TYPE_SETTING        0x04
 #define MENU_TYPE_SECRET         0x05
+#define MENU_TYPE_HISTORY        0x06
 #define MENU_BLING_OFF           0x00
 #define MENU_BLING_SPIN          0x01
 #define MENU_BLING_HEARTBEAT     0x02
@@ -102,6 +122,7 @@ static const unsigned char PROGMEM mr_blinky_bling_logo_bmp[] =
 #define MENU_REGION_JP           0x03
 #define MENU_SECRET_RABBIT       0x01
 #define MENU_SECRET_RED_PILL     0x02
+#define MENU_SECRET_MEMORY       0x03
 
 // These settings are used in navigateInto() to do extra menu setup; you probably shouldn't change these but you can add more if you are adding a menu that has a selection saved
 #define MENU_ID_ROOT             0x00000000
@@ -121,6 +142,7 @@ static const unsigned char PROGMEM mr_blinky_bling_logo_bmp[] =
 PgmMenuText(m_title, 0x289ffb00, NO_LOCKS, "Mr. Blinky Bling");
 PgmMenuText(m_subtitle, 0xf44763d8, NO_LOCKS, " - DC25 -");
 PgmMenuLeaf(m_scan, 0x42efc888, NO_LOCKS, "Scanner", MENU_TYPE_SCANNER);
+PgmMenuLeaf(m_history, 0x6d3a51e4, NO_LOCKS, "Scan history", MENU_TYPE_HISTORY);
 PgmMenuLeaf(m_bling_off, 0x2e9b072a, NO_LOCKS, "Off", MENU_TYPE_BLING, MENU_BLING_OFF);
 PgmMenuLeaf(m_bling_spin, 0x471289df, NO_LOCKS, "Spin", MENU_TYPE_BLING, MENU_BLING_SPIN);
 PgmMenuLeaf(m_bling_heartbeat, 0xff77c01d, NO_LOCKS, "Heartbeat", MENU_TYPE_BLING, MENU_BLING_HEARTBEAT);
@@ -157,41 +179,77 @@ PgmMenuText(m_info_2, 0x7f1d7b0b, NO_LOCKS, "GET NOTICED!");
 PgmMenuText(m_info_3, 0xa4ab3c29, NO_LOCKS, "@blenster");
 PgmMenuText(m_info_4, 0x151e9dc8, NO_LOCKS, "@tweetthehat");
 PgmMenuLeaf(m_info_5, 0xb5b5c242, NO_LOCKS, "FollowTheWhiteRabbit", MENU_TYPE_SECRET, MENU_SECRET_RABBIT);
-PgmMenuNode(m_info, 0xa53d1abb, NO_LOCKS, "Info", &m_info_1, &m_info_2, &m_info_3, &m_info_4, &m_info_5);
+PgmMenuLeaf(m_info_memory, 0x3b8e6f2a, UNLOCK_RABBIT, "Memory", MENU_TYPE_SECRET, MENU_SECRET_MEMORY);
+PgmMenuNode(m_info, 0xa53d1abb, NO_LOCKS, "Info", &m_info_1, &m_info_2, &m_info_3, &m_info_4, &m_info_5, &m_info_memory);
 PgmMenuLeaf(m_red_pill, 0xd78881ff, UNLOCK_RABBIT, "Take the red pill", MENU_TYPE_SECRET, MENU_SECRET_RED_PILL);
-PgmMenuNode(m_root, MENU_ID_ROOT, NO_LOCKS, "", &m_title, &m_subtitle, &m_scan, &m_bling, &m_games, /*&m_settings,*/ &m_info, &m_red_pill);
+PgmMenuNode(m_root, MENU_ID_ROOT, NO_LOCKS, "", &m_title, &m_subtitle, &m_scan, &m_history, &m_bling, &m_games, /*&m_settings,*/ &m_info, &m_red_pill);
+
+// Every menu node sorted by ID so nodes can be found without walking the tree (see navigateToId)
+// If you add a menu item, add it here too, keeping the list in ascending order of ID or it won't be found! (setup() stops
+// with the out of order entry on the screen if it isn't)
+PgmMenuIndex(m_index,
+  &m_root,              // 0x00000000
+  &m_info_4,            // 0x151e9dc8
+  &m_title,             // 0x289ffb00
+  &m_bling_off,         // 0x2e9b072a
+  &m_info_memory,       // 0x3b8e6f2a
+  &m_scan,              // 0x42efc888
+  &m_bling_spin,        // 0x471289df
+  &m_games,             // 0x490162ad
+  &m_bling_sparkle,     // 0x5089880f
+  /*&m_settings_region_eu,*/   // 0x5564de88
+  &m_games_simon,       // 0x5cfbe589
+  &m_history,           // 0x6d3a51e4
+  /*&m_settings_region_us,*/   // 0x751bea52
+  &m_info_2,            // 0x7f1d7b0b
+  /*&m_settings_region_jp,*/   // 0xa2cea3b0
+  &m_info_3,            // 0xa4ab3c29
+  &m_info,              // 0xa53d1abb
+  &m_info_5,            // 0xb5b5c242
+  /*&m_settings_region,*/      // 0xba9c9844
+  &m_bling,             // 0xbf7adf6c
+  /*&m_settings,*/             // 0xc91d02ec
+  &m_info_1,            // 0xca976999
+  &m_red_pill,          // 0xd78881ff
+  &m_bling_sweep,       // 0xeebec5f8
+  &m_subtitle,          // 0xf44763d8
+  &m_bling_heartbeat    // 0xff77c01d
+);
 
 // holds menu strings - limited to 24 characters to avoid menu scrolling issues. If you adjust this to be larger more than 24 will require rewriting scrolling.
 char buffer[24];
 
 // Setup the menu
-int menu_position = 0;            // How many rows down the menu we have scrolled
-int menu_selected = 0;            // Where the inverted "cursor" appears on the menu
+ListView menu_list(&display);     // The rows on the screen; shows the children of menu_level, or the network list in the scanner
 MenuNodeP* menu_level = &m_root;  // What level are we in the menu?
+MenuNodeView menu_view;           // RAM copy of menu_level's type, subtype, and id (always change menu_level through setMenuLevel so this stays in sync)
+int secret_position = 0;          // Scratch position for the Easter eggs
+long secret_time = 0;             // Scratch millis() time for the hidden screens
 
 /*
- * Here's how these two menu variables work:
+ * Here's how the menu list positions work:
  *
  * Example:
  *
- * Menu Option 1  <-- menu_position == 0 (zero indexed)
+ * Menu Option 1  <-- menu_list.getPosition() == 0 (zero indexed)
  * Menu Option 2
- * MENU OPTION 3  <-- menu_selected == 2 (zero indexed)
+ * MENU OPTION 3  <-- menu_list.getSelected() == 2 (zero indexed)
  * Menu Option 4
  *
  * After some scrolling down, and once back up
  *
- * Menu Option 3  <-- menu_position == 2 (zero indexed)
+ * Menu Option 3  <-- menu_list.getPosition() == 2 (zero indexed)
  * Menu Option 4
- * MENU OPTION 5  <-- menu_selected == 4 (zero indexed)
+ * MENU OPTION 5  <-- menu_list.getSelected() == 4 (zero indexed)
  * Menu Option 6
  *
- * menu_position shows which entry is currently at the top of the screen and you can probably ignore this in your code
- * menu_selected shows the currently highlighted menu option and this is the one that will be activated
+ * getPosition() shows which entry is currently at the top of the screen and you can probably ignore this in your code
+ * getSelected() shows the currently highlighted menu option and this is the one that will be activated
+ * menu_list.select(n) moves the highlight (scrolling as needed) and menu_list.draw() redraws only the rows that changed
  *
  */
 
-// Global settings in a struc for convenience; these may be pushed to EEPROM in the future
+// Global settings in a struc for convenience; these are saved to the ATTiny88's EEPROM (call settings_store.changed() after changing any of them)
 struct {
   uint8_t blingMode;
   uint8_t region;
@@ -205,12 +263,27 @@ struct {
   uint8_t sparkleFreq;
   uint8_t sweepSpeed;
   uint8_t sweepPeriod;
+  uint32_t lastMenu;    // ID of the screen to go back to at power up (the scanner or history, or MENU_ID_ROOT for the top menu)
 } settings;
 
-// Initialize the ATTiny88 communication (You REALLY should not change these)
-#define UI_CS       8
-#define UI_ECH      9
-TinyUI ui(UI_CS, UI_ECH);
+// Initialize the ATTiny88 communication (the pins are set in TinyUI.h, and you REALLY should not change them)
+TinyUI ui;
+
+// Settings are kept in the ATTiny88's EEPROM; bump SETTINGS_VERSION if you change the settings struct so old records are ignored
+#define SETTINGS_VERSION       2
+#define SETTINGS_EEPROM_ADDR   0
+#define SETTINGS_EEPROM_SIZE   64
+SettingsStore settings_store(&ui, SETTINGS_EEPROM_ADDR, SETTINGS_EEPROM_SIZE, &settings, sizeof(settings), SETTINGS_VERSION);
+
+// The scan history log lives in the ATmega32U4's own EEPROM (the ATTiny88's is taken up by the settings); one record per minute of scanning
+#define HISTORY_EEPROM_ADDR    0
+#define HISTORY_EEPROM_SIZE    (E2END + 1 - HISTORY_PAGE_SIZE)
+ScanHistory history(HISTORY_EEPROM_ADDR, HISTORY_EEPROM_SIZE);
+
+// Counts the different networks seen (shown at the top of the scanner; send 'n' over the USB serial port to see it, or 'N' to start
+// again from zero); the count is checkpointed to the last page of the ATmega32U4's EEPROM, after the history
+#define NETCOUNT_EEPROM_ADDR   (HISTORY_EEPROM_ADDR + HISTORY_EEPROM_SIZE)
+NetworkCounter network_counter(NETCOUNT_EEPROM_ADDR);
 
 // Initialize the ESP module through some ugly hacked up code hidden in EspModule.cpp (Only the brave should look at that mess)
 EspModule esp;
@@ -229,16 +302,73 @@ typedef struct _NetworkInfo {
 } NetworkInfo;
 NetworkInfo *networkList = NULL;
 NetworkInfo *networksRx = NULL;
+int networkCount = 0;                 // Number of networks in networkList
+NetworkInfo *networkCursor = NULL;    // Network renderNetwork() printed last (so drawing the rows in order walks the list once, not from the start for every row)
+int networkCursorIndex = 0;           // Its index in networkList
+uint32_t networkSteps = 0;            // Networks walked past by renderNetwork() (for measuring repaint cost)
+
+// This plays LED animations; only one plays at a time, and starting another replaces it
+LedSequencer leds;
+
+// Runs whichever game is being played (send 'g' over the USB serial port for its frame timing). A game is a Game (see GameRuntime.h):
+// it keeps its state in the runtime's fixed-size pool rather than allocating it, advances in GAME_TICK_MILLIS steps, gets one
+// button per step, and draws into the display buffer when it asks for a redraw; the runtime pushes at most one frame per run.
+GameRuntime games;
 
 // This initializes the Simon game object
 Simon simon;
 
+// Keeps track of RAM use (send 'm' over the USB serial port, or unlock the hidden Info > Memory screen, to see it)
+#define MEMORY_REFRESH_MILLIS 1000   // how often the memory screen is updated
+MemoryMonitor memory;
+
 // Some variables for the netwrok scanning the ESP will do (You should probably not change these initial values; they get reset anyway)
-long nextScan = 0;   // millis() value for next WiFi scan
 uint16_t networkRAM = 0;   // Number of bytes being used to store network data
+boolean espReceiving = false;     // True when the ESP is still recieving data
+boolean networksChanged = false;  // True when a new network list has come in and the screen hasn't caught up yet
+
+// The work loop() does is split into tasks that run one at a time, most urgent first (see TaskScheduler.h). The ESP's serial
+// data can't wait long before its receive buffer overflows, button presses should feel instant, and the screen only needs
+// redrawing so often. Each task has a deadline after it is due; runs that start later than that are counted as misses.
+// When no task is due, the CPU sleeps until the next interrupt (see IdleSleep.h). Buttons and screens are run less often once
+// nothing has happened for a while (IDLE_MODE_SLOW), so the badge spends most of its time asleep on a menu screen.
+#define RADIO_MILLIS     20     // ESP serial data is drained as soon as it comes in, and checked this often anyway
+#define RADIO_DEADLINE   3      // (the 64 byte receive buffer fills in about 5ms at 115200 baud)
+#define INPUT_MILLIS     10     // button data comes in from the ATTiny88 (and LED changes go out) this often...
+#define INPUT_IDLE_MILLIS 50    // ...or this often in IDLE_MODE_SLOW
+#define INPUT_DEADLINE   20
+#define SCAN_DEADLINE    1000   // (WiFi scans start every SCAN_INTERVAL while the scanner is showing)
+#define TICK_MILLIS      10     // games and other screens that do things over time are run this often...
+#define TICK_IDLE_MILLIS 100    // ...or this often in IDLE_MODE_SLOW
+#define TICK_DEADLINE    20
+#define FRAME_MILLIS     33     // the screen is redrawn at most this often (about 30 frames per second)
+#define FRAME_DEADLINE   50
+#define SERIAL_MILLIS    50     // commands from the USB serial port are checked this often
+#define SERIAL_DEADLINE  200
+TaskScheduler scheduler;
+uint8_t task_radio, task_input, task_scan, task_tick, task_render, task_serial;
+IdleSleep idle_sleep;
+uint8_t pollMode = IDLE_MODE_FAST;   // The IdleSleep mode the input and tick tasks' periods are set for
+
+// Keeps an eye on the supply voltages (send 'b' over the USB serial port to see them). As the battery runs down (POWER_LEVEL_LOW,
+// then POWER_LEVEL_CRITICAL), WiFi scans and screen redraws are spaced out twice as far each level, and bling is cut back to a
+// heartbeat and then turned off; it all comes back once the battery does (or USB is plugged in).
+PowerMonitor power;
+
+// Records every input (touch and power data from the ATTiny88, bytes from the ESP module) to the USB serial port with 'r', and plays
+// a recording back in place of the real inputs with 'R' (then send the recorded lines). Replaying the same recording on two builds
+// makes their task timing, profiler, and SPI traffic figures comparable; reset the badge before recording and before replaying so
+// both start from the same screen. The figures are dumped when the replay ends. On the badge, inputs only come in on time to within
+// an input task period, so two replays differ a little; host/replay plays a session on a virtual clock, where they come out the same
+// every time (see host/README.md).
+#if SESSION_LOG_ENABLED
+SessionLog session;
+#endif
 
 // This is the main setup function - just like any other Arduino Sketch - see arduino.cc documentation for more information
 void setup() {
+  uint8_t i;
+
   //Serial.begin(9600);   // If there's no USB connection, this may hang, but if you want to interact through the serial monitor uncomment this line
 
   // Initial values for user modifiable settings - default settings:
@@ -254,7 +384,9 @@ void setup() {
   settings.sparkleFreq = 32;
   settings.sweepSpeed = 6;
   settings.sweepPeriod = 64;
+  settings.lastMenu = MENU_ID_ROOT;
   MenuNodeP::setLocks(settings.unlocked);
+  setMenuLevel(&m_root);
 
   // by default, we'll generate the high voltage from the 3.3v line internally! (neat!)
   display.begin(SSD1306_SWITCHCAPVCC);
@@ -275,121 +407,332 @@ void setup() {
   display.setTextSize(1);
   display.setTextColor(WHITE);
 
+  // The menu index has to be in order of ID for navigateToId() to find anything, so stop here and say which entry is out of place
+  i = MenuNodeP::checkIndex(m_index, HowBigIsThisArray(m_index));
+  if (i < HowBigIsThisArray(m_index)) {
+    display.setCursor(0, 0);
+    display.print(F("m_index out of order"));
+    display.setCursor(0, 8);
+    display.print(F("at entry "));
+    display.print(i);
+    display.display();
+    while (true) {
+    }
+  }
+
   // draw the menu on the screen
-  draw_menu();
+  menu_list.draw();
 
   // Initialize the connection to the ATTiny88
   ui.begin();
   ui.enableExtraChannels(); // Hands control over the RX/TX LEDs to the ATTiny88 for animations and channel information
   ui.update(TINYUI_GET_DEFAULT);  // Syncs up over the SPI connection with a SPI transaction
 
+  // Restore the saved settings, if there are any (otherwise the defaults above stay)
+  if (settings_store.load()) {
+    MenuNodeP::setLocks(settings.unlocked);
+    setBling(settings.blingMode);
+  }
+
+  // Pick up the scan history and network count where they left off
+  history.begin();
+  network_counter.begin();
+
   // Start talking to the ESP module over serial
   esp.begin();
 
-  // Initialize the Simon game; it needs a reference to the ATTiny88 and the display in order to play the game
-  simon.setUi(&ui, &display);
+  // Initialize the Simon game; it needs a reference to the ATTiny88, the display, and the LED animation player in order to play the game
+  leds.setUi(&ui);
+  power.setUi(&ui);
+  simon.setUi(&ui, &leds);
+  games.setDisplay(&display);
+
+  // Start the clock for timing sections of code (send 'p' over the USB serial port to see the results)
+#if PROFILER_ENABLED
+  profiler.begin();
+#endif
+
+  // Set up the tasks loop() runs, in order of priority
+  task_radio = scheduler.addPeriodic(runRadio, 0, RADIO_MILLIS, RADIO_DEADLINE);
+  task_input = scheduler.addPeriodic(runInput, 1, INPUT_MILLIS, INPUT_DEADLINE);
+  task_scan = scheduler.addPeriodic(runScan, 2, SCAN_INTERVAL, SCAN_DEADLINE);
+  task_tick = scheduler.addPeriodic(runTick, 3, TICK_MILLIS, TICK_DEADLINE);
+  task_render = scheduler.addEvent(runRender, 4, FRAME_MILLIS, FRAME_DEADLINE);
+  task_serial = scheduler.addPeriodic(runSerial, 5, SERIAL_MILLIS, SERIAL_DEADLINE);
+
+  // Go back to the scanner or history if that's where the badge was when it was switched off
+  if (settings.lastMenu != MENU_ID_ROOT) {
+    navigateToId(settings.lastMenu);
+  }
 }
 
 // This is the main loop of the Arduino sketch -- see Arduino Documentation
 void loop() {
-  // These variables are all defined up here because C conditions you to declare all your variables at the top of the function
-  uint8_t btn;          // The buttons that have been pressed that come back from the ATTiny88 via TinyUI
-  uint8_t menuType;     // One of the identifiers pulled from the current menu object (the 0x0? values defined on lines 86 - 104)
   long t;               // Current value from millis() -- https://www.arduino.cc/en/Reference/Millis Used for general timing
-  boolean espData;      // True when the ESP is still recieving data
-  boolean refreshData;  // True when we need to update the display
-  uint8_t i;            // Loop variable e.g. for (i = 0; i < CHANNEL_COUNT; i++) {...
-  
+
   t = millis();
-  
-  espData = esp.handleData();  // Returns nothing if it doesn't have an open operation; this is necessary in case the user exits the scanning while an operation is underway
-  menuType = menu_level->getDataByte(0);  // Operates the menu off the lower-number constants defined above (lines 86 - 104)
+  memory.sample();   // for the heap's high-water mark
+
+  // Data from the ESP module is drained right away (receiving it wakes the CPU up)
+  if (esp.available()) {
+    scheduler.trigger(task_radio);
+  }
+  setPollRate(t);
+
+  // Runs whichever task is most urgent (one per pass, so an urgent task never waits for more than one other task to finish), or
+  // sleeps until the next interrupt if there's nothing to do
+  if (scheduler.run(t)) {
+    countLoop(t, true);
+  } else {
+    countLoop(t, false);
+    idle_sleep.sleep();
+  }
+}
+
+// Polls the buttons and runs the screen often for a while after a button press, and all the time while a game or LED animation is
+// running, but less often when the badge is left alone
+void setPollRate(long t) {
+  uint8_t mode;
+  if ((menu_view.type == MENU_TYPE_GAME) || leds.isPlaying()) {
+    idle_sleep.activity(t);
+  }
+#if SESSION_LOG_ENABLED
+  if (session.getMode()) {
+    idle_sleep.activity(t);   // (recordings keep to one rate so replays line up)
+  }
+#endif
+  mode = idle_sleep.getMode(t);
+  if (mode != pollMode) {
+    pollMode = mode;
+    scheduler.setPeriod(task_input, (mode == IDLE_MODE_FAST) ? INPUT_MILLIS : INPUT_IDLE_MILLIS);
+    scheduler.setPeriod(task_tick, (mode == IDLE_MODE_FAST) ? TICK_MILLIS : TICK_IDLE_MILLIS);
+  }
+}
+
+// Task: services the ESP module and picks up the network list once it has all come in
+boolean runRadio(long t) {
+  PROFILE_START(PROF_ESP);
+  espReceiving = esp.handleData();  // Returns nothing if it doesn't have an open operation; this is necessary in case the user exits the scanning while an operation is underway
+  PROFILE_STOP(PROF_ESP);
 
   // Handles data returned by the ESP module; builds a list of the incoming data
-  if (networksRx && !espData) {
-    releaseNetworkList(networkList);
-    networkList = networksRx;
+  if (networksRx && !espReceiving) {
+    if (menu_view.type == MENU_TYPE_SCANNER) {
+      setNetworkList(networksRx);
+    } else {
+      setNetworkList(NULL);
+      releaseNetworkList(networksRx);
+    }
     networksRx = NULL;
-    if (menuType != MENU_TYPE_SCANNER) {
-      releaseNetworkList(networkList);
-      networkList = NULL;
+    networksChanged = true;
+    scheduler.trigger(task_tick);
+  }
+  return true;
+}
+
+// The tasks below use SPI (for the ATTiny88 or the display), so they wait until the background LED and button transaction with the
+// ATTiny88 is done (it runs from the SPI interrupt); nothing else can use SPI until then
+
+// Task: handles button events, then commits any changes to the LEDs and asks for new button data
+boolean runInput(long t) {
+  uint8_t btn;          // The buttons that have been pressed that come back from the ATTiny88 via TinyUI
+  TinyUIButtonEvent events[BUTTON_EVENT_BATCH];   // Button events (presses, releases, long presses, and repeats) read from TinyUI in one go
+  uint8_t eventCount;   // Number of entries in events
+  uint8_t e;            // Loop variable for events
+
+  PROFILE_START(PROF_UI_BUTTONS);
+  if (!ui.poll()) {
+    PROFILE_STOP(PROF_UI_BUTTONS);   // (counting the polls that find the transaction still running, too)
+    return false;
+  }
+
+  // Grabs any recent button presses (from the transaction that just finished) and runs the current screen once for each
+  // The menu operates off menu_view.type, one of the lower-number constants defined above (MENU_TYPE_...)
+  eventCount = ui.getButtonEvents(events, BUTTON_EVENT_BATCH);   // Grabs every button event that has come in since last time
+  PROFILE_STOP(PROF_UI_BUTTONS);
+  if (eventCount) {
+    idle_sleep.activity(t);
+  }
+  for (e = 0; e < eventCount; e++) {
+    btn = eventButton(&events[e]);
+    if (btn) {
+      runMenuLevel(btn, t, false);
     }
-    refreshData = true;
-  } else {
-    refreshData = false;
+    countButtonLatency(&events[e]);
+  }
+
+  // Writes out what's been recorded, or passes on the next replayed packet
+#if SESSION_LOG_ENABLED
+  if (session.run(t)) {
+    runSerialCommand('t');
+    runSerialCommand('u');
+    runSerialCommand('k');
+#if PROFILER_ENABLED
+    runSerialCommand('p');
+#endif
   }
+#endif
 
-  // Grabs any recent button presses, commits any changes to the LEDs (via the ATTiny88 over SPI)
-  ui.update(TINYUI_GET_BUTTONS);  // Performes the SPI transaction; keeps asking until it gets new button data
-  btn = ui.getButton();           // Grabs the next button press
-  
+  // Takes in new supply voltages (they come back with the button data every POWER_SAMPLE_MILLIS) and saves power if the battery is running down
+  if (power.run(t)) {
+    applyPowerLevel();
+  }
+
+  // Saves the settings once they've stopped changing for a bit
+  settings_store.run(t);
+
+  // Issues any LED animation keyframes that are due, then commits any changes to the LEDs and asks for new button data (via the ATTiny88 over SPI); this runs in the background
+  PROFILE_START(PROF_UI_UPDATE);
+  leds.run(t);
+  ui.updateAsync(TINYUI_GET_BUTTONS | power.getFlags(t));
+  PROFILE_STOP(PROF_UI_UPDATE);
+  return true;
+}
+
+// Spaces out WiFi scans and screen redraws and cuts back bling to suit the battery level
+void applyPowerLevel(void) {
+  uint8_t level = power.getLevel();
+  scheduler.setPeriod(task_scan, SCAN_INTERVAL << level);
+  scheduler.setPeriod(task_render, FRAME_MILLIS << level);
+  if (menu_view.type != MENU_TYPE_GAME) {   // games use the LEDs themselves
+    setBling(settings.blingMode);
+  }
+}
+
+// Task: starts a WiFi scan every SCAN_INTERVAL while the scanner is showing (once the last one has finished coming in)
+boolean runScan(long t) {
+  network_counter.run(t);
+  if (menu_view.type != MENU_TYPE_SCANNER) {
+    return true;
+  }
+  if (espReceiving) {
+    return false;
+  }
+  resetNetworksList();
+  network_counter.startScan();
+  esp.startListNetworks(&networksRx, networkItem, ssidBuffer, sizeof(ssidBuffer));
+  return true;
+}
+
+// Task: runs the current screen with no button, for games and screens that do things over time (and to show a new network list)
+boolean runTick(long t) {
+  if (!ui.poll()) {
+    return false;
+  }
+  runMenuLevel(TINYUI_BUTTON_NONE, t, networksChanged);
+  networksChanged = false;
+  return true;
+}
+
+// Task: redraws the rows of the list on the screen that changed (draw_menu() and drawWifiList() ask for this)
+boolean runRender(long t) {
+  if (!ui.poll()) {
+    return false;
+  }
+  PROFILE_START(PROF_DRAW);
+  menu_list.draw();
+  PROFILE_STOP(PROF_DRAW);
+  return true;
+}
+
+// Task: answers anything sent over the USB serial port
+boolean runSerial(long t) {
+#if SESSION_LOG_ENABLED
+  if (session.getMode() == SESSION_REPLAY) {
+    return true;   // the session is coming in over the USB serial port
+  }
+#endif
+  if (Serial.available()) {
+    runSerialCommand(Serial.read());
+  }
+  return true;
+}
+
+// Does whatever the current menu level does: handles the button (if any) and runs scanning, games, and Easter eggs
+void runMenuLevel(uint8_t btn, long t, boolean refreshData) {
+  boolean playing;      // False once a game is over
+  switch (menu_view.type) {
   // If we're scanning:
-  if (menuType == MENU_TYPE_SCANNER) {
+  case MENU_TYPE_SCANNER:
     if (refreshData) {
       setNetworkActivity();
+      logNetworkActivity(t);
+      menu_list.invalidate();
       drawWifiList();
     }
-    if ((t >= nextScan) && !espData) {
-      nextScan = t + SCAN_INTERVAL;
-      resetNetworksList();
-      esp.startListNetworks(&networksRx, networkItem, ssidBuffer, sizeof(ssidBuffer));
-    }
     if (btn & TINYUI_BUTTON_UP) {
-      if (menu_position) {
-        menu_position--;
-      }
+      menu_list.scroll(-1);
       drawWifiList();
     }
     if (btn & TINYUI_BUTTON_DOWN) {
-      menu_position++;
+      menu_list.scroll(1);
       drawWifiList();
     }
     if (btn & TINYUI_BUTTON_LEFT) {
       navigateOutOf();
     }
+    break;
+  // Scrolling through the scan history
+  case MENU_TYPE_HISTORY:
+    if (btn & TINYUI_BUTTON_UP) {
+      menu_list.scroll(-1);
+      draw_menu();
+    }
+    if (btn & TINYUI_BUTTON_DOWN) {
+      menu_list.scroll(1);
+      draw_menu();
+    }
+    if (btn & TINYUI_BUTTON_LEFT) {
+      navigateOutOf();
+    }
+    break;
   // If we're going to play a game (If you were adding Flappy Birds here's where you'd want to start adding code below:
-  } else if (menuType == MENU_TYPE_GAME)  {
-    menuType = menu_level->getDataByte(1);
-    if (menuType == MENU_GAME_SIMON) {
-      if (!simon.play(btn)) {
-        if (simon.isWinner()) {
-          settings.unlocked |= UNLOCK_SIMON;
-          MenuNodeP::setLocks(settings.unlocked);
-        }
-        navigateOutOf();
-      } 
-    }  // You'd add: else if (menuType == MENU_GAME_FLAPPY) { and then more code like you see above.
+  case MENU_TYPE_GAME:
+    if (btn) {
+      games.pushInput(btn);
+    }
+    PROFILE_START(PROF_GAME);
+    playing = games.run(t);
+    PROFILE_STOP(PROF_GAME);
+    if (!playing) {
+      if ((menu_view.subtype == MENU_GAME_SIMON) && simon.isWinner()) {
+        settings.unlocked |= UNLOCK_SIMON;
+        MenuNodeP::setLocks(settings.unlocked);
+        settings_store.changed();
+      }  // You'd add: else if ((menu_view.subtype == MENU_GAME_FLAPPY) && ...) { for anything that happens when that game ends.
+      navigateOutOf();
+    }
+    break;
   // Easter Egg!  Have fun!
-  } else if (menuType == MENU_TYPE_SECRET) {
-    menuType = menu_level->getDataByte(1);
-    if (menuType == MENU_SECRET_RABBIT) {
-      if (btn && (menu_position != 0xff)) {
+  case MENU_TYPE_SECRET:
+    if (menu_view.subtype == MENU_SECRET_RABBIT) {
+      if (btn && (secret_position != 0xff)) {
         refreshData = true;
-        if ((btn & TINYUI_BUTTON_UP) && (menu_position >= 0x10)) {
-          menu_position -= 0x10;
+        if ((btn & TINYUI_BUTTON_UP) && (secret_position >= 0x10)) {
+          secret_position -= 0x10;
         }
-        if ((btn & TINYUI_BUTTON_DOWN) && (menu_position < 0xc0)) {
-          menu_position += 0x10;
+        if ((btn & TINYUI_BUTTON_DOWN) && (secret_position < 0xc0)) {
+          secret_position += 0x10;
         }
         if (btn & TINYUI_BUTTON_LEFT) {
-          if (menu_position & 0x0f) {
-            menu_position--;
+          if (secret_position & 0x0f) {
+            secret_position--;
           } else {
             navigateOutOf();
             refreshData = false;
           }
         }
-        if ((btn & TINYUI_BUTTON_RIGHT) && ((menu_position & 0x0f) < 0x0a)) {
-          menu_position++;
+        if ((btn & TINYUI_BUTTON_RIGHT) && ((secret_position & 0x0f) < 0x0a)) {
+          secret_position++;
         }
         if (refreshData) {
           updateTheMatrixHasYou();
         }
       }
-      if ((menu_position == 0xff) && (btn & (TINYUI_BUTTON_LEFT | TINYUI_BUTTON_SELECT))) {
+      if ((secret_position == 0xff) && (btn & (TINYUI_BUTTON_LEFT | TINYUI_BUTTON_SELECT))) {
         navigateOutOf();
       }
-      if ((ui._getNavHistory(8) == 0x004e58d1) && (menu_position != 0xff)) {
+      if ((ui._getNavHistory(8) == 0x004e58d1) && (secret_position != 0xff)) {
         display.clearDisplay(); // clear the screen/flush the buffer
         display.setCursor(0,0); // Set the cursor back to the top left
         display.setTextColor(WHITE);
@@ -401,36 +744,94 @@ void loop() {
         display.println(buffer);
         strcpy_P(buffer, PSTR("run around and desert"));
         display.println(buffer);
+        PROFILE_START(PROF_DISPLAY);
         display.display();
-        menu_position = 0xff;
+        PROFILE_STOP(PROF_DISPLAY);
+        secret_position = 0xff;
         settings.unlocked = UNLOCK_RABBIT;
         MenuNodeP::setLocks(settings.unlocked);
+        settings_store.changed();
       }
-    } else if (menuType == MENU_SECRET_RED_PILL) {
-      if (t >= nextScan) {
-        i = random(TINYUI_LED_COUNT);
-        ui.setPixelTransition(i, ui.getPixel(i) ? 0 : 255, RED_PILL_FRAMES);
-        nextScan = t + RED_PILL_INTERVAL;
+    } else if (menu_view.subtype == MENU_SECRET_RED_PILL) {
+      if (btn & (TINYUI_BUTTON_LEFT | TINYUI_BUTTON_SELECT)) {
+        navigateOutOf();
       }
+    } else if (menu_view.subtype == MENU_SECRET_MEMORY) {
       if (btn & (TINYUI_BUTTON_LEFT | TINYUI_BUTTON_SELECT)) {
         navigateOutOf();
+      } else if (t - secret_time >= MEMORY_REFRESH_MILLIS) {
+        secret_time = t;
+        drawMemory();
       }
     }
-  } else {
+    break;
+  default:
     handleMenuButton(btn); // Default menu navigation behavior
+    break;
   }
 }
 
-// This variable is only used down here; the number of access points on each channel
+// Turns a button event into a button press for the menus: presses count, and so do auto-repeats of up and down (so you can
+// hold a button to scroll through a long list) everywhere except in games
+uint8_t eventButton(TinyUIButtonEvent *event) {
+  if (event->type == TINYUI_EVENT_DOWN) {
+    return event->button;
+  }
+  if ((event->type == TINYUI_EVENT_REPEAT) && (menu_view.type != MENU_TYPE_GAME) && (event->button & (TINYUI_BUTTON_UP | TINYUI_BUTTON_DOWN))) {
+    return event->button;
+  }
+  return TINYUI_BUTTON_NONE;
+}
+
+// Button latency: milliseconds from the touch packet that showed a press coming in to runInput() finishing handling it (last and
+// worst seen); add the average time from the reading leaving the noise to the press (see TinyUIStats) for the whole latency
+uint16_t buttonLatency = 0;
+uint16_t buttonLatencyMax = 0;
+
+void countButtonLatency(TinyUIButtonEvent *event) {
+  if (event->type != TINYUI_EVENT_DOWN) {
+    return;
+  }
+  buttonLatency = (uint16_t) millis() - event->time;
+  if (buttonLatency > buttonLatencyMax) {
+    buttonLatencyMax = buttonLatency;
+  }
+}
+
+// Loop rate counter; loopRate holds the number of loop() passes that ran a task in the last LOOP_RATE_MILLIS, for comparing main
+// loop changes (passes that found nothing to do and went to sleep, or whose tasks were all blocked, aren't counted)
+#define LOOP_RATE_MILLIS 1000
+uint16_t loopCount = 0;
+uint16_t loopRate = 0;
+long loopRateStart = 0;
+
+void countLoop(long t, boolean ran) {
+  if (ran) {
+    loopCount++;
+  }
+  if (t - loopRateStart >= LOOP_RATE_MILLIS) {
+    loopRate = loopCount;
+    loopCount = 0;
+    loopRateStart = t;
+  }
+}
+
+// These variables are only used down here; the number of access points on each channel, and the strongest RSSI seen on each (for
+// the scan history), and how busy each channel is (for the LEDs)
 uint8_t channelActivity[CHANNEL_COUNT];
+int8_t channelPeak[CHANNEL_COUNT];
+ChannelOccupancy occupancy;
 
-// Sets the LED blinking based on what is in channel activity
+// Sets the LED blinking based on how busy each channel was, smoothed over the last few scans: the stronger the networks on and
+// next to a channel, the faster it blinks
 void setNetworkActivity(void) {
-  uint8_t i, p, m;
+  uint8_t i, p, m, level;
+  occupancy.finishScan();
   m = TINYUI_PULSE_LENGTH + (settings.maxActivity << ACTIVITY_SH);
   for (i = 0; i < CHANNEL_COUNT; i++) {
-    if (channelActivity[i]) {
-      p = (channelActivity[i] < settings.maxActivity) ? m - (channelActivity[i] << ACTIVITY_SH) : TINYUI_PULSE_LENGTH;
+    level = occupancy.getLevel(i, settings.maxActivity);
+    if (level) {
+      p = (level < settings.maxActivity) ? m - (level << ACTIVITY_SH) : TINYUI_PULSE_LENGTH;
       ui.setPixel(i, 255);
       ui.setPulse(i, p);
     } else {
@@ -439,10 +840,16 @@ void setNetworkActivity(void) {
   }
 }
 
+// Adds the channel activity from the scan that just finished to the scan history
+void logNetworkActivity(long t) {
+  history.addScan(channelActivity, channelPeak, t);
+}
+
 // Releases memory that was used to hold a network list that is no longer needed
 void releaseNetworkList(NetworkInfo *head) {
   NetworkInfo *cur;
   NetworkInfo *next;
+  memory.sample();   // (the heap may shrink)
   cur = head;
   while (cur) {
     next = cur->next;
@@ -451,18 +858,36 @@ void releaseNetworkList(NetworkInfo *head) {
   }
 }
 
+// Replaces the network list the scanner shows (releasing the old one), and counts it and moves the cursor back to its start
+void setNetworkList(NetworkInfo *list) {
+  releaseNetworkList(networkList);
+  networkList = list;
+  networkCursor = NULL;
+  networkCursorIndex = 0;
+  for (networkCount = 0; list; list = list->next) {
+    networkCount++;
+  }
+}
+
 // Resets the counters for aggregating data as it parses
 void resetNetworksList(void) {
   networkRAM = 0;
   memset(channelActivity, 0, sizeof(channelActivity));
+  memset(channelPeak, HISTORY_RSSI_NONE, sizeof(channelPeak));
+  occupancy.startScan();
 }
 
 // Callback for the ESP module - checks RAM usage and adds the network information to the list of data being received
 void *networkItem(void *obj, uint8_t security, const char *ssid, int8_t rssi, const uint8_t *mac, uint8_t channel) {
   NetworkInfo *info;
   uint16_t newRAM;
+  network_counter.add(mac, ssid);
   if (channel && (channel <= CHANNEL_COUNT)) {
     channelActivity[channel - 1]++;
+    if (rssi > channelPeak[channel - 1]) {
+      channelPeak[channel - 1] = rssi;
+    }
+    occupancy.add(rssi, channel);
   }
   newRAM = networkRAM + sizeof(NetworkInfo) + strlen(ssid) + 1;
   if (newRAM <= MAX_NETWORKS_RAM) {
@@ -493,9 +918,8 @@ void handleMenuButton(uint8_t btn) {
   }
   if (btn & TINYUI_BUTTON_UP)
   {
-    if (menu_selected) {
-      menu_selected--;
-      navigateSelect();
+    if (menu_list.getSelected()) {
+      navigateSelect(menu_list.getSelected() - 1);
     }
   }
   if (btn & TINYUI_BUTTON_RIGHT)
@@ -504,9 +928,8 @@ void handleMenuButton(uint8_t btn) {
   }
   if (btn & TINYUI_BUTTON_DOWN)
   {
-    if (menu_selected < (menu_level->getChildCount() - 1)) {
-      menu_selected++;
-      navigateSelect();
+    if (menu_list.getSelected() < (menu_level->getChildCount() - 1)) {
+      navigateSelect(menu_list.getSelected() + 1);
     }
   }
   if (btn & TINYUI_BUTTON_LEFT)
@@ -516,229 +939,555 @@ void handleMenuButton(uint8_t btn) {
 }
 
 // A new menu item has been selected; apply whatever changes need to be applied
-void navigateSelect(void) {
-  if (menu_position > menu_selected) {
-    menu_position = menu_selected;
-  }
-  if ((menu_position + MENU_HEIGHT) < menu_selected) {
-    menu_position = menu_selected - MENU_HEIGHT;
-  }
+void navigateSelect(int n) {
+  menu_list.select(n);
   // Any actions that should be performed when a menu item is highlighted should be implemented here (without requiring the center button to be pressed)
   draw_menu();
 }
 
+// Starts one of the ATTiny88's bling modes (MENU_BLING_...) with the parameters from settings; on a low battery, any mode but off
+// is played as a heartbeat (the fewest LEDs lit), and on a critical battery bling stays off
+void setBling(uint8_t mode) {
+  if (power.getLevel() >= POWER_LEVEL_CRITICAL) {
+    mode = MENU_BLING_OFF;
+  } else if ((power.getLevel() == POWER_LEVEL_LOW) && (mode != MENU_BLING_OFF)) {
+    mode = MENU_BLING_HEARTBEAT;
+  }
+  ui.blingOff();
+  switch (mode) {
+  case MENU_BLING_SPIN:
+    ui.blingSpin(settings.spinSpeed, settings.spinN);
+    break;
+  case MENU_BLING_HEARTBEAT:
+    ui.blingHeartbeat(settings.heartbeatSpeed, settings.heartbeatPeriod);
+    break;
+  case MENU_BLING_SPARKLE:
+    ui.blingSparkle(settings.sparkleSpeed, settings.sparkleFreq);
+    break;
+  case MENU_BLING_SWEEP:
+    ui.blingSweep(settings.sweepSpeed, settings.sweepPeriod);
+    break;
+  }
+}
+
 // Move into the currently selected submenu item and execute any action that menu option would perform
 void navigateInto(void) {
-  uint8_t menuType;
-  uint32_t tgtid;
+  MenuNodeView tgtView;
   MenuNodeP *tgt;
-  tgt = menu_level->getChild(menu_selected);
-  if (tgt->hasData()) {
-    menuType = tgt->getDataByte(0);
-    if (menuType == MENU_TYPE_SCANNER) {
-      menu_level = tgt;
-      menu_position = 0;
-      navigateSelect();
-    } else if (menuType == MENU_TYPE_BLING) {
-      menuType = tgt->getDataByte(1);
-      if (menuType == MENU_BLING_OFF) {
-        ui.blingOff();
-      } else if (menuType == MENU_BLING_SPIN) {
-        ui.blingOff();
-        ui.blingSpin(settings.spinSpeed, settings.spinN);
-      } else if (menuType == MENU_BLING_HEARTBEAT) {
-        ui.blingOff();
-        ui.blingHeartbeat(settings.heartbeatSpeed, settings.heartbeatPeriod);
-      } else if (menuType == MENU_BLING_SPARKLE) {
-        ui.blingOff();
-        ui.blingSparkle(settings.sparkleSpeed, settings.sparkleFreq);
-      } else if (menuType == MENU_BLING_SWEEP) {
-        ui.blingOff();
-        ui.blingSweep(settings.sweepSpeed, settings.sweepPeriod);
-      } else if (menuType == MENU_BLING_BUTTONS) {
+  tgt = menu_level->getChild(menu_list.getSelected());
+  tgt->readView(&tgtView);
+  if (tgtView.hasData) {
+    switch (tgtView.type) {
+    case MENU_TYPE_SCANNER:
+      setMenuLevel(tgt);
+      setLastMenu(tgtView.id);
+      drawWifiList();
+      scheduler.trigger(task_scan);   // scan right away rather than waiting for the next SCAN_INTERVAL
+      break;
+    case MENU_TYPE_HISTORY:
+      history.flush();   // so the newest records are in EEPROM to be read back
+      setMenuLevel(tgt);
+      setLastMenu(tgtView.id);
+      draw_menu();
+      break;
+    case MENU_TYPE_BLING:
+      if (tgtView.subtype == MENU_BLING_BUTTONS) {
         if (ui.buttonFeedbackEnabled()) {
           ui.buttonFeedbackOff();
         } else {
           ui.buttonFeedbackOn();
         }
-      }
-      if (menuType != MENU_BLING_BUTTONS) {
-        settings.blingMode = menuType;
+      } else {
+        setBling(tgtView.subtype);
+        settings.blingMode = tgtView.subtype;
+        settings_store.changed();
       }
       navigateOutOf();
-    } else if (menuType == MENU_TYPE_GAME) {
-      menuType = tgt->getDataByte(1);
-      if (menuType == MENU_GAME_SIMON) {
-        simon.start();
-        menu_level = tgt;
-      }
-    } else if (menuType == MENU_TYPE_SETTING) {
-      menuType = tgt->getDataByte(1);
-      if (menuType == MENU_SETTING_REGION) {
-        settings.region = tgt->getDataByte(2);
+      break;
+    case MENU_TYPE_GAME:
+      if (tgtView.subtype == MENU_GAME_SIMON) {
+        games.start(&simon, millis());
+        setMenuLevel(tgt);
+      }  // You'd add: else if (tgtView.subtype == MENU_GAME_FLAPPY) { games.start(&flappy, millis()); setMenuLevel(tgt); }
+      break;
+    case MENU_TYPE_SETTING:
+      if (tgtView.subtype == MENU_SETTING_REGION) {
+        settings.region = tgtView.arg[0];
+        settings_store.changed();
         navigateOutOf();
       }
-    } else if (menuType == MENU_TYPE_SECRET) {
-      menuType = tgt->getDataByte(1);
-      menu_position = 0;
-      if (menuType == MENU_SECRET_RABBIT) {
+      break;
+    case MENU_TYPE_SECRET:
+      secret_position = 0;
+      if (tgtView.subtype == MENU_SECRET_RABBIT) {
         updateTheMatrixHasYou();
-      } else if (menuType == MENU_SECRET_RED_PILL) {
+      } else if (tgtView.subtype == MENU_SECRET_RED_PILL) {
         display.clearDisplay(); // clear the screen/flush the buffer
         display.setCursor(0,0); // Set the cursor back to the top left
+        PROFILE_START(PROF_DISPLAY);
         display.display();
+        PROFILE_STOP(PROF_DISPLAY);
+        leds.play(red_pill_anim, LedAnimationLength(red_pill_anim), 0, LEDSEQ_LOOP_FOREVER);   // Toggles a random LED every RED_PILL_INTERVAL
+      } else if (tgtView.subtype == MENU_SECRET_MEMORY) {
+        secret_time = millis();
+        drawMemory();
       }
-      menu_level = tgt;
+      setMenuLevel(tgt);
+      break;
     }
   } else if (tgt->getChildCount()) {
-    tgtid = tgt->getId();
-    menu_level = tgt;
-    menu_position = 0;
-    menu_selected = 0;
-    if (tgtid == MENU_ID_BLING) {
-      selectSubmenu(1, settings.blingMode);
-    } else if (tgtid == MENU_ID_SETTING_REGION) {
-      selectSubmenu(2, settings.region);
+    setMenuLevel(tgt);
+    switch (tgtView.id) {
+    case MENU_ID_BLING:
+      navigateSelect(selectSubmenu(1, settings.blingMode));
+      break;
+    case MENU_ID_SETTING_REGION:
+      navigateSelect(selectSubmenu(2, settings.region));
+      break;
+    default:
+      navigateSelect(0);
+      break;
     }
-    navigateSelect();
   }
 }
 
 // Move back out of the current menu item to its parent (This is where you'd clean up anything that needs to be cleaned up when you exit a menu)
 void navigateOutOf(void) {
-  uint8_t i, n;
-  uint8_t oldType;
+  uint8_t i;
   MenuNodeP *old;
+  MenuNodeP *parent;
   old = menu_level;
-  oldType = old->getDataByte(0);
-  if (oldType == MENU_TYPE_SCANNER) {
-    releaseNetworkList(networkList);
-    networkList = NULL;
+  switch (menu_view.type) {
+  case MENU_TYPE_SCANNER:
+    setNetworkList(NULL);
+    occupancy.clear();
     for (i = 0; i < CHANNEL_COUNT; i++) {
       ui.setPixel(i, 0);
       ui.setPulse(i, 0);
     }
-  } else if (oldType == MENU_TYPE_GAME) {
-    oldType = old->getDataByte(1);
-    if (oldType == MENU_GAME_SIMON) {
-      simon.release();
-    }
-  } else if (oldType == MENU_TYPE_SECRET) {
-    oldType = old->getDataByte(1);
-    if (oldType == MENU_SECRET_RED_PILL) {
-      for (i = 0; i < TINYUI_LED_COUNT; i++) {
-        ui.setPixelTransition(i, 0, RED_PILL_FRAMES);
-      }
+    setLastMenu(MENU_ID_ROOT);
+    break;
+  case MENU_TYPE_HISTORY:
+    setLastMenu(MENU_ID_ROOT);
+    break;
+  case MENU_TYPE_GAME:
+    games.stop();
+    break;
+  case MENU_TYPE_SECRET:
+    if (menu_view.subtype == MENU_SECRET_RED_PILL) {
+      leds.play(red_pill_off_anim, LedAnimationLength(red_pill_off_anim));
     }
+    break;
   }
-  menu_level = menu_level->getParent();
-  if (menu_level) {
-    menu_position = 0;
-    menu_selected = 0;
-    n = menu_level->getChildCount();
-    for (i = 0; i < n; i++) {
-      if (menu_level->getChild(i) == old) {
-        menu_selected = i;
-        break;
-      }
-    }
-    navigateSelect();
+  parent = old->getParent();
+  if (parent) {
+    setMenuLevel(parent);
+    navigateSelect(menu_level->getChildIndex(old));
+  }
+}
+
+// Changes the current menu level and reloads its cached descriptor so loop() doesn't have to read it out of program space every time
+// The list on the screen is pointed at the new level's children (or at the network list for the scanner) and scrolled to the top
+void setMenuLevel(MenuNodeP *node) {
+  menu_level = node;
+  node->readView(&menu_view);
+  if (menu_view.type == MENU_TYPE_SCANNER) {
+    menu_list.setSource(NULL, countNetworks, renderNetwork, false);
+  } else if (menu_view.type == MENU_TYPE_HISTORY) {
+    menu_list.setSource(&history, countHistory, renderHistory, false);
   } else {
-    menu_level = old;
+    menu_list.setSource(node, countMenuItems, renderMenuItem, true);
+  }
+}
+
+// Notes the screen to go back to at power up; it is only saved when it changes, so going in and out of the scanner costs two
+// writes (at most, since SettingsStore waits for the changes to stop and skips a write that puts back what is already stored)
+void setLastMenu(uint32_t id) {
+  if (settings.lastMenu != id) {
+    settings.lastMenu = id;
+    settings_store.changed();
+  }
+}
+
+// Jumps straight to the menu item with the given ID, as if it had been selected from its parent menu; returns false if
+// there is no such item or it is still locked (use this to deep-link to a screen, e.g. to restore where the badge left off)
+boolean navigateToId(uint32_t id) {
+  MenuNodeP *node;
+  MenuNodeP *parent;
+  int n;
+  node = MenuNodeP::findById(m_index, HowBigIsThisArray(m_index), id);
+  if (!node) {
+    return false;
+  }
+  parent = node->getParent();
+  n = parent ? parent->getChildIndex(node) : 0;
+  if (n < 0) {
+    return false;
   }
+  if (menu_view.hasData) {
+    navigateOutOf();   // clean up the screen we are leaving
+  }
+  setMenuLevel(parent ? parent : node);
+  navigateSelect(n);
+  if (parent && (node->hasData() || node->getChildCount())) {
+    navigateInto();
+  }
+  return true;
 }
 
-// Finds and selects the menu item indicated by data index (so if you have activated a certain BLING mode and go back to 
+// Finds the menu item indicated by data index (so if you have activated a certain BLING mode and go back to 
 // the BLING menu you will see that it has already highlited the current bling mode; this makes sure you have the correct one
 // selected when you return)
-void selectSubmenu(uint8_t dataIndex, uint8_t value) {
+int selectSubmenu(uint8_t dataIndex, uint8_t value) {
   uint8_t i, n;
   n = menu_level->getChildCount();
   for (i = 0; i < n; i++) {
     if (menu_level->getChild(i)->getDataByte(dataIndex) == value) {
-      menu_selected = i;
-      break;
+      return i;
     }
   }
+  return 0;
 }
 
-// This function decides what the menu should look like based on the environmental variables
-void draw_menu(void) {
-  // Check to see where we are in the menu versus the display so we know what to text to invert
-  int i;
-  MenuNodeP *node;
-  bool use_invert = 0; // Whether or not we're using the inverted color option
+// List source for the menu: the (unlocked) children of a menu node
+int countMenuItems(void *obj) {
+  return ((MenuNodeP *) obj)->getChildCount();
+}
 
-  // setup display
-  display.clearDisplay(); // clear the screen/flush the buffer
-  display.setCursor(0,0); // Set the cursor back to the top left
+void renderMenuItem(void *obj, int n, Print *out) {
+  // Pull menu character data out of program memory and push it to the screen
+  ((MenuNodeP *) obj)->getChild(n)->readText(buffer, sizeof(buffer));
+  out->print(buffer);
+}
+
+// List source for the scanner: how many different networks have been seen (and how many are new since the last scan), then the
+// SSIDs in the network list (counted by setNetworkList(), and walked from networkCursor)
+int countNetworks(void *obj) {
+  return networkCount + 1;
+}
 
-  // Display the 4 menu options here:
-  for (i = 0; i < 4; i++) {
+void renderNetwork(void *obj, int n, Print *out) {
+  if (!n--) {
+    out->print('~');
+    out->print(network_counter.getCount());
+    out->print(F(" seen, "));
+    out->print(network_counter.getNewCount());
+    out->print(F(" new"));
+    return;
+  }
+  if (!networkCursor || (n < networkCursorIndex)) {
+    networkCursor = networkList;
+    networkCursorIndex = 0;
+  }
+  for ( ; networkCursor && (networkCursorIndex < n); networkCursorIndex++) {
+    networkCursor = networkCursor->next;
+    networkSteps++;
+  }
+  if (networkCursor) {
+    out->print(networkCursor->ssid);
+  }
+}
+
+// List source for the scan history: one row per record, newest first, showing how long ago, the total APs, and the busiest channel and its peak RSSI
+int countHistory(void *obj) {
+  return ((ScanHistory *) obj)->getRecordCount();
+}
 
-    // if this is a selected entry highlight it
-    if (i + menu_position == menu_selected) {
-      display.setTextColor(BLACK, WHITE);
-      use_invert = 1;
+void renderHistory(void *obj, int n, Print *out) {
+  HistoryRecord rec;
+  uint8_t i, busiest;
+  uint16_t total;
+  if (!((ScanHistory *) obj)->getRecord(n, &rec)) {
+    return;
+  }
+  busiest = 0;
+  total = 0;
+  for (i = 0; i < HISTORY_CHANNELS; i++) {
+    total += rec.count[i];
+    if (rec.count[i] > rec.count[busiest]) {
+      busiest = i;
     }
+  }
+  if (rec.age == HISTORY_AGE_UNKNOWN) {
+    out->print('?');
+  } else {
+    out->print(rec.age);
+    out->print('m');
+  }
+  out->print(' ');
+  out->print(total);
+  out->print(F("ap ch"));
+  out->print(busiest + 1);
+  if (total) {
+    out->print(' ');
+    out->print(rec.peak[busiest]);
+  }
+}
 
-    // Pull menu character data out of memory and push it to the screen
-    // We are using the menu_level pointer to access the menu text data
-    if (i + menu_position < menu_level->getChildCount()) {
-      node = menu_level->getChild(i + menu_position);
-      node->readText(buffer, sizeof(buffer));
+// Handles a one-character command from the USB serial port:
+//   h - dumps the scan history as CSV, newest first: minutes ago (blank if unknown), then the AP count and peak RSSI for each channel (blank if it had no APs)
+//   t - dumps the task timing as CSV, one line per task: runs, deadline misses, worst lateness (ms), last, worst, and average run time (us);
+//       then "loops" and the loop() passes that ran a task in the last second
+//   p - dumps the profiler's sections as CSV (see Profiler.h): name, count, worst time (us), then the log2 histogram of times in 4us ticks
+//   P - clears the profiler's sections (p and P only with PROFILER_ENABLED)
+//   i - dumps the idle sleep figures as CSV, one line per IdleSleep mode (fast, slow): percentage of time awake, estimated CPU current (uA), and wakeups
+//   m - prints the RAM report (see MemoryMonitor.h): heap in use and its peak, free RAM and the largest block, fragmentation, and stack
+//   u - dumps the SPI traffic with the ATTiny88 as CSV (see TinyUI.h): updates, packets, bytes, LED packets, LED changes skipped, framing errors, the last byte counted as one
+//       (hex), the SPI clock (Hz), the last transaction's time (us), and the average time per packet (us, x16 for cycles; each
+//       TINYUI_PACKET_LENGTH + 1 bytes clocked, with the pad byte, count as a packet whichever way they went), and the ATTiny88 firmware's hash
+//       (hex) and TINYUI_FIRMWARE_... features as begin() found them
+//   g - dumps the game frame timing as CSV (see GameRuntime.h): steps, skipped steps, most steps in one frame, buttons dropped, frames pushed, last, worst, and average frame time (us)
+//   n - prints the estimated number of different networks seen, and the number new in the last scan
+//   N - starts counting networks from zero
+//   o - dumps how busy each channel is as CSV (see ChannelOccupancy.h): the smoothed occupancy of channels 1 to 14 as the RSSI of one network with the same power
+//   r - starts recording a session (see SessionLog.h), or stops it
+//   R - starts replaying a session (r and R only with SESSION_LOG_ENABLED)
+//   k - dumps the button latency as CSV: last and worst time (ms) from the packet showing a press to the press being handled, then
+//       the average time (ms) from a reading leaving the noise to the press being detected (only when TinyUI filters the touch data)
+//   a - dumps the LED animation figures as CSV (see LedSequencer.h): keyframes issued, SPI transactions that carried them, time spent
+//       playing (ms), and transactions per second of animation
+//   e - dumps the FLASH and EEPROM transfer figures as CSV (see TinyUI.h): bytes moved, time spent (us), and bytes per second
+//   c - dumps the streaming encryption and hashing figures as CSV (see TinyUI.h): bytes processed, time spent (us), and bytes per second
+//   l - dumps the list repaint figures as CSV (see ListView.h): navigation steps, rows drawn, frames pushed, rows drawn per step, and networks
+//       walked past to find the scanner's rows
+//   b - dumps the power figures as CSV: filtered USB, LiPo, and AA voltages (mV), the source in use, POWER_LEVEL_..., and the estimated minutes left (blank if unknown)
+void runSerialCommand(int c) {
+  HistoryRecord rec;
+  const TaskStats *stats;
+  const TinyUIStats *uiStats;
+  const GameStats *gameStats;
+  const LedSequencerStats *ledStats;
+  const ListViewStats *listStats;
+  uint16_t n;
+  uint8_t i;
+  if (c == 't') {
+    for (i = 0; i < scheduler.getTaskCount(); i++) {
+      stats = scheduler.getStats(i);
+      Serial.print(i);
+      Serial.print(',');
+      Serial.print(stats->runs);
+      Serial.print(',');
+      Serial.print(stats->misses);
+      Serial.print(',');
+      Serial.print(stats->maxLateness);
+      Serial.print(',');
+      Serial.print(stats->lastMicros);
+      Serial.print(',');
+      Serial.print(stats->maxMicros);
+      Serial.print(',');
+      Serial.println(stats->runs ? stats->totalMicros / stats->runs : 0);
+    }
+    Serial.print(F("loops,"));
+    Serial.println(loopRate);
+  }
+#if PROFILER_ENABLED
+  if (c == 'p') {
+    profiler.dump(&Serial);
+  }
+  if (c == 'P') {
+    profiler.reset();
+  }
+#endif
+  if (c == 'i') {
+    for (i = 0; i < IDLE_MODES; i++) {
+      Serial.print(i ? F("slow,") : F("fast,"));
+      Serial.print(idle_sleep.getDutyCycle(i));
+      Serial.print(',');
+      Serial.print(idle_sleep.getCurrent(i));
+      Serial.print(',');
+      Serial.println(idle_sleep.getStats(i)->wakeups);
+    }
+  }
+  if (c == 'm') {
+    memory.print(&Serial);
+  }
+  if (c == 'u') {
+    uiStats = ui.getStats();
+    Serial.print(uiStats->updates);
+    Serial.print(',');
+    Serial.print(uiStats->packets);
+    Serial.print(',');
+    Serial.print(uiStats->bytes);
+    Serial.print(',');
+    Serial.print(uiStats->ledPackets);
+    Serial.print(',');
+    Serial.print(uiStats->ledNoops);
+    Serial.print(',');
+    Serial.print(uiStats->framingErrors);
+    Serial.print(',');
+    Serial.print(uiStats->lastFramingByte, HEX);
+    Serial.print(',');
+    Serial.print(ui.getSpiClock());
+    Serial.print(',');
+    Serial.print(uiStats->lastMicros);
+    Serial.print(',');
+    Serial.print((uiStats->bytes >= TINYUI_PACKET_LENGTH + 1) ? uiStats->totalMicros / (uiStats->bytes / (TINYUI_PACKET_LENGTH + 1)) : 0);
+    Serial.print(',');
+    Serial.print(ui.getFirmwareHash(), HEX);
+    Serial.print(',');
+    Serial.println(ui.getFirmwareFeatures());
+  }
+  if (c == 'g') {
+    gameStats = games.getStats();
+    Serial.print(gameStats->ticks);
+    Serial.print(',');
+    Serial.print(gameStats->skippedTicks);
+    Serial.print(',');
+    Serial.print(gameStats->maxCatchup);
+    Serial.print(',');
+    Serial.print(gameStats->inputDrops);
+    Serial.print(',');
+    Serial.print(gameStats->frames);
+    Serial.print(',');
+    Serial.print(gameStats->lastFrameMicros);
+    Serial.print(',');
+    Serial.print(gameStats->maxFrameMicros);
+    Serial.print(',');
+    Serial.println(gameStats->frameRuns ? gameStats->totalFrameMicros / gameStats->frameRuns : 0);
+  }
+  if (c == 'n') {
+    Serial.print(network_counter.getCount());
+    Serial.print(',');
+    Serial.println(network_counter.getNewCount());
+  }
+  if (c == 'N') {
+    network_counter.clear();
+  }
+  if (c == 'o') {
+    for (i = 0; i < CHANNEL_COUNT; i++) {
+      if (i) {
+        Serial.print(',');
+      }
+      Serial.print(occupancy.getDbm(i));
+    }
+    Serial.println();
+  }
+#if SESSION_LOG_ENABLED
+  if (c == 'r') {
+    if (session.getMode() == SESSION_RECORD) {
+      session.stop(millis());
     } else {
-      buffer[0] = 0;
+      session.record(&ui, &esp, &Serial, millis());
     }
-    display.println(buffer);
-
-    // if we have used the invert to highlight recently we need to disable it now
-    if (use_invert) {
-      display.setTextColor(WHITE);
-      use_invert = 0;
+  }
+  if (c == 'R') {
+    session.replay(&ui, &esp, &Serial, millis());
+  }
+#endif
+  if (c == 'k') {
+    uiStats = ui.getStats();
+    Serial.print(buttonLatency);
+    Serial.print(',');
+    Serial.print(buttonLatencyMax);
+    Serial.print(',');
+    if (ui.isRefilterCapSense()) {
+      Serial.print(uiStats->touchPresses ? uiStats->touchLatencyMillis / uiStats->touchPresses : 0);
+    }
+    Serial.println();
+  }
+  if (c == 'a') {
+    ledStats = leds.getStats();
+    Serial.print(ledStats->keyframes);
+    Serial.print(',');
+    Serial.print(ledStats->transactions);
+    Serial.print(',');
+    Serial.print(ledStats->millis);
+    Serial.print(',');
+    Serial.println(leds.getTransactionRate());
+  }
+  if (c == 'e') {
+    uiStats = ui.getStats();
+    Serial.print(uiStats->nvmBytes);
+    Serial.print(',');
+    Serial.print(uiStats->nvmMicros);
+    Serial.print(',');
+    Serial.println(ui.getNvmRate());
+  }
+  if (c == 'c') {
+    uiStats = ui.getStats();
+    Serial.print(uiStats->cryptoBytes);
+    Serial.print(',');
+    Serial.print(uiStats->cryptoMicros);
+    Serial.print(',');
+    Serial.println(ui.getCryptoRate());
+  }
+  if (c == 'l') {
+    listStats = menu_list.getStats();
+    Serial.print(listStats->steps);
+    Serial.print(',');
+    Serial.print(listStats->rowsDrawn);
+    Serial.print(',');
+    Serial.print(listStats->frames);
+    Serial.print(',');
+    Serial.print(listStats->steps ? (float) listStats->rowsDrawn / listStats->steps : 0, 2);
+    Serial.print(',');
+    Serial.println(networkSteps);
+  }
+  if (c == 'b') {
+    for (i = 0; i < POWER_SOURCES; i++) {
+      Serial.print(power.getVoltage(i));
+      Serial.print(',');
+    }
+    Serial.print(power.getSource());
+    Serial.print(',');
+    Serial.print(power.getLevel());
+    Serial.print(',');
+    if (power.getRuntime() != POWER_RUNTIME_UNKNOWN) {
+      Serial.print(power.getRuntime());
+    }
+    Serial.println();
+  }
+  if (c == 'h') {
+    history.flush();
+    for (n = 0; history.getRecord(n, &rec); n++) {
+      if (rec.age != HISTORY_AGE_UNKNOWN) {
+        Serial.print(rec.age);
+      }
+      for (i = 0; i < HISTORY_CHANNELS; i++) {
+        Serial.print(',');
+        Serial.print(rec.count[i]);
+      }
+      for (i = 0; i < HISTORY_CHANNELS; i++) {
+        Serial.print(',');
+        if (rec.count[i]) {
+          Serial.print(rec.peak[i]);
+        }
+      }
+      Serial.println();
     }
-
   }
-  // update the display
-  display.display();
+}
+
+// Redraws the menu; only the rows that changed since the last draw are drawn again (by the render task, at most once per FRAME_MILLIS)
+void draw_menu(void) {
+  scheduler.trigger(task_render);
 }
 
 // Show the list of WiFi SSIDs that have been found
 void drawWifiList(void) {
-  uint8_t i;
-  NetworkInfo *info;
+  scheduler.trigger(task_render);
+}
 
-  // setup display
+// Shows the RAM report
+void drawMemory(void) {
   display.clearDisplay(); // clear the screen/flush the buffer
   display.setCursor(0,0); // Set the cursor back to the top left
-
-  // find some network names to display
-  i = menu_position;
-  info = networkList;
-  while (i && info) {
-    i--;
-    info = info->next;
-  }
-  if (i) {
-    menu_position -= i;
-  } else {
-    for (i = 0; (i <= MENU_HEIGHT) && info; i++) {
-      display.println(info->ssid);
-      info = info->next;
-    }
-  }
-
-  // update the display
+  display.setTextColor(WHITE);
+  memory.print(&display);
+  PROFILE_START(PROF_DISPLAY);
   display.display();
+  PROFILE_STOP(PROF_DISPLAY);
 }
 
 // Wake up Neo...
 void updateTheMatrixHasYou(void) {
   display.clearDisplay(); // clear the screen/flush the buffer
-  display.setCursor((menu_position & 0x0f) << 1,(menu_position >> 4) << 1); // Set the cursor back to the top left
+  display.setCursor((secret_position & 0x0f) << 1,(secret_position >> 4) << 1); // Set the cursor back to the top left
   display.setTextColor(WHITE);
   strcpy_P(buffer, PSTR("The matrix has you"));
   display.println(buffer);
+  PROFILE_START(PROF_DISPLAY);
   display.display();
+  PROFILE_STOP(PROF_DISPLAY);
 }
 